@@ -135,6 +135,7 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb); ///< (see do_send from i_service_endpoint)
+    virtual bool do_send(const shared_buffer& buffer); ///< queues reference to the buffer, data is not copied
     virtual bool do_send_chunk(const void* ptr, size_t cb); ///< will send (or queue) a part of data
     virtual bool send_done();
     virtual bool close();
@@ -155,6 +156,9 @@ namespace net_utils
     void handle_write_after_delay1(const boost::system::error_code& e, size_t bytes_sent);
     void handle_write_after_delay2(const boost::system::error_code& e, size_t bytes_sent);
 
+    /// Queue the entry and start writing if there is no active write operation
+    bool do_send_entry(send_que_entry&& entry);
+
 
     /// reset connection timeout timer and callback
     void reset_timer(boost::posix_time::milliseconds ms, bool add);
@@ -200,7 +204,7 @@ namespace net_utils
         if (!m_send_que_lock.tryLock())
             return false;
         int64_t bytes_in_que = 0;
-        for (auto entry : m_send_que)
+        for (const auto& entry : m_send_que)
             bytes_in_que += entry.size();
 
         int64_t bytes_to_wait = bytes_in_que + callback.first;
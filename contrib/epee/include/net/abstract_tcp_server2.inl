@@ -496,11 +496,31 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
 	} // do_send()
 
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send(const shared_buffer& buffer)
+  {
+    TRY_ENTRY();
+    CHECK_AND_ASSERT_MES(buffer, false, "Empty shared buffer");
+    return do_send_entry(send_que_entry(buffer));
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+  }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   bool connection<t_protocol_handler>::do_send_chunk(const void* ptr, size_t cb)
   {
     TRY_ENTRY();
+    send_que_entry entry;
+    entry.assign((const char*)ptr, cb);
+    return do_send_entry(std::move(entry));
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_chunk", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_entry(send_que_entry&& entry)
+  {
+    TRY_ENTRY();
+    const size_t cb = entry.size();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
     auto self = safe_shared_from_this();
     if(!self)
@@ -532,13 +552,12 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return false;
     }
 
-    m_send_que.resize(m_send_que.size()+1);
-    m_send_que.back().assign((const char*)ptr, cb);
+    m_send_que.push_back(std::move(entry));
     
     if(m_send_que.size() > 1)
     { // active operation should be in progress, nothing to do, just wait last operation callback
         auto size_now = cb;
-        MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
+        MDEBUG("do_send_entry() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
         //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
       
       LOG_TRACE_CC(context, "[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
@@ -553,7 +572,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         }
 
         auto size_now = m_send_que.front().size();
-        MDEBUG("do_send_chunk() NOW SENSD: packet="<<size_now<<" B");
+        MDEBUG("do_send_entry() NOW SENSD: packet="<<size_now<<" B");
 
         CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
         reset_timer(get_default_timeout(), false);
@@ -568,8 +587,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     return true;
 
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_chunk", false);
-  } // do_send_chunk
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_entry", false);
+  } // do_send_entry
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   boost::posix_time::milliseconds connection<t_protocol_handler>::get_default_timeout()
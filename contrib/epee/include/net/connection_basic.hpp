@@ -82,6 +82,22 @@ class connection_basic_pimpl; // PIMPL for this class
   
   std::string to_string(t_connection_type type);
 
+  /// Entry of the send queue, either owns a copy of data or refers to a buffer shared with other connections
+  class send_que_entry
+  {
+  public:
+    send_que_entry() {}
+    explicit send_que_entry(shared_buffer buffer) : m_shared(std::move(buffer)) {}
+
+    void assign(const char* ptr, size_t cb) { m_shared.reset(); m_data.assign(ptr, cb); }
+    const char* data() const { return m_shared ? m_shared->data() : m_data.data(); }
+    size_t size() const { return m_shared ? m_shared->size() : m_data.size(); }
+
+  private:
+    std::string m_data;
+    shared_buffer m_shared;
+  };
+
 class connection_basic { // not-templated base class for rapid developmet of some code parts
 	public:
 		std::unique_ptr< connection_basic_pimpl > mI; // my Implementation
@@ -90,7 +106,7 @@ class connection_basic { // not-templated base class for rapid developmet of som
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    std::list<send_que_entry> m_send_que;
     volatile bool m_is_multithreaded;
     double m_start_time;
     /// Strand to ensure the connection's handlers are not called concurrently.
@@ -63,6 +63,25 @@ using async_state_machine=cblp::async_callback_state_machine;
 template<class t_connection_context>
 class async_protocol_handler;
 
+/// Build levin notification (header followed by body) once so it can be sent to several connections
+inline net_utils::shared_buffer make_notify_frame(int command, const std::string& in_buff)
+{
+  bucket_head2 head = {0};
+  head.m_signature = LEVIN_SIGNATURE;
+  head.m_have_to_return_data = false;
+  head.m_cb = in_buff.size();
+
+  head.m_command = command;
+  head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+  head.m_flags = LEVIN_PACKET_REQUEST;
+
+  boost::shared_ptr<std::string> frame = boost::make_shared<std::string>();
+  frame->reserve(sizeof(head) + in_buff.size());
+  frame->append(reinterpret_cast<const char*>(&head), sizeof(head));
+  frame->append(in_buff);
+  return frame;
+}
+
 template<class t_arg, class t_result, class t_transport, class t_connection_context>
   struct invoke_remote_command2_state_machine;
 
@@ -100,6 +119,7 @@ public:
   int invoke_async(int command, const std::string& in_buff, boost::uuids::uuid connection_id, const callback_t &cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const std::string& in_buff, boost::uuids::uuid connection_id);
+  int notify(const net_utils::shared_buffer& frame, boost::uuids::uuid connection_id);
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
   bool request_callback(boost::uuids::uuid connection_id);
@@ -737,6 +757,31 @@ public:
     return 1;
   }
   //------------------------------------------------------------------------------------------
+  int notify(const net_utils::shared_buffer& frame)
+  {
+    misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
+                          boost::bind(&async_protocol_handler::finish_outer_call, this));
+
+    if(m_deletion_initiated)
+      return LEVIN_ERROR_CONNECTION_DESTROYED;
+
+    CRITICAL_REGION_LOCAL(m_call_lock);
+
+    if(m_deletion_initiated)
+      return LEVIN_ERROR_CONNECTION_DESTROYED;
+
+    CRITICAL_REGION_BEGIN(m_send_lock);
+    if(!m_pservice_endpoint->do_send(frame))
+    {
+      LOG_ERROR_CC(m_connection_context, "Failed to do_send()");
+      return -1;
+    }
+    CRITICAL_REGION_END();
+    LOG_DEBUG_CC(m_connection_context, "LEVIN_PACKET_SENT. [frame len=" << frame->size() << "]");
+
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------
   boost::uuids::uuid get_connection_id() {return m_connection_context.m_connection_id;}
   //------------------------------------------------------------------------------------------
   t_connection_context& get_context_ref() {return m_connection_context;}
@@ -892,6 +937,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify(const net_utils::shared_buffer& frame, boost::uuids::uuid connection_id)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  int r = find_and_lock_connection(connection_id, aph);
+  return LEVIN_OK == r ? aph->notify(frame) : r;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
   CRITICAL_REGION_LOCAL(m_connects_lock);
@@ -31,6 +31,8 @@
 
 #include <boost/uuid/uuid.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
 #include <typeinfo>
 #include <type_traits>
 #include "serialization/keyvalue_serialization.h"
@@ -277,9 +279,14 @@ namespace net_utils
 	/************************************************************************/
 	/*                                                                      */
 	/************************************************************************/
+  /// Immutable data which can be queued for sending to several connections without copying
+  typedef boost::shared_ptr<const std::string> shared_buffer;
+
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+    /// Send whole buffer, endpoints which can't keep a reference to the buffer copy its data
+    virtual bool do_send(const shared_buffer& buffer) { return buffer && do_send(buffer->data(), buffer->size()); }
     virtual bool close()=0;
     virtual bool send_done()=0;
     virtual bool call_run_once_service_io()=0;
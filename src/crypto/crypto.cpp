@@ -218,6 +218,30 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::derive_public_keys(const key_derivation &derivation, size_t outputs_count,
+    const public_key &base, std::vector<public_key> &derived_keys) {
+    ec_scalar scalar;
+    ge_p3 point1;
+    ge_p3 point2;
+    ge_cached point3;
+    ge_p1p1 point4;
+    ge_p2 point5;
+    if (ge_frombytes_vartime(&point2, &base) != 0) {
+      return false;
+    }
+    // base is added to every output key, so it is converted to the cached form once
+    ge_p3_to_cached(&point3, &point2);
+    derived_keys.resize(outputs_count);
+    for (size_t output_index = 0; output_index < outputs_count; ++output_index) {
+      derivation_to_scalar(derivation, output_index, scalar);
+      ge_scalarmult_base(&point1, &scalar);
+      ge_add(&point4, &point1, &point3);
+      ge_p1p1_to_p2(&point5, &point4);
+      ge_tobytes(&derived_keys[output_index], &point5);
+    }
+    return true;
+  }
+
   void crypto_ops::derive_secret_key(const key_derivation &derivation, size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     ec_scalar scalar;
@@ -124,6 +124,8 @@ namespace crypto {
     friend void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     friend bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
+    static bool derive_public_keys(const key_derivation &, std::size_t, const public_key &, std::vector<public_key> &);
+    friend bool derive_public_keys(const key_derivation &, std::size_t, const public_key &, std::vector<public_key> &);
     static void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     static bool derive_subaddress_public_key(const public_key &, const key_derivation &, std::size_t, public_key &);
@@ -196,6 +198,12 @@ namespace crypto {
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
   }
+  /* Derives public keys of outputs [0, outputs_count) at once; the base key is decompressed only once.
+   */
+  inline bool derive_public_keys(const key_derivation &derivation, std::size_t outputs_count,
+    const public_key &base, std::vector<public_key> &derived_keys) {
+    return crypto_ops::derive_public_keys(derivation, outputs_count, base, derived_keys);
+  }
   inline void derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
     return crypto_ops::derivation_to_scalar(derivation, output_index, res);
   }
@@ -127,7 +127,8 @@
 #define P2P_IDLE_CONNECTION_KILL_INTERVAL               (5*60) //5 minutes
 
 #define P2P_SUPPORT_FLAG_FLUFFY_BLOCKS                  0x01
-#define P2P_SUPPORT_FLAGS                               P2P_SUPPORT_FLAG_FLUFFY_BLOCKS
+#define P2P_SUPPORT_FLAG_SUPERNODE_ANNOUNCE_BATCH       0x02
+#define P2P_SUPPORT_FLAGS                               (P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_SUPERNODE_ANNOUNCE_BATCH)
 
 #define ALLOW_DEBUG_COMMANDS
 
@@ -152,6 +153,7 @@
 #define HASH_OF_HASHES_STEP                     256
 
 #define DEFAULT_TXPOOL_MAX_WEIGHT               648000000ull // 3 days at 300000, in bytes
+#define DEFAULT_TXPOOL_PARSED_TX_CACHE_SIZE     (64*1024*1024) // 64 MB of parsed pool transactions
 
 #define BULLETPROOF_MAX_OUTPUTS                 16
 
@@ -0,0 +1,271 @@
+#include <boost/crc.hpp>
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "misc_log_ex.h"
+#include "append_only_log.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "staketransaction.storage"
+
+using namespace cryptonote;
+
+namespace
+{
+
+const char     LOG_MAGIC[8]       = {'G', 'R', 'F', 'T', 'L', 'O', 'G', 0};
+const uint32_t LOG_VERSION        = 1;
+const size_t   LOG_HEADER_SIZE    = sizeof(LOG_MAGIC) + sizeof(uint32_t);
+const size_t   RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(AppendOnlyLog::record_type);
+
+uint32_t read_uint32(const char* data)
+{
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return boost::endian::little_to_native(value);
+}
+
+void write_uint32(std::string& buffer, uint32_t value)
+{
+  value = boost::endian::native_to_little(value);
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+uint32_t get_checksum(AppendOnlyLog::record_type type, const char* payload, size_t payload_size)
+{
+  boost::crc_32_type crc;
+  crc.process_byte(type);
+  crc.process_bytes(payload, payload_size);
+  return crc.checksum();
+}
+
+void sync_file(std::FILE* file, const std::string& file_name)
+{
+  CHECK_AND_ASSERT_THROW_MES(!fflush(file), "Error at write to log file '" << file_name << "'");
+#ifdef _WIN32
+  CHECK_AND_ASSERT_THROW_MES(!_commit(_fileno(file)), "Error at sync of log file '" << file_name << "'");
+#else
+  CHECK_AND_ASSERT_THROW_MES(!fsync(fileno(file)), "Error at sync of log file '" << file_name << "'");
+#endif
+}
+
+/// Sync directory entry of the file (created or renamed file is not durable until its directory is synced)
+void sync_directory(const std::string& file_name)
+{
+#ifndef _WIN32
+  boost::filesystem::path dir = boost::filesystem::path(file_name).parent_path();
+
+  if (dir.empty())
+    dir = ".";
+
+  int fd = open(dir.string().c_str(), O_RDONLY);
+
+  if (fd < 0)
+  {
+    MWARNING("Can't open directory '" << dir.string() << "' of log file for sync");
+    return;
+  }
+
+  if (fsync(fd))
+    MWARNING("Can't sync directory '" << dir.string() << "' of log file");
+
+  close(fd);
+#endif
+}
+
+}
+
+AppendOnlyLog::AppendOnlyLog(const std::string& file_name)
+  : m_file_name(file_name)
+  , m_records_count()
+{
+}
+
+bool AppendOnlyLog::exists() const
+{
+  return boost::filesystem::exists(m_file_name);
+}
+
+void AppendOnlyLog::write_header(std::string& buffer)
+{
+  buffer.append(LOG_MAGIC, sizeof(LOG_MAGIC));
+  write_uint32(buffer, LOG_VERSION);
+}
+
+void AppendOnlyLog::write_file(std::FILE* file, const std::string& file_name, const std::string& data)
+{
+  CHECK_AND_ASSERT_THROW_MES(fwrite(data.data(), 1, data.size(), file) == data.size(), "Error at write to log file '" << file_name << "'");
+
+  sync_file(file, file_name);
+}
+
+void AppendOnlyLog::write_record(std::string& buffer, record_type type, const std::string& payload)
+{
+  CHECK_AND_ASSERT_THROW_MES(payload.size() <= std::numeric_limits<uint32_t>::max(), "Too large record for log file");
+
+  write_uint32(buffer, static_cast<uint32_t>(payload.size()));
+  write_uint32(buffer, get_checksum(type, payload.data(), payload.size()));
+  buffer.push_back(static_cast<char>(type));
+  buffer.append(payload);
+}
+
+size_t AppendOnlyLog::load(const record_handler& handler)
+{
+  m_file.reset();
+  m_pending_records.clear();
+  m_records_count = 0;
+
+  if (!exists())
+    return 0;
+
+  uint64_t file_size = boost::filesystem::file_size(m_file_name);
+
+  if (!file_size)
+    return 0;
+
+  uint64_t valid_size = 0;
+
+  {
+    boost::interprocess::file_mapping file(m_file_name.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+
+    const char* data = static_cast<const char*>(region.get_address());
+    const size_t size = region.get_size();
+
+    size_t offset = 0;
+
+    if (size >= LOG_HEADER_SIZE) //shorter file is a header which has not been fully written
+    {
+      CHECK_AND_ASSERT_THROW_MES(!memcmp(data, LOG_MAGIC, sizeof(LOG_MAGIC)), "Log file '" << m_file_name << "' has invalid header");
+      CHECK_AND_ASSERT_THROW_MES(read_uint32(data + sizeof(LOG_MAGIC)) == LOG_VERSION, "Log file '" << m_file_name << "' has unsupported version");
+
+      offset = LOG_HEADER_SIZE;
+    }
+
+    std::string payload;
+
+    while (offset && size - offset >= RECORD_HEADER_SIZE)
+    {
+      const uint32_t    payload_size = read_uint32(data + offset);
+      const uint32_t    checksum     = read_uint32(data + offset + sizeof(uint32_t));
+      const record_type type         = static_cast<record_type>(data[offset + 2 * sizeof(uint32_t)]);
+      const char*       payload_data = data + offset + RECORD_HEADER_SIZE;
+
+      if (size - offset - RECORD_HEADER_SIZE < payload_size)
+        break; //incomplete record
+
+      if (get_checksum(type, payload_data, payload_size) != checksum)
+        break; //damaged record
+
+      payload.assign(payload_data, payload_size);
+
+      handler(type, payload);
+
+      offset += RECORD_HEADER_SIZE + payload_size;
+
+      m_records_count++;
+    }
+
+    valid_size = offset;
+  }
+
+  if (valid_size != file_size)
+  {
+    MWARNING("Log file '" << m_file_name << "' has incomplete or damaged tail, " << (file_size - valid_size) << " byte(s) are discarded");
+    boost::filesystem::resize_file(m_file_name, valid_size);
+  }
+
+  return m_records_count;
+}
+
+void AppendOnlyLog::append(record_type type, const std::string& payload)
+{
+  write_record(m_pending_records, type, payload);
+  m_records_count++;
+}
+
+void AppendOnlyLog::flush()
+{
+  if (m_pending_records.empty())
+    return;
+
+  const bool has_header = exists() && boost::filesystem::file_size(m_file_name) >= LOG_HEADER_SIZE;
+  const uint64_t valid_size = has_header ? boost::filesystem::file_size(m_file_name) : 0;
+
+  std::string buffer;
+  const std::string* data = &m_pending_records;
+
+  if (!has_header)
+  {
+    m_file.reset();
+
+    if (exists())
+      boost::filesystem::resize_file(m_file_name, 0); //header has not been fully written
+
+    write_header(buffer);
+    buffer.append(m_pending_records);
+    data = &buffer;
+  }
+
+  if (!m_file)
+  {
+    m_file.reset(fopen(m_file_name.c_str(), "ab"));
+
+    CHECK_AND_ASSERT_THROW_MES(m_file, "Can't open log file '" << m_file_name << "'");
+  }
+
+  try
+  {
+    write_file(m_file.get(), m_file_name, *data);
+  }
+  catch (...)
+  {
+      //don't leave a partially written record in the middle of the log
+
+    m_file.reset();
+    boost::filesystem::resize_file(m_file_name, valid_size);
+    throw;
+  }
+
+  if (!has_header)
+    sync_directory(m_file_name);
+
+  m_pending_records.clear();
+}
+
+void AppendOnlyLog::rewrite(record_type type, const std::string& payload)
+{
+  const std::string tmp_file_name = m_file_name + ".tmp";
+
+  std::string data;
+  write_header(data);
+  write_record(data, type, payload);
+
+  {
+    std::unique_ptr<std::FILE, tools::close_file> tmp_file(fopen(tmp_file_name.c_str(), "wb"));
+
+    CHECK_AND_ASSERT_THROW_MES(tmp_file, "Can't open log file '" << tmp_file_name << "'");
+
+    write_file(tmp_file.get(), tmp_file_name, data);
+  }
+
+  m_file.reset();
+
+  boost::filesystem::rename(tmp_file_name, m_file_name);
+
+  sync_directory(m_file_name);
+
+  m_pending_records.clear();
+  m_records_count = 1;
+}
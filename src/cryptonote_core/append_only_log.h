@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "common/util.h"
+
+namespace cryptonote
+{
+
+/// Append-only file of checksummed records.
+///
+/// File layout: [magic:8][version:32] followed by records [payload size:32][crc32:32][type:8][payload].
+/// The checksum covers type and payload. A record which is not fully written (crash during append) or damaged
+/// is detected at load and the log is truncated to the last valid record, so only whole records are ever applied.
+/// Written records are synced to disk before flush and rewrite return.
+class AppendOnlyLog
+{
+public:
+  typedef uint8_t record_type;
+  typedef std::function<void(record_type type, const std::string& payload)> record_handler;
+
+  /// Constructors
+  explicit AppendOnlyLog(const std::string& file_name);
+
+  /// Log file name
+  const std::string& file_name() const { return m_file_name; }
+
+  /// Does log file exist
+  bool exists() const;
+
+  /// Read all records of the log file (memory mapped) and return number of records
+  size_t load(const record_handler& handler);
+
+  /// Queue record for writing
+  void append(record_type type, const std::string& payload);
+
+  /// Write queued records to the end of the log file and sync them to disk
+  void flush();
+
+  /// Atomically replace the log file with a single record (used for compaction and migration)
+  void rewrite(record_type type, const std::string& payload);
+
+  /// Number of records in the log including queued ones
+  size_t records_count() const { return m_records_count; }
+
+  /// Are there queued records
+  bool has_pending_records() const { return !m_pending_records.empty(); }
+
+private:
+  static void write_header(std::string& buffer);
+  static void write_record(std::string& buffer, record_type type, const std::string& payload);
+  static void write_file(std::FILE* file, const std::string& file_name, const std::string& data);
+
+private:
+  std::string m_file_name;
+  std::unique_ptr<std::FILE, tools::close_file> m_file;
+  std::string m_pending_records;
+  size_t m_records_count;
+};
+
+}
@@ -12,32 +12,194 @@ namespace
 const size_t BLOCKCHAIN_BASED_LIST_SIZE = 32; //TODO: configuration parameter
 const size_t PREVIOS_BLOCKCHAIN_BASED_LIST_MAX_SIZE = 16; //TODO: configuration parameter
 const size_t BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH   = 1000;
+const size_t LOG_COMPACTION_RECORDS_COUNT = BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH; //log is replaced with a snapshot when it has more records
+const size_t SHARED_LISTS_DEPTH = config::graft::SUPERNODE_HISTORY_SIZE; //lists of the recent blocks which are kept built after request
+
+enum : AppendOnlyLog::record_type
+{
+  LOG_RECORD_SNAPSHOT        = 1, //blockchain_based_list_container
+  LOG_RECORD_ADD_BLOCK       = 2, //blockchain_based_list_block_data (read only, written by earlier versions)
+  LOG_RECORD_REMOVE_BLOCK    = 3, //no payload
+  LOG_RECORD_ADD_BLOCK_DELTA = 4, //blockchain_based_list_block_delta
+};
+
+struct blockchain_based_list_block_data
+{
+  uint64_t block_height;
+  BlockchainBasedList::supernode_tier_array& tiers;
+
+  blockchain_based_list_block_data(uint64_t block_height, BlockchainBasedList::supernode_tier_array& tiers)
+    : block_height(block_height), tiers(tiers) {}
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(block_height)
+    FIELD(tiers)
+  END_SERIALIZE()
+};
+
+/// Tier of a block relative to the same tier of the previous block
+struct blockchain_based_list_tier_delta
+{
+  std::vector<uint32_t> items; //index in the previous tier, or size of the previous tier plus index in added_supernodes
+  std::vector<BlockchainBasedList::supernode> added_supernodes;
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(items)
+    FIELD(added_supernodes)
+  END_SERIALIZE()
+};
+
+struct blockchain_based_list_block_delta
+{
+  uint64_t block_height;
+  std::vector<blockchain_based_list_tier_delta> tiers;
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(block_height)
+    FIELD(tiers)
+  END_SERIALIZE()
+};
 
 }
 
-BlockchainBasedList::BlockchainBasedList(const std::string& m_storage_file_name, uint64_t first_block_number)
-  : m_storage_file_name(m_storage_file_name)
+BlockchainBasedList::BlockchainBasedList(const std::string& file_name, uint64_t first_block_number, const std::string& legacy_file_name)
+  : m_log(file_name)
+  , m_history_begin()
   , m_block_height(first_block_number)
+  , m_supernode_indexes(0, supernode_index_hash{this}, supernode_index_equal{this})
   , m_history_depth()
   , m_first_block_number(first_block_number)
   , m_need_store()
 {
-  load();
+  load(legacy_file_name);
+}
+
+const BlockchainBasedList::supernode_index BlockchainBasedList::PROBE_INDEX;
+
+size_t BlockchainBasedList::supernode_index_hash::operator()(supernode_index index) const
+{
+  const supernode& sn = list->supernode_value(index);
+  size_t hash;
+  static_assert(sizeof(sn.supernode_public_id) >= sizeof(hash), "public key is too small");
+  memcpy(&hash, &sn.supernode_public_id, sizeof(hash)); //public key is random enough
+  return hash ^ sn.amount ^ (sn.block_height << 32);
 }
 
-const BlockchainBasedList::supernode_tier_array& BlockchainBasedList::tiers(size_t depth) const
+bool BlockchainBasedList::supernode_index_equal::operator()(supernode_index index1, supernode_index index2) const
+{
+  const supernode& sn1 = list->supernode_value(index1);
+  const supernode& sn2 = list->supernode_value(index2);
+  return sn1.supernode_public_id == sn2.supernode_public_id && sn1.supernode_public_address == sn2.supernode_public_address &&
+         sn1.amount == sn2.amount && sn1.block_height == sn2.block_height && sn1.unlock_time == sn2.unlock_time;
+}
+
+const BlockchainBasedList::tier_index_array& BlockchainBasedList::history_tiers(size_t depth) const
 {
   if (depth >= m_history_depth)
     throw std::runtime_error("internal error: attempt to get tier which is not present in a blockchain based list");
 
-  if (!depth)
-    return m_history.back();
+  return m_history[history_slot(depth)];
+}
+
+void BlockchainBasedList::materialize_tiers(const tier_index_array& src_tiers, supernode_tier_array& dst_tiers) const
+{
+  dst_tiers.resize(src_tiers.size());
+
+  for (size_t i=0; i<src_tiers.size(); i++)
+  {
+    dst_tiers[i].clear();
+    dst_tiers[i].reserve(src_tiers[i].size());
+
+    for (supernode_index index : src_tiers[i])
+      dst_tiers[i].push_back(m_supernodes[index].value);
+  }
+}
+
+BlockchainBasedList::supernode_tier_array_ptr BlockchainBasedList::tiers(size_t depth) const
+{
+  const tier_index_array& src_tiers = history_tiers(depth);
+
+  if (depth >= SHARED_LISTS_DEPTH)
+  {
+    std::shared_ptr<supernode_tier_array> result = std::make_shared<supernode_tier_array>();
+    materialize_tiers(src_tiers, *result);
+    return result;
+  }
+
+  supernode_tier_array_ptr& list = m_history_lists[history_slot(depth)];
+
+  if (!list)
+  {
+    std::shared_ptr<supernode_tier_array> result = std::make_shared<supernode_tier_array>();
+    materialize_tiers(src_tiers, *result);
+    list = std::move(result);
+  }
+
+  return list;
+}
 
-  list_history::const_reverse_iterator it = m_history.rbegin();
+BlockchainBasedList::supernode_index BlockchainBasedList::find_supernode(const supernode& sn) const
+{
+  m_probe_supernode = sn;
 
-  std::advance(it, depth);
+  auto it = m_supernode_indexes.find(PROBE_INDEX);
 
-  return *it;
+  return it != m_supernode_indexes.end() ? *it : PROBE_INDEX;
+}
+
+BlockchainBasedList::supernode_index BlockchainBasedList::intern_supernode(const supernode& sn)
+{
+  supernode_index found_index = find_supernode(sn);
+
+  if (found_index != PROBE_INDEX)
+  {
+    m_supernodes[found_index].refs_count++;
+    return found_index;
+  }
+
+  supernode_index index;
+
+  if (!m_free_supernodes.empty())
+  {
+    index = m_free_supernodes.back();
+    m_free_supernodes.pop_back();
+  }
+  else
+  {
+    CHECK_AND_ASSERT_THROW_MES(m_supernodes.size() < PROBE_INDEX, "internal error: too many supernodes in blockchain based list");
+
+    index = static_cast<supernode_index>(m_supernodes.size());
+    m_supernodes.emplace_back();
+  }
+
+  supernode_record& record = m_supernodes[index];
+
+  record.value      = sn;
+  record.refs_count = 1;
+
+  m_supernode_indexes.insert(index);
+
+  return index;
+}
+
+void BlockchainBasedList::release_supernodes(const tier_index_array& tiers)
+{
+  for (const std::vector<supernode_index>& tier : tiers)
+  {
+    for (supernode_index index : tier)
+    {
+      supernode_record& record = m_supernodes[index];
+
+      if (--record.refs_count)
+        continue;
+
+      m_supernode_indexes.erase(index);
+
+      record.value = supernode();
+
+      m_free_supernodes.push_back(index);
+    }
+  }
 }
 
 void BlockchainBasedList::select_supernodes(size_t items_count, const supernode_array& src_list, supernode_array& dst_list)
@@ -82,20 +244,22 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
       //prepare lists of valid supernodes for this tier
 
-    if (!m_history.empty())
+    if (m_history_depth)
     {
-      const supernode_array& full_prev_supernodes = m_history.back()[i];
+      const std::vector<supernode_index>& full_prev_supernodes = history_tiers(0)[i];
 
       prev_supernodes.reserve(full_prev_supernodes.size());
 
-      for (const supernode& sn : full_prev_supernodes)
+      supernode_stake stake;
+
+      for (supernode_index index : full_prev_supernodes)
       {
-        const supernode_stake* stake = stake_txs_storage.find_supernode_stake(block_height, sn.supernode_public_id);
+        const supernode& sn = m_supernodes[index].value;
 
-        if (!stake || !stake->amount)
+        if (!stake_txs_storage.find_supernode_stake(block_height, sn.supernode_public_id, stake) || !stake.amount)
           continue;
 
-        if (stake->tier != i + 1)
+        if (stake.tier != i + 1)
           continue;
 
         prev_supernodes.push_back(sn);
@@ -130,10 +294,11 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
     m_rng.seed(seed);
 
-      //sort valid supernodes by the age of stake
+      //sort valid supernodes by the age of stake (binary keys are ordered the same way as their hex representation)
 
     std::stable_sort(current_supernodes.begin(), current_supernodes.end(), [](const supernode& s1, const supernode& s2) {
-      return s1.block_height < s2.block_height || (s1.block_height == s2.block_height && s1.supernode_public_id < s2.supernode_public_id);
+      return s1.block_height < s2.block_height || (s1.block_height == s2.block_height &&
+        memcmp(&s1.supernode_public_id, &s2.supernode_public_id, sizeof(crypto::public_key)) < 0);
     });
 
       //select supernodes from the previous list
@@ -170,19 +335,162 @@ void BlockchainBasedList::apply_block(uint64_t block_height, const crypto::hash&
 
     //update history
 
-  m_history.emplace_back(std::move(new_tier));
+  m_log.append(LOG_RECORD_ADD_BLOCK_DELTA, make_block_delta(block_height, new_tier));
 
-  if (m_history_depth < BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH)
+  add_tiers(block_height, new_tier);
+
+  m_need_store = true;
+}
+
+std::string BlockchainBasedList::make_block_delta(uint64_t block_height, const supernode_tier_array& tiers) const
+{
+  blockchain_based_list_block_delta delta;
+
+  delta.block_height = block_height;
+  delta.tiers.resize(tiers.size());
+
+  std::unordered_map<supernode_index, uint32_t> prev_positions;
+
+  for (size_t i=0; i<tiers.size(); i++)
   {
+    blockchain_based_list_tier_delta& dst_tier = delta.tiers[i];
+
+    prev_positions.clear();
+
+    size_t prev_tier_size = 0;
+
+    if (m_history_depth && i < history_tiers(0).size())
+    {
+      const std::vector<supernode_index>& prev_tier = history_tiers(0)[i];
+
+      prev_tier_size = prev_tier.size();
+
+      for (size_t j=0; j<prev_tier.size(); j++)
+        prev_positions.emplace(prev_tier[j], static_cast<uint32_t>(j));
+    }
+
+    dst_tier.items.reserve(tiers[i].size());
+
+    for (const supernode& sn : tiers[i])
+    {
+      supernode_index index = find_supernode(sn);
+
+      if (index != PROBE_INDEX)
+      {
+        auto position_it = prev_positions.find(index);
+
+        if (position_it != prev_positions.end())
+        {
+          dst_tier.items.push_back(position_it->second);
+          continue;
+        }
+      }
+
+      dst_tier.items.push_back(static_cast<uint32_t>(prev_tier_size + dst_tier.added_supernodes.size()));
+      dst_tier.added_supernodes.push_back(sn);
+    }
+  }
+
+  std::string payload;
+
+  CHECK_AND_ASSERT_THROW_MES(::serialization::dump_binary(delta, payload), "internal error: failed to serialize blockchain based list of block #" << block_height);
+
+  return payload;
+}
+
+void BlockchainBasedList::apply_block_delta(const std::string& payload)
+{
+  blockchain_based_list_block_delta delta;
+
+  CHECK_AND_ASSERT_THROW_MES(::serialization::parse_binary(payload, delta), "internal error: failed to deserialize blockchain based list log record");
+
+  supernode_tier_array tiers(delta.tiers.size());
+
+  for (size_t i=0; i<delta.tiers.size(); i++)
+  {
+    const blockchain_based_list_tier_delta& src_tier = delta.tiers[i];
+
+    static const std::vector<supernode_index> empty_tier;
+    const std::vector<supernode_index>& prev_tier = m_history_depth && i < history_tiers(0).size() ? history_tiers(0)[i] : empty_tier;
+
+    tiers[i].reserve(src_tier.items.size());
+
+    for (uint32_t item : src_tier.items)
+    {
+      if (item < prev_tier.size())
+      {
+        tiers[i].push_back(m_supernodes[prev_tier[item]].value);
+        continue;
+      }
+
+      CHECK_AND_ASSERT_THROW_MES(item - prev_tier.size() < src_tier.added_supernodes.size(), "internal error: invalid blockchain based list log record");
+
+      tiers[i].push_back(src_tier.added_supernodes[item - prev_tier.size()]);
+    }
+  }
+
+  add_tiers(delta.block_height, tiers);
+}
+
+void BlockchainBasedList::add_tiers(uint64_t block_height, const supernode_tier_array& tiers)
+{
+  if (block_height != m_block_height + 1)
+    throw std::runtime_error("block_height should be next after the block already processed");
+
+  if (m_history.empty())
+  {
+    m_history.resize(BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH);
+    m_history_lists.resize(BLOCKCHAIN_BASED_LISTS_HISTORY_DEPTH);
+  }
+
+    //reuse the slot of the oldest list when the history is full
+
+  tier_index_array* slot = nullptr;
+
+  if (m_history_depth < m_history.size())
+  {
+    slot = &m_history[(m_history_begin + m_history_depth) % m_history.size()];
     m_history_depth++;
   }
   else
   {
-    m_history.pop_front();
+    slot = &m_history[m_history_begin];
+    release_supernodes(*slot);
+    m_history_lists[m_history_begin].reset();
+    m_history_begin = (m_history_begin + 1) % m_history.size();
+  }
+
+  slot->resize(tiers.size());
+
+  for (size_t i=0; i<tiers.size(); i++)
+  {
+    std::vector<supernode_index>& dst_tier = (*slot)[i];
+
+    dst_tier.clear();
+    dst_tier.reserve(tiers[i].size());
+
+    for (const supernode& sn : tiers[i])
+      dst_tier.push_back(intern_supernode(sn));
   }
 
   m_block_height = block_height;
-  m_need_store = true;
+
+    //list which is not recent anymore is built again on request
+
+  if (m_history_depth > SHARED_LISTS_DEPTH)
+    m_history_lists[history_slot(SHARED_LISTS_DEPTH)].reset();
+}
+
+void BlockchainBasedList::clear_history()
+{
+  m_history.clear();
+  m_history_lists.clear();
+  m_supernodes.clear();
+  m_free_supernodes.clear();
+  m_supernode_indexes.clear();
+
+  m_history_begin = 0;
+  m_history_depth = 0;
 }
 
 void BlockchainBasedList::remove_latest_block()
@@ -190,14 +498,28 @@ void BlockchainBasedList::remove_latest_block()
   if (!m_history_depth)
     return;
 
+  remove_latest_block_impl();
+
+  m_log.append(LOG_RECORD_REMOVE_BLOCK, std::string());
+
   m_need_store = true;
+}
+
+void BlockchainBasedList::remove_latest_block_impl()
+{
+  if (!m_history_depth)
+    return;
+
+  const size_t slot = history_slot(0);
+
+  release_supernodes(m_history[slot]);
+  m_history[slot].clear();
+  m_history_lists[slot].reset();
 
   m_block_height--;
   m_history_depth--;
 
-  m_history.pop_back();
-
-  if (m_history.empty())
+  if (!m_history_depth)
     m_block_height = m_first_block_number;
 }
 
@@ -224,53 +546,137 @@ struct blockchain_based_list_container
 
 void BlockchainBasedList::store() const
 {
-  blockchain_based_list_container data(m_block_height, m_history_depth, const_cast<list_history&>(m_history));
+  if (m_log.records_count() > LOG_COMPACTION_RECORDS_COUNT)
+  {
+    MDEBUG("Compact blockchain based list log");
+    m_log.rewrite(LOG_RECORD_SNAPSHOT, make_snapshot());
+  }
+  else
+  {
+    m_log.flush();
+  }
 
-  std::ofstream ostr;
-  ostr.open(m_storage_file_name, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+  m_need_store = false;
+}
 
-  binary_archive<true> oar(ostr);
+std::string BlockchainBasedList::make_snapshot() const
+{
+  list_history history;
 
-  bool success = ::serialization::serialize(oar, data);
+  for (size_t depth=m_history_depth; depth--;)
+  {
+    history.emplace_back();
+    materialize_tiers(history_tiers(depth), history.back());
+  }
 
-  ostr.close();
+  blockchain_based_list_container data(m_block_height, m_history_depth, history);
 
-  CHECK_AND_ASSERT_THROW_MES(success && ostr.good(), "Error at save blockchain based list file '" << m_storage_file_name << "'");
+  std::string snapshot;
 
-  m_need_store = false;
+  CHECK_AND_ASSERT_THROW_MES(::serialization::dump_binary(data, snapshot), "internal error: failed to serialize blockchain based list");
+
+  return snapshot;
 }
 
-void BlockchainBasedList::load()
+void BlockchainBasedList::apply_snapshot(const std::string& snapshot)
 {
-  if (!boost::filesystem::exists(m_storage_file_name))
-    return;
+  list_history new_history;
+  blockchain_based_list_container data(0, 0, new_history);
 
-  std::string buffer;
-  bool r = epee::file_io_utils::load_file_to_string(m_storage_file_name, buffer);
+  bool r = ::serialization::parse_binary(snapshot, data);
 
-  CHECK_AND_ASSERT_THROW_MES(r, "blockchain based list file '" << m_storage_file_name << "' is not found");
+  CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize blockchain based list");
 
-  try
+  CHECK_AND_ASSERT_THROW_MES(data.history_depth == new_history.size() && data.block_height >= new_history.size(),
+    "internal error: inconsistent blockchain based list snapshot");
+
+  clear_history();
+
+  m_block_height = data.block_height - new_history.size();
+
+  for (const supernode_tier_array& tiers : new_history)
+    add_tiers(m_block_height + 1, tiers);
+
+  m_block_height = data.block_height;
+}
+
+void BlockchainBasedList::apply_log_record(AppendOnlyLog::record_type type, const std::string& payload)
+{
+  switch (type)
   {
-    LOG_PRINT_L0("Trying to parse blockchain based list");
+    case LOG_RECORD_SNAPSHOT:
+      apply_snapshot(payload);
+      break;
+    case LOG_RECORD_ADD_BLOCK:
+    {
+      supernode_tier_array tiers;
+      blockchain_based_list_block_data data(0, tiers);
 
-    list_history new_history;
-    blockchain_based_list_container data(0, 0, new_history);
+      CHECK_AND_ASSERT_THROW_MES(::serialization::parse_binary(payload, data), "internal error: failed to deserialize blockchain based list log record");
 
-    r = ::serialization::parse_binary(buffer, data);
+      add_tiers(data.block_height, tiers);
 
-    CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize blockchain based list file '" << m_storage_file_name << "'");
+      break;
+    }
+    case LOG_RECORD_ADD_BLOCK_DELTA:
+      apply_block_delta(payload);
+      break;
+    case LOG_RECORD_REMOVE_BLOCK:
+      remove_latest_block_impl();
+      break;
+    default:
+      throw std::runtime_error("internal error: unknown blockchain based list log record type " + std::to_string(type));
+  }
+}
 
-    m_block_height  = data.block_height;
-    m_history_depth = data.history_depth;
+void BlockchainBasedList::load(const std::string& legacy_file_name)
+{
+  if (m_log.exists())
+  {
+    LOG_PRINT_L0("Trying to load blockchain based list log");
 
-    std::swap(m_history, data.history);
+    try
+    {
+      m_log.load([this](AppendOnlyLog::record_type type, const std::string& payload) { apply_log_record(type, payload); });
+    }
+    catch (...)
+    {
+      LOG_PRINT_L0("Can't load blockchain based list log file '" << m_log.file_name() << "'");
+      throw;
+    }
 
     m_need_store = false;
+
+    return;
+  }
+
+  if (legacy_file_name.empty() || !boost::filesystem::exists(legacy_file_name))
+    return;
+
+    //one-time migration from the file of the previous format
+
+  std::string buffer;
+  bool r = epee::file_io_utils::load_file_to_string(legacy_file_name, buffer);
+
+  CHECK_AND_ASSERT_THROW_MES(r, "blockchain based list file '" << legacy_file_name << "' is not found");
+
+  try
+  {
+    LOG_PRINT_L0("Trying to parse blockchain based list");
+
+    apply_snapshot(buffer);
   }
   catch (...)
   {
-    LOG_PRINT_L0("Can't parse blockchain based list file '" << m_storage_file_name << "'");
+    LOG_PRINT_L0("Can't parse blockchain based list file '" << legacy_file_name << "'");
     throw;
   }
+
+  m_log.rewrite(LOG_RECORD_SNAPSHOT, make_snapshot());
+
+  boost::filesystem::remove(legacy_file_name);
+
+  LOG_PRINT_L0("Blockchain based list file '" << legacy_file_name << "' has been migrated to '" << m_log.file_name() << "'");
+
+  m_need_store = false;
 }
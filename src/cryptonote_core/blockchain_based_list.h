@@ -1,6 +1,9 @@
 #pragma once
 
+#include <memory>
 #include <random>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "blockchain.h"
 #include "serialization/crypto.h"
@@ -17,7 +20,7 @@ class BlockchainBasedList
 public:
   struct supernode
   {    
-    std::string supernode_public_id;
+    crypto::public_key supernode_public_id;
     cryptonote::account_public_address supernode_public_address;
     uint64_t amount;
     uint64_t block_height;
@@ -27,7 +30,7 @@ public:
       FIELD(amount)
       FIELD(block_height)
       FIELD(unlock_time)
-      FIELD(supernode_public_id)
+      SUPERNODE_PUBLIC_ID_FIELD(supernode_public_id)
       FIELD(supernode_public_address)
     END_SERIALIZE()
   };
@@ -35,12 +38,16 @@ public:
   typedef std::vector<supernode>           supernode_array;
   typedef std::vector<supernode_array>     supernode_tier_array;
   typedef std::list<supernode_tier_array>  list_history;
+  typedef std::shared_ptr<const supernode_tier_array> supernode_tier_array_ptr;
 
-  /// Constructors
-  BlockchainBasedList(const std::string& file_name, uint64_t first_block_number);
+  /// Constructors; list is stored as an append-only log, the file of the previous format (if any) is migrated to it at first start
+  BlockchainBasedList(const std::string& file_name, uint64_t first_block_number, const std::string& legacy_file_name = std::string());
 
-  /// List of tiers
-  const supernode_tier_array& tiers(size_t depth = 0) const;
+  BlockchainBasedList(const BlockchainBasedList&) = delete;
+  BlockchainBasedList& operator=(const BlockchainBasedList&) = delete;
+
+  /// List of tiers (depth is counted from the latest block); lists of the recent blocks are built once and shared
+  supernode_tier_array_ptr tiers(size_t depth = 0) const;
 
   /// Height of the corresponding block
   uint64_t block_height() const { return m_block_height; }
@@ -48,28 +55,96 @@ public:
   /// Number of blocks in history
   uint64_t history_depth() const { return m_history_depth; }
 
+  /// Number of distinct supernode records referenced by the history
+  size_t supernodes_count() const { return m_supernode_indexes.size(); }
+
   /// Apply new block on top of the list
   void apply_block(uint64_t block_height, const crypto::hash& block_hash, StakeTransactionStorage& stake_txs);
 
   /// Remove latest block
   void remove_latest_block();
 
-  /// Save list to file
+  /// Write changes to the log file
   void store() const;
 
   /// Is the list requires store
   bool need_store() const { return m_need_store; }
 
 private:
-  /// Load list from file
-  void load();
+  /// Load list from log file or migrate it from the legacy file
+  void load(const std::string& legacy_file_name);
+
+  /// Apply record of the log file
+  void apply_log_record(AppendOnlyLog::record_type type, const std::string& payload);
+
+  /// Serialize/deserialize whole list
+  std::string make_snapshot() const;
+  void apply_snapshot(const std::string& snapshot);
+
+  /// Serialize/deserialize list of a new block as a change of the latest list
+  std::string make_block_delta(uint64_t block_height, const supernode_tier_array& tiers) const;
+  void apply_block_delta(const std::string& payload);
+
+  void add_tiers(uint64_t block_height, const supernode_tier_array& tiers);
+  void remove_latest_block_impl();
+  void clear_history();
+
+  typedef uint32_t supernode_index;
+  typedef std::vector<std::vector<supernode_index>> tier_index_array;
+
+  /// Interned supernode record shared by lists of all heights
+  struct supernode_record
+  {
+    supernode value;
+    size_t refs_count;
+  };
+
+  /// Hash and equality of interned records by their values, so the set of indexes needs no copy of the values
+  struct supernode_index_hash
+  {
+    const BlockchainBasedList* list;
+    size_t operator()(supernode_index) const;
+  };
+
+  struct supernode_index_equal
+  {
+    const BlockchainBasedList* list;
+    bool operator()(supernode_index, supernode_index) const;
+  };
+
+  /// Index which refers to m_probe_supernode for lookups of a value which may be not interned yet
+  static const supernode_index PROBE_INDEX = static_cast<supernode_index>(-1);
+
+  const supernode& supernode_value(supernode_index index) const { return index == PROBE_INDEX ? m_probe_supernode : m_supernodes[index].value; }
+
+  /// Index of interned record equal to the supernode, PROBE_INDEX if there is no such record
+  supernode_index find_supernode(const supernode&) const;
+
+  /// List of tiers at the specified depth
+  const tier_index_array& history_tiers(size_t depth) const;
+  size_t history_slot(size_t depth) const { return (m_history_begin + m_history_depth - 1 - depth) % m_history.size(); }
+
+  /// Build list of supernodes from indexes
+  void materialize_tiers(const tier_index_array& src_tiers, supernode_tier_array& dst_tiers) const;
+
+  /// Find or add supernode record and take reference to it
+  supernode_index intern_supernode(const supernode&);
+
+  /// Release references to supernode records of the list
+  void release_supernodes(const tier_index_array&);
 
   /// Select supernodes from a list
   void select_supernodes(size_t max_items_count, const supernode_array& src_list, supernode_array& dst_list);
 
 private:
-  std::string m_storage_file_name;
-  list_history m_history;
+  mutable AppendOnlyLog m_log;
+  std::vector<tier_index_array> m_history; //ring buffer of lists, m_history_depth items starting from m_history_begin
+  mutable std::vector<supernode_tier_array_ptr> m_history_lists; //lists built from the recent slots of m_history
+  size_t m_history_begin;
+  std::vector<supernode_record> m_supernodes;
+  std::vector<supernode_index> m_free_supernodes;
+  std::unordered_set<supernode_index, supernode_index_hash, supernode_index_equal> m_supernode_indexes;
+  mutable supernode m_probe_supernode;
   uint64_t m_block_height;
   size_t m_history_depth;
   std::mt19937_64 m_rng;
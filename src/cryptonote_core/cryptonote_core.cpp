@@ -753,107 +753,49 @@ namespace cryptonote
     bad_semantics_txes_lock.unlock();
   }
   //-----------------------------------------------------------------------------------------------
-  static bool is_canonical_bulletproof_layout(const std::vector<rct::Bulletproof> &proofs)
+  bool core::check_tx_semantic_unbatched(const transaction &tx, const crypto::hash &tx_hash, bool keeped_by_block, tx_verification_context &tvc)
   {
-    if (proofs.size() != 1)
-      return false;
-    const size_t sz = proofs[0].V.size();
-    if (sz == 0 || sz > BULLETPROOF_MAX_OUTPUTS)
+    if (!check_tx_semantic(tx, keeped_by_block) || (tx.version >= 2 && !check_rct_semantics_unbatched(tx)))
+    {
+      set_semantics_failed(tx_hash);
+      tvc.m_verifivation_failed = true;
       return false;
+    }
     return true;
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block)
   {
-    bool ret = true;
     if (keeped_by_block && get_blockchain_storage().is_within_compiled_block_hash_area())
     {
       MTRACE("Skipping semantics check for tx kept by block in embedded hash area");
       return true;
     }
 
+    // signatures which can be batched are verified in one go, the others were checked per tx
     std::vector<const rct::rctSig*> rvv;
+    std::vector<size_t> rvv_tx;
     for (size_t n = 0; n < tx_info.size(); ++n)
     {
-      if (!check_tx_semantic(*tx_info[n].tx, keeped_by_block))
-      {
-        set_semantics_failed(tx_info[n].tx_hash);
-        tx_info[n].tvc.m_verifivation_failed = true;
-        tx_info[n].result = false;
-        continue;
-      }
-
-      if (tx_info[n].tx->version < 2)
+      if (!tx_info[n].result || tx_info[n].tx->version < 2 || !is_rct_semantics_batchable(tx_info[n].tx->rct_signatures))
         continue;
-      const rct::rctSig &rv = tx_info[n].tx->rct_signatures;
-      switch (rv.type) {
-        case rct::RCTTypeNull:
-          // coinbase should not come here, so we reject for all other types
-          MERROR_VER("Unexpected Null rctSig type");
-          set_semantics_failed(tx_info[n].tx_hash);
-          tx_info[n].tvc.m_verifivation_failed = true;
-          tx_info[n].result = false;
-          break;
-        case rct::RCTTypeSimple:
-          if (!rct::verRctSemanticsSimple(rv))
-          {
-            MERROR_VER("rct signature semantics check failed");
-            set_semantics_failed(tx_info[n].tx_hash);
-            tx_info[n].tvc.m_verifivation_failed = true;
-            tx_info[n].result = false;
-            break;
-          }
-          break;
-        case rct::RCTTypeFull:
-          if (!rct::verRct(rv, true))
-          {
-            MERROR_VER("rct signature semantics check failed");
-            set_semantics_failed(tx_info[n].tx_hash);
-            tx_info[n].tvc.m_verifivation_failed = true;
-            tx_info[n].result = false;
-            break;
-          }
-          break;
-        case rct::RCTTypeBulletproof:
-          if (!is_canonical_bulletproof_layout(rv.p.bulletproofs))
-          {
-            MERROR_VER("Bulletproof does not have canonical form");
-            set_semantics_failed(tx_info[n].tx_hash);
-            tx_info[n].tvc.m_verifivation_failed = true;
-            tx_info[n].result = false;
-            break;
-          }
-          rvv.push_back(&rv); // delayed batch verification
-          break;
-        default:
-          MERROR_VER("Unknown rct type: " << rv.type);
-          set_semantics_failed(tx_info[n].tx_hash);
-          tx_info[n].tvc.m_verifivation_failed = true;
-          tx_info[n].result = false;
-          break;
-      }
+      rvv.push_back(&tx_info[n].tx->rct_signatures);
+      rvv_tx.push_back(n);
     }
-    if (!rvv.empty() && !rct::verRctSemanticsSimple(rvv))
+
+    std::vector<uint8_t> valid;
+    if (verify_rct_semantics_batch(rvv, valid))
+      return true;
+    for (size_t i = 0; i < rvv.size(); ++i)
     {
-      LOG_PRINT_L1("One transaction among this group has bad semantics, verifying one at a time");
-      ret = false;
-      const bool assumed_bad = rvv.size() == 1; // if there's only one tx, it must be the bad one
-      for (size_t n = 0; n < tx_info.size(); ++n)
-      {
-        if (!tx_info[n].result)
-          continue;
-        if (tx_info[n].tx->rct_signatures.type != rct::RCTTypeBulletproof)
-          continue;
-        if (assumed_bad || !rct::verRctSemanticsSimple(tx_info[n].tx->rct_signatures))
-        {
-          set_semantics_failed(tx_info[n].tx_hash);
-          tx_info[n].tvc.m_verifivation_failed = true;
-          tx_info[n].result = false;
-        }
-      }
+      if (valid[i])
+        continue;
+      tx_verification_batch_info &info = tx_info[rvv_tx[i]];
+      set_semantics_failed(info.tx_hash);
+      info.tvc.m_verifivation_failed = true;
+      info.result = false;
     }
-
-    return ret;
+    return false;
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_txs(const std::vector<blobdata>& tx_blobs, std::vector<tx_verification_context>& tvc, bool keeped_by_block, bool relayed, bool do_not_relay)
@@ -882,6 +824,8 @@ namespace cryptonote
       });
     }
     waiter.wait(&tpool);
+    // semantics are checked in parallel too, except for RCT signatures which are batched below
+    const bool check_semantics = !keeped_by_block || !m_blockchain_storage.is_within_compiled_block_hash_area();
     it = tx_blobs.begin();
     std::vector<bool> already_have(tx_blobs.size(), false);
     for (size_t i = 0; i < tx_blobs.size(); i++, ++it) {
@@ -903,6 +847,8 @@ namespace cryptonote
           try
           {
             results[i].res = handle_incoming_tx_post(*it, tvc[i], results[i].tx, results[i].hash, results[i].prefix_hash, keeped_by_block, relayed, do_not_relay);
+            if (results[i].res && check_semantics)
+              results[i].res = check_tx_semantic_unbatched(results[i].tx, results[i].hash, keeped_by_block, tvc[i]);
           }
           catch (const std::exception &e)
           {
@@ -888,6 +888,14 @@ namespace cryptonote
 
      bool handle_incoming_tx_pre(const blobdata& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash, crypto::hash &tx_prefixt_hash, bool keeped_by_block, bool relayed, bool do_not_relay);
      bool handle_incoming_tx_post(const blobdata& tx_blob, tx_verification_context& tvc, cryptonote::transaction &tx, crypto::hash &tx_hash, crypto::hash &tx_prefixt_hash, bool keeped_by_block, bool relayed, bool do_not_relay);
+     /**
+      * @brief per transaction semantic checks of an incoming transaction, safe to run in parallel
+      *
+      * RCT signatures which can be batched are left to handle_incoming_tx_accumulated_batch.
+      *
+      * @return false if the transaction has bad semantics
+      */
+     bool check_tx_semantic_unbatched(const transaction &tx, const crypto::hash &tx_hash, bool keeped_by_block, tx_verification_context &tvc);
      struct tx_verification_batch_info { const cryptonote::transaction *tx; crypto::hash tx_hash; tx_verification_context &tvc; bool &result; };
      bool handle_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool keeped_by_block);
 
@@ -46,6 +46,8 @@ using namespace epee;
 
 using namespace crypto;
 
+#define MERROR_VER(x) MCERROR("verify", x)
+
 namespace cryptonote
 {
   //---------------------------------------------------------------
@@ -715,6 +717,70 @@ namespace cryptonote
     return true;
   }
 
+  //---------------------------------------------------------------
+  static bool is_canonical_bulletproof_layout(const std::vector<rct::Bulletproof> &proofs)
+  {
+    if (proofs.size() != 1)
+      return false;
+    const size_t sz = proofs[0].V.size();
+    if (sz == 0 || sz > BULLETPROOF_MAX_OUTPUTS)
+      return false;
+    return true;
+  }
+  //---------------------------------------------------------------
+  bool is_rct_semantics_batchable(const rct::rctSig &rv)
+  {
+    return rv.type == rct::RCTTypeSimple || rv.type == rct::RCTTypeBulletproof;
+  }
+  //---------------------------------------------------------------
+  bool check_rct_semantics_unbatched(const transaction &tx)
+  {
+    const rct::rctSig &rv = tx.rct_signatures;
+    switch (rv.type) {
+      case rct::RCTTypeNull:
+        // coinbase should not come here, so we reject for all other types
+        MERROR_VER("Unexpected Null rctSig type");
+        return false;
+      case rct::RCTTypeSimple:
+        return true; // batched
+      case rct::RCTTypeFull:
+        if (!rct::verRct(rv, true))
+        {
+          MERROR_VER("rct signature semantics check failed");
+          return false;
+        }
+        return true;
+      case rct::RCTTypeBulletproof:
+        if (!is_canonical_bulletproof_layout(rv.p.bulletproofs))
+        {
+          MERROR_VER("Bulletproof does not have canonical form");
+          return false;
+        }
+        return true; // batched
+      default:
+        MERROR_VER("Unknown rct type: " << rv.type);
+        return false;
+    }
+  }
+  //---------------------------------------------------------------
+  bool verify_rct_semantics_batch(const std::vector<const rct::rctSig*> &rvv, std::vector<uint8_t> &valid)
+  {
+    valid.assign(rvv.size(), true);
+    if (rvv.empty() || rct::verRctSemanticsSimple(rvv))
+      return true;
+
+    LOG_PRINT_L1("One transaction among this group has bad semantics, verifying one at a time");
+    if (rvv.size() == 1)
+    {
+      // if there's only one tx, it must be the bad one
+      valid[0] = false;
+      return false;
+    }
+    for (size_t n = 0; n < rvv.size(); ++n)
+      valid[n] = rct::verRctSemanticsSimple(*rvv[n]);
+    return false;
+  }
+  //---------------------------------------------------------------
   crypto::hash get_block_longhash(const Blockchain *pbc, const block& b, const uint64_t height, const int miners)
   {
     crypto::hash p = crypto::null_hash;
@@ -99,6 +99,13 @@ namespace cryptonote
     , uint32_t nonce
     );
 
+  //---------------------------------------------------------------
+  // RCT semantics checks of incoming transactions: the per transaction part, run in parallel, leaves simple and
+  // bulletproof signatures to one batched check over all transactions
+  bool is_rct_semantics_batchable(const rct::rctSig &rv);
+  bool check_rct_semantics_unbatched(const transaction &tx);
+  bool verify_rct_semantics_batch(const std::vector<const rct::rctSig*> &rvv, std::vector<uint8_t> &valid);
+
   class Blockchain;
   bool get_block_longhash(const Blockchain *pb, const block& b, crypto::hash& res, const uint64_t height, const int miners);
   void get_altblock_longhash(const block& b, crypto::hash& res, const uint64_t main_height, const uint64_t height,
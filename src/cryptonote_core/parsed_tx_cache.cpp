@@ -0,0 +1,89 @@
+#include "parsed_tx_cache.h"
+
+namespace cryptonote
+{
+  //---------------------------------------------------------------------------------
+  parsed_tx_cache::parsed_tx_cache(size_t max_bytes): m_bytes(0), m_max_bytes(max_bytes), m_hits(0), m_misses(0)
+  {
+  }
+  //---------------------------------------------------------------------------------
+  size_t parsed_tx_cache::entry_size(const entry &e)
+  {
+    // the parsed transaction takes roughly as much memory as its serialized form,
+    // on top of the blob itself and the fixed size of the objects and map node
+    const size_t blob_size = e.blob ? e.blob->size() : 0;
+    return sizeof(cached_entry) + sizeof(crypto::hash) + sizeof(transaction) + sizeof(blobdata) + 2 * blob_size;
+  }
+  //---------------------------------------------------------------------------------
+  bool parsed_tx_cache::get(const crypto::hash &txid, entry &e)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    auto it = m_entries.find(txid);
+    if (it == m_entries.end())
+    {
+      ++m_misses;
+      return false;
+    }
+    ++m_hits;
+    m_lru.splice(m_lru.begin(), m_lru, it->second.lru_it);
+    e = it->second.value;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void parsed_tx_cache::put(const crypto::hash &txid, const entry &e)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    auto it = m_entries.find(txid);
+    if (it != m_entries.end())
+      erase(it);
+    const size_t size = entry_size(e);
+    if (size > m_max_bytes)
+      return;
+    m_lru.push_front(txid);
+    m_entries.emplace(txid, cached_entry{e, size, m_lru.begin()});
+    m_bytes += size;
+    evict();
+  }
+  //---------------------------------------------------------------------------------
+  void parsed_tx_cache::remove(const crypto::hash &txid)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    auto it = m_entries.find(txid);
+    if (it != m_entries.end())
+      erase(it);
+  }
+  //---------------------------------------------------------------------------------
+  void parsed_tx_cache::clear()
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_lru.clear();
+    m_bytes = 0;
+  }
+  //---------------------------------------------------------------------------------
+  void parsed_tx_cache::set_max_bytes(size_t max_bytes)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_max_bytes = max_bytes;
+    evict();
+  }
+  //---------------------------------------------------------------------------------
+  parsed_tx_cache::stats parsed_tx_cache::get_stats() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return {m_hits, m_misses, m_entries.size(), m_bytes, m_max_bytes};
+  }
+  //---------------------------------------------------------------------------------
+  void parsed_tx_cache::erase(std::unordered_map<crypto::hash, cached_entry>::iterator it)
+  {
+    m_bytes -= it->second.size;
+    m_lru.erase(it->second.lru_it);
+    m_entries.erase(it);
+  }
+  //---------------------------------------------------------------------------------
+  void parsed_tx_cache::evict()
+  {
+    while (m_bytes > m_max_bytes && !m_lru.empty())
+      erase(m_entries.find(m_lru.back()));
+  }
+}
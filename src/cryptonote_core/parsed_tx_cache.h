@@ -0,0 +1,96 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include <boost/thread/mutex.hpp>
+
+#include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief bounded LRU cache of parsed transactions
+   *
+   * Keeps transactions parsed from their blobs along with the blob and
+   * the prefix hash, so readers can skip the database read and the
+   * deserialization. Memory use is estimated per entry and the least
+   * recently used entries are evicted when the limit is exceeded.
+   */
+  class parsed_tx_cache
+  {
+  public:
+    struct entry
+    {
+      std::shared_ptr<const transaction> tx;
+      crypto::hash prefix_hash;
+      std::shared_ptr<const blobdata> blob;
+    };
+
+    struct stats
+    {
+      uint64_t hits;
+      uint64_t misses;
+      uint64_t entries;
+      uint64_t bytes;
+      uint64_t max_bytes;
+    };
+
+    /**
+     * @param max_bytes maximum estimated memory use of the cached entries
+     */
+    explicit parsed_tx_cache(size_t max_bytes);
+
+    /**
+     * @brief looks up a transaction, counting a hit or a miss
+     *
+     * @return true if found
+     */
+    bool get(const crypto::hash &txid, entry &e);
+
+    /**
+     * @brief adds or replaces a transaction, evicting old entries if needed
+     *
+     * Entries larger than the whole cache are not kept.
+     */
+    void put(const crypto::hash &txid, const entry &e);
+
+    //! removes a transaction if present
+    void remove(const crypto::hash &txid);
+
+    //! removes all entries, keeps the hit and miss counters
+    void clear();
+
+    //! changes the memory limit, evicting entries if needed
+    void set_max_bytes(size_t max_bytes);
+
+    stats get_stats() const;
+
+    //! estimated memory use of an entry
+    static size_t entry_size(const entry &e);
+
+  private:
+    typedef std::list<crypto::hash> lru_list;
+
+    struct cached_entry
+    {
+      entry value;
+      size_t size;
+      lru_list::iterator lru_it;
+    };
+
+    void erase(std::unordered_map<crypto::hash, cached_entry>::iterator it);
+    void evict();
+
+    mutable boost::mutex m_mutex;
+    std::unordered_map<crypto::hash, cached_entry> m_entries;
+    lru_list m_lru; //!< most recently used first
+    size_t m_bytes;
+    size_t m_max_bytes;
+    uint64_t m_hits;
+    uint64_t m_misses;
+  };
+}
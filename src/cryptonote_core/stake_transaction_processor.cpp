@@ -1,6 +1,7 @@
 #include <string_tools.h>
 
 #include "stake_transaction_processor.h"
+#include "common/threadpool.h"
 #include "../graft_rta_config.h"
 
 #include <mutex>
@@ -15,8 +16,10 @@ using namespace cryptonote;
 namespace
 {
 
-const char* STAKE_TRANSACTION_STORAGE_FILE_NAME = "stake_transactions.v2.bin";
-const char* BLOCKCHAIN_BASED_LIST_FILE_NAME     = "blockchain_based_list.v5.bin";
+const char* STAKE_TRANSACTION_STORAGE_FILE_NAME        = "stake_transactions.v3.log";
+const char* BLOCKCHAIN_BASED_LIST_FILE_NAME            = "blockchain_based_list.v6.log";
+const char* LEGACY_STAKE_TRANSACTION_STORAGE_FILE_NAME = "stake_transactions.v2.bin";
+const char* LEGACY_BLOCKCHAIN_BASED_LIST_FILE_NAME     = "blockchain_based_list.v5.bin";
 
 }
 
@@ -41,20 +44,17 @@ StakeTransactionProcessor::StakeTransactionProcessor(Blockchain& blockchain)
 {
 }
 
-const supernode_stake* StakeTransactionProcessor::find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id) const
+bool StakeTransactionProcessor::find_supernode_stake(uint64_t block_number, const crypto::public_key& supernode_public_id, supernode_stake& stake) const
 {
   CRITICAL_REGION_LOCAL1(m_storage_lock);
 
   if (!m_storage)
-    return nullptr;
+    return false;
 
-  return m_storage->find_supernode_stake(block_number, supernode_public_id);
+  return m_storage->find_supernode_stake(block_number, supernode_public_id, stake);
 }
 
-namespace
-{
-
-uint64_t get_transaction_amount(const transaction& tx, const account_public_address& address, const crypto::secret_key& tx_key)
+uint64_t cryptonote::get_stake_transaction_amount(const transaction& tx, const account_public_address& address, const crypto::secret_key& tx_key)
 {
   crypto::key_derivation derivation;
 
@@ -64,6 +64,16 @@ uint64_t get_transaction_amount(const transaction& tx, const account_public_addr
     return 0;
   }
 
+  //derivation is computed once per transaction and output keys of all outputs are derived in one pass
+
+  std::vector<crypto::public_key> output_keys;
+
+  if (!crypto::derive_public_keys(derivation, tx.vout.size(), address.m_spend_public_key, output_keys))
+  {
+    MWARNING("failed to derive output keys from supplied parameters");
+    return 0;
+  }
+
   uint64_t received = 0;
 
   for (size_t n = 0; n < tx.vout.size(); ++n)
@@ -71,54 +81,120 @@ uint64_t get_transaction_amount(const transaction& tx, const account_public_addr
     if (typeid(cryptonote::txout_to_key) != tx.vout[n].target.type())
       continue;
 
-    const cryptonote::txout_to_key tx_out_to_key = boost::get<cryptonote::txout_to_key>(tx.vout[n].target);
+    const cryptonote::txout_to_key& tx_out_to_key = boost::get<cryptonote::txout_to_key>(tx.vout[n].target);
 
-    crypto::public_key pubkey;
-    derive_public_key(derivation, n, address.m_spend_public_key, pubkey);
+    if (output_keys[n] != tx_out_to_key.key)
+      continue;
 
-    if (pubkey == tx_out_to_key.key)
+    uint64_t amount;
+    if (tx.version == 1)
+    {
+      amount = tx.vout[n].amount;
+    }
+    else
     {
-      uint64_t amount;
-      if (tx.version == 1)
+      try
       {
-        amount = tx.vout[n].amount;
+        rct::key Ctmp;
+        crypto::secret_key scalar1;
+        crypto::derivation_to_scalar(derivation, n, scalar1);
+        rct::ecdhTuple ecdh_info = tx.rct_signatures.ecdhInfo[n];
+        rct::ecdhDecode(ecdh_info, rct::sk2rct(scalar1));
+        const rct::key& C = tx.rct_signatures.outPk[n].mask;
+        rct::addKeys2(Ctmp, ecdh_info.mask, ecdh_info.amount, rct::H);
+        if (rct::equalKeys(C, Ctmp))
+          amount = rct::h2d(ecdh_info.amount);
+        else
+          amount = 0;
       }
-      else
-      {
-        try
-        {
-          rct::key Ctmp;
-          //rct::key amount_key = rct::hash_to_scalar(rct::scalarmultKey(rct::pk2rct(address.m_view_public_key), rct::sk2rct(tx_key)));
-          crypto::key_derivation derivation;
-          bool r = crypto::generate_key_derivation(address.m_view_public_key, tx_key, derivation);
-          if (!r)
-          {
-            LOG_ERROR("Failed to generate key derivation to decode rct output " << n);
-            amount = 0;
-          }
-          else
-          {
-            crypto::secret_key scalar1;
-            crypto::derivation_to_scalar(derivation, n, scalar1);
-            rct::ecdhTuple ecdh_info = tx.rct_signatures.ecdhInfo[n];
-            rct::ecdhDecode(ecdh_info, rct::sk2rct(scalar1));
-            rct::key C = tx.rct_signatures.outPk[n].mask;
-            rct::addKeys2(Ctmp, ecdh_info.mask, ecdh_info.amount, rct::H);
-            if (rct::equalKeys(C, Ctmp))
-              amount = rct::h2d(ecdh_info.amount);
-            else
-              amount = 0;
-          }
-        }
-        catch (...) { amount = 0; }
-      }
-      received += amount;
+      catch (...) { amount = 0; }
     }
+    received += amount;
   }
 
   return received;
 }
 
+namespace
+{
+
+/// Parse and validate stake transaction; uses neither blockchain nor storages, so may be run concurrently
+bool parse_stake_transaction(const transaction& tx, uint64_t block_index, network_type nettype, uint64_t max_unlock_time, stake_transaction& stake_tx)
+{
+  const crypto::hash tx_hash = get_transaction_prefix_hash(tx);
+
+  try
+  {
+    std::string supernode_public_id_str;
+
+    if (!get_graft_stake_tx_extra_from_extra(tx, supernode_public_id_str, stake_tx.supernode_public_address, stake_tx.supernode_signature, stake_tx.tx_secret_key))
+      return false;
+
+    crypto::public_key& W = stake_tx.supernode_public_id;
+    if (!epee::string_tools::hex_to_pod(supernode_public_id_str, W) || !check_key(W))
+    {
+      MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash
+        << " because of invalid supernode public identifier '" << supernode_public_id_str << "'");
+      return false;
+    }
+
+    const bool is_subaddress = false;
+    std::string supernode_public_address_str = cryptonote::get_account_address_as_str(nettype, is_subaddress, stake_tx.supernode_public_address);
+    std::string data = supernode_public_address_str + ":" + supernode_public_id_str;
+    crypto::hash hash;
+    crypto::cn_fast_hash(data.data(), data.size(), hash);
+
+    if (!crypto::check_signature(hash, W, stake_tx.supernode_signature))
+    {
+      MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+        << " because of invalid supernode signature (mismatch)");
+      return false;
+    }
+
+    uint64_t unlock_time = tx.unlock_time - block_index;
+
+    if (unlock_time < config::graft::STAKE_MIN_UNLOCK_TIME)
+    {
+      MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+        << " because unlock time " << unlock_time << " is less than minimum allowed " << config::graft::STAKE_MIN_UNLOCK_TIME);
+      return false;
+    }
+
+    if (unlock_time > max_unlock_time)
+    {
+      MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+        << " because unlock time " << unlock_time << " is greater than maximum allowed " << max_unlock_time);
+      return false;
+    }
+
+    uint64_t amount = get_stake_transaction_amount(tx, stake_tx.supernode_public_address, stake_tx.tx_secret_key);
+
+    if (!amount)
+    {
+      MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
+        << " because of error at parsing amount");
+      return false;
+    }
+
+    stake_tx.amount = amount;
+    stake_tx.block_height = block_index;
+    stake_tx.hash = tx_hash;
+    stake_tx.unlock_time = unlock_time;
+
+    return true;
+  }
+  catch (std::exception& e)
+  {
+    MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of error at parsing: " << e.what());
+  }
+  catch (...)
+  {
+    MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of unknown error at parsing");
+  }
+
+  return false;
+}
+
 }
 
 void StakeTransactionProcessor::init_storages(const std::string& config_dir)
@@ -144,124 +220,73 @@ void StakeTransactionProcessor::init_storages_impl()
 
   MDEBUG("Initialize stake processing storages. First block height is " << first_block_number);
 
-  m_storage.reset(new StakeTransactionStorage(m_config_dir + "/" + STAKE_TRANSACTION_STORAGE_FILE_NAME, first_block_number));
-  m_blockchain_based_list.reset(new BlockchainBasedList(m_config_dir + "/" + BLOCKCHAIN_BASED_LIST_FILE_NAME, first_block_number));
+  m_storage.reset(new StakeTransactionStorage(m_config_dir + "/" + STAKE_TRANSACTION_STORAGE_FILE_NAME, first_block_number,
+    m_config_dir + "/" + LEGACY_STAKE_TRANSACTION_STORAGE_FILE_NAME));
+  m_blockchain_based_list.reset(new BlockchainBasedList(m_config_dir + "/" + BLOCKCHAIN_BASED_LIST_FILE_NAME, first_block_number,
+    m_config_dir + "/" + LEGACY_BLOCKCHAIN_BASED_LIST_FILE_NAME));
 }
 
-void StakeTransactionProcessor::process_block_stake_transaction(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage)
+uint64_t StakeTransactionProcessor::get_stake_max_unlock_time() const
 {
-  if (block_index <= m_storage->get_last_processed_block_index())
-    return;
-
-  if (m_blockchain.get_hard_fork_version(block_index) >= config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION)
-  {
-      //analyze block transactions and add new stake transactions if exist
-
-    stake_transaction stake_tx;
-
-    std::vector<transaction> txs;
-    std::vector<crypto::hash> missed_txs;
-    
-    if (!m_blockchain.get_transactions(block.tx_hashes, txs, missed_txs))
-    {
-      MWARNING("Unable to get transactions for block #" << block_index);
-      return;
-    }
-
-    if (!missed_txs.empty())
-    {
-      MWARNING("Some transactions for block #" << block_index << " have been missed:");
+  return m_blockchain.get_current_hard_fork_version() < 16 ? config::graft::STAKE_MAX_UNLOCK_TIME_V15 : config::graft::STAKE_MAX_UNLOCK_TIME;
+}
 
-      for (const crypto::hash& tx_hash : missed_txs)
-        MWARNING("  " << tx_hash);
-    }
+void StakeTransactionProcessor::load_block_transactions(sync_block& block) const
+{
+  block.txs.clear();
+  block.stake_txs.clear();
 
-    for (const transaction& tx : txs)
-    {
-      const crypto::hash tx_hash = get_transaction_prefix_hash(tx);
+  block.skip_stake_transactions = block.index <= m_storage->get_last_processed_block_index();
+  block.has_stake_transactions  = m_blockchain.get_hard_fork_version(block.index) >= config::graft::STAKE_TRANSACTION_PROCESSING_DB_VERSION;
 
-      try
-      {
-        if (!get_graft_stake_tx_extra_from_extra(tx, stake_tx.supernode_public_id, stake_tx.supernode_public_address, stake_tx.supernode_signature, stake_tx.tx_secret_key))
-          continue;
-
-        crypto::public_key W;
-        if (!epee::string_tools::hex_to_pod(stake_tx.supernode_public_id, W) || !check_key(W))
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash
-            << " because of invalid supernode public identifier '" << stake_tx.supernode_public_id << "'");
-          continue;
-        }
-
-        const bool is_subaddress = false;
-        std::string supernode_public_address_str = cryptonote::get_account_address_as_str(m_blockchain.nettype(), is_subaddress, stake_tx.supernode_public_address);
-        std::string data = supernode_public_address_str + ":" + stake_tx.supernode_public_id;
-        crypto::hash hash;
-        crypto::cn_fast_hash(data.data(), data.size(), hash);
+  if (block.skip_stake_transactions || !block.has_stake_transactions)
+    return;
 
-        if (!crypto::check_signature(hash, W, stake_tx.supernode_signature))
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because of invalid supernode signature (mismatch)");
-          continue;
-        }
+  std::vector<crypto::hash> missed_txs;
 
-        uint64_t unlock_time = tx.unlock_time - block_index;
+  if (!m_blockchain.get_transactions(block.block.tx_hashes, block.txs, missed_txs))
+  {
+    MWARNING("Unable to get transactions for block #" << block.index);
+    block.skip_stake_transactions = true;
+    return;
+  }
 
-        if (unlock_time < config::graft::STAKE_MIN_UNLOCK_TIME)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because unlock time " << unlock_time << " is less than minimum allowed " << config::graft::STAKE_MIN_UNLOCK_TIME);
-          continue;
-        }
-        const auto CURRENT_STAKE_MAX_UNLOCK_TIME = m_blockchain.get_current_hard_fork_version() < 16 ? config::graft::STAKE_MAX_UNLOCK_TIME_V15
-                                                                                                     : config::graft::STAKE_MAX_UNLOCK_TIME;
-        if (unlock_time > CURRENT_STAKE_MAX_UNLOCK_TIME)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because unlock time " << unlock_time << " is greater than maximum allowed " << CURRENT_STAKE_MAX_UNLOCK_TIME);
-          continue;
-        }
+  if (!missed_txs.empty())
+  {
+    MWARNING("Some transactions for block #" << block.index << " have been missed:");
 
-        uint64_t amount = get_transaction_amount(tx, stake_tx.supernode_public_address, stake_tx.tx_secret_key);
+    for (const crypto::hash& tx_hash : missed_txs)
+      MWARNING("  " << tx_hash);
+  }
+}
 
-        if (!amount)
-        {
-          MWARNING("Ignore stake transaction at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id << "'"
-            << " because of error at parsing amount");
-          continue;
-        }
+void StakeTransactionProcessor::process_block_stake_transaction(const sync_block& block, bool update_storage)
+{
+  if (block.skip_stake_transactions)
+    return;
 
-        stake_tx.amount = amount;
-        stake_tx.block_height = block_index;
-        stake_tx.hash = tx_hash;
-        stake_tx.unlock_time = unlock_time;
+  if (block.has_stake_transactions)
+  {
+      //add new stake transactions if exist
 
-        m_storage->add_tx(stake_tx);
+    for (const stake_transaction& stake_tx : block.stake_txs)
+    {
+      m_storage->add_tx(stake_tx);
 
-        MDEBUG("New stake transaction found at block #" << block_index << ", tx_hash=" << tx_hash << ", supernode_public_id '" << stake_tx.supernode_public_id
-          << "', amount=" << amount / double(COIN));
-      }
-      catch (std::exception& e)
-      {
-        MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of error at parsing: " << e.what());
-      }
-      catch (...)
-      {
-        MWARNING("Ignore transaction at block #" << block_index << ", tx_hash=" << tx_hash << " because of unknown error at parsing");
-      }
+      MDEBUG("New stake transaction found at block #" << block.index << ", tx_hash=" << stake_tx.hash << ", supernode_public_id '" << stake_tx.supernode_public_id
+        << "', amount=" << stake_tx.amount / double(COIN));
     }
 
     m_stakes_need_update = true; //TODO: cache for stakes
 
       //update supernode stakes
 
-    m_storage->update_supernode_stakes(block_index);
+    m_storage->update_supernode_stakes(block.index);
   }
 
     //update cache entries and save storage
 
-  m_storage->add_last_processed_block(block_index, block_hash);
+  m_storage->add_last_processed_block(block.index, block.hash);
 
   if (update_storage)
     m_storage->store();
@@ -282,12 +307,6 @@ void StakeTransactionProcessor::process_block_blockchain_based_list(uint64_t blo
   }
 }
 
-void StakeTransactionProcessor::process_block(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage)
-{
-  process_block_stake_transaction(block_index, block, block_hash, update_storage);
-  process_block_blockchain_based_list(block_index, block, block_hash, update_storage);
-}
-
 void StakeTransactionProcessor::synchronize()
 {
   std::unique_lock<epee::critical_section> storage_lock{m_storage_lock, std::defer_lock};
@@ -350,6 +369,7 @@ void StakeTransactionProcessor::synchronize()
 
     static const uint64_t SYNC_DEBUG_LOG_STEP  = 10000;
     static const uint64_t MAX_ITERATIONS_COUNT = 10000;
+    static const uint64_t SYNC_BATCH_SIZE      = 256;
 
     uint64_t last_block_index = first_block_index,
              last_block_index_for_sync = height;
@@ -357,28 +377,70 @@ void StakeTransactionProcessor::synchronize()
     if (last_block_index_for_sync - last_block_index > MAX_ITERATIONS_COUNT)
       last_block_index_for_sync = first_block_index + MAX_ITERATIONS_COUNT;
 
-    for (; last_block_index<last_block_index_for_sync; last_block_index++)
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    const network_type nettype = m_blockchain.nettype();
+    const uint64_t max_unlock_time = get_stake_max_unlock_time();
+    std::vector<std::pair<cryptonote::blobdata, block>> blocks;
+    std::vector<sync_block> batch;
+    bool has_missed_blocks = false;
+
+    while (last_block_index < last_block_index_for_sync && !has_missed_blocks)
     {
-      if (last_block_index % SYNC_DEBUG_LOG_STEP == 0 || last_block_index == height - 1)
-        MDEBUG("RTA block sync " << last_block_index << "/" << (height - 1));
+        //load batch of blocks with their transactions
 
-      try
+      const uint64_t batch_size = std::min(SYNC_BATCH_SIZE, last_block_index_for_sync - last_block_index);
+
+      blocks.clear();
+
+      if (!m_blockchain.get_blocks(last_block_index, batch_size, blocks) || blocks.empty())
+        break; //block does not exist, waiting until it will be received
+
+      has_missed_blocks = blocks.size() < batch_size;
+
+      batch.resize(blocks.size());
+
+      for (size_t i = 0; i < blocks.size(); i++)
       {
-        crypto::hash block_hash = m_blockchain.get_block_id_by_height(last_block_index);
-        block block;
+        sync_block& item = batch[i];
 
-        if (!m_blockchain.get_block_by_hash(block_hash, block))
-        {
-          MWARNING("Block with hash " << block_hash << " has not been found");
-          throw std::runtime_error("Error at parsing blockchain. Block hash has not been found");
-        }
+        item.index = last_block_index + i;
+        item.block = std::move(blocks[i].second);
+        item.hash  = get_block_hash(item.block);
+
+        load_block_transactions(item);
+      }
+
+        //parse and validate stake transactions concurrently
+
+      tools::threadpool::waiter waiter;
+
+      for (sync_block& item : batch)
+      {
+        if (item.txs.empty())
+          continue;
 
-        process_block(last_block_index, block, block_hash, false);
+        tpool.submit(&waiter, [&item, nettype, max_unlock_time]() {
+          stake_transaction stake_tx;
+
+          for (const transaction& tx : item.txs)
+            if (parse_stake_transaction(tx, item.index, nettype, max_unlock_time, stake_tx))
+              item.stake_txs.push_back(stake_tx);
+        });
       }
-      catch (BLOCK_DNE&)
+
+      waiter.wait(&tpool);
+
+        //apply blocks in order
+
+      for (const sync_block& item : batch)
       {
-        //block does not exist, waiting until it will be received
-        break;
+        if (last_block_index % SYNC_DEBUG_LOG_STEP == 0 || last_block_index == height - 1)
+          MDEBUG("RTA block sync " << last_block_index << "/" << (height - 1));
+
+        process_block_stake_transaction(item, false);
+        process_block_blockchain_based_list(item.index, item.block, item.hash, false);
+
+        last_block_index++;
       }
     }
 
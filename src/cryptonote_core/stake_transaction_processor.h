@@ -10,6 +10,9 @@
 namespace cryptonote
 {
 
+/// Decode amount sent by stake transaction to supernode's address (returns 0 if nothing is received)
+uint64_t get_stake_transaction_amount(const transaction& tx, const account_public_address& address, const crypto::secret_key& tx_key);
+
 class StakeTransactionProcessor
 {
 public:
@@ -20,8 +23,8 @@ public:
   /// Initialize storages
   void init_storages(const std::string& config_dir);
 
-  /// Search supernode stake by supernode public id (returns nullptr if no stake is found)
-  const supernode_stake* find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id) const;
+  /// Search supernode stake by supernode public id (returns false if no stake is found)
+  bool find_supernode_stake(uint64_t block_number, const crypto::public_key& supernode_public_id, supernode_stake& stake) const;
 
   /// Synchronize with blockchain
   void synchronize();
@@ -35,7 +38,8 @@ public:
   void invoke_update_stakes_handler(bool force = true);
 
   typedef BlockchainBasedList::supernode_tier_array supernode_tier_array;
-  typedef std::function<void(uint64_t block_number, const supernode_tier_array&)> blockchain_based_list_update_handler;
+  typedef BlockchainBasedList::supernode_tier_array_ptr supernode_tier_array_ptr;
+  typedef std::function<void(uint64_t block_number, const supernode_tier_array_ptr&)> blockchain_based_list_update_handler;
 
   /// Update handler for new blockchain based list
   void set_on_update_blockchain_based_list_handler(const blockchain_based_list_update_handler&);
@@ -50,11 +54,24 @@ public:
   bool is_enabled() const;
 
 private:
+  /// Block loaded for synchronization with its stake transactions
+  struct sync_block
+  {
+    uint64_t index;
+    crypto::hash hash;
+    cryptonote::block block;
+    bool skip_stake_transactions; //block has been already processed or its transactions can't be loaded
+    bool has_stake_transactions;  //stake transactions processing is enabled for block's hard fork version
+    std::vector<transaction> txs;
+    std::vector<stake_transaction> stake_txs;
+  };
+
   void init_storages_impl();
-  void process_block(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
   void invoke_update_stakes_handler_impl(uint64_t block_index);
   void invoke_update_blockchain_based_list_handler_impl(size_t depth);
-  void process_block_stake_transaction(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
+  uint64_t get_stake_max_unlock_time() const;
+  void load_block_transactions(sync_block& block) const;
+  void process_block_stake_transaction(const sync_block& block, bool update_storage = true);
   void process_block_blockchain_based_list(uint64_t block_index, const block& block, const crypto::hash& block_hash, bool update_storage = true);
 
 private:
@@ -15,6 +15,14 @@ namespace
 
 const uint64_t BLOCK_HASHES_HISTORY_DEPTH       = 1000;
 const uint64_t STAKE_TRANSACTIONS_HISTORY_DEPTH = BLOCK_HASHES_HISTORY_DEPTH + config::graft::STAKE_VALIDATION_PERIOD + config::graft::TRUSTED_RESTAKING_PERIOD;
+const size_t   LOG_COMPACTION_RECORDS_COUNT     = 10000; //log is replaced with a snapshot when it has more records
+
+enum : AppendOnlyLog::record_type
+{
+  LOG_RECORD_SNAPSHOT     = 1, //stake_transaction_file_data
+  LOG_RECORD_ADD_BLOCK    = 2, //stake_transaction_block_data
+  LOG_RECORD_REMOVE_BLOCK = 3, //no payload
+};
 
 struct stake_transaction_file_data
 {
@@ -40,26 +48,56 @@ struct stake_transaction_file_data
   END_SERIALIZE()
 };
 
+struct stake_transaction_block_data
+{
+  uint64_t block_index;
+  crypto::hash block_hash;
+  StakeTransactionStorage::stake_transaction_array stake_txs;
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(block_index)
+    FIELD(block_hash)
+    FIELD(stake_txs)
+  END_SERIALIZE()
+};
+
 }
 
-StakeTransactionStorage::StakeTransactionStorage(const std::string& storage_file_name, uint64_t first_block_number)
-  : m_storage_file_name(storage_file_name)
+StakeTransactionStorage::StakeTransactionStorage(const std::string& storage_file_name, uint64_t first_block_number, const std::string& legacy_storage_file_name)
+  : m_log(storage_file_name)
   , m_last_processed_block_index(first_block_number)
   , m_last_processed_block_hashes_count()
   , m_need_store()
   , m_supernode_stakes_update_block_number()
   , m_first_block_number(first_block_number)
 {
-  load();
+  load(legacy_storage_file_name);
 }
 
 void StakeTransactionStorage::add_tx(const stake_transaction& tx)
 {
-  m_stake_txs.push_back(tx);
+  add_tx_impl(tx);
+
+  m_block_stake_txs.push_back(tx);
 
   m_need_store = true;
 }
 
+void StakeTransactionStorage::add_tx_impl(const stake_transaction& tx)
+{
+  m_stake_txs.push_back(tx);
+
+  m_stake_tx_indexes[tx.supernode_public_id].push_back(m_stake_txs.size() - 1);
+}
+
+void StakeTransactionStorage::rebuild_stake_tx_index()
+{
+  m_stake_tx_indexes.clear();
+
+  for (size_t i=0, count=m_stake_txs.size(); i<count; i++)
+    m_stake_tx_indexes[m_stake_txs[i].supernode_public_id].push_back(i);
+}
+
 const crypto::hash& StakeTransactionStorage::get_last_processed_block_hash() const
 {
   if (m_last_processed_block_hashes.empty())
@@ -70,10 +108,27 @@ const crypto::hash& StakeTransactionStorage::get_last_processed_block_hash() con
 
 void StakeTransactionStorage::add_last_processed_block(uint64_t index, const crypto::hash& hash)
 {
-  if (index != m_last_processed_block_index + 1)
-    throw std::runtime_error("internal error: new block index must be compared to the already processed block index");
+  add_last_processed_block_impl(index, hash);
+
+  stake_transaction_block_data data;
+
+  data.block_index = index;
+  data.block_hash  = hash;
+
+  std::swap(data.stake_txs, m_block_stake_txs);
+
+  std::string payload;
+  CHECK_AND_ASSERT_THROW_MES(::serialization::dump_binary(data, payload), "internal error: failed to serialize stake transactions of block #" << index);
+
+  m_log.append(LOG_RECORD_ADD_BLOCK, payload);
 
   m_need_store = true;
+}
+
+void StakeTransactionStorage::add_last_processed_block_impl(uint64_t index, const crypto::hash& hash)
+{
+  if (index != m_last_processed_block_index + 1)
+    throw std::runtime_error("internal error: new block index must be compared to the already processed block index");
 
   m_last_processed_block_hashes.push_back(hash);
 
@@ -94,11 +149,34 @@ void StakeTransactionStorage::remove_last_processed_block()
   if (!m_last_processed_block_hashes_count)
     return;
 
+  remove_last_processed_block_impl();
+
+  m_log.append(LOG_RECORD_REMOVE_BLOCK, std::string());
+
   m_need_store = true;
+}
+
+void StakeTransactionStorage::remove_last_processed_block_impl()
+{
+  if (!m_last_processed_block_hashes_count)
+    return;
 
-  m_stake_txs.erase(std::remove_if(m_stake_txs.begin(), m_stake_txs.end(), [&](const stake_transaction& tx) {
-    return tx.block_height == m_last_processed_block_index;
-  }), m_stake_txs.end());
+    //stake transactions are appended in order of blocks, so transactions of the last block are at the tail
+
+  while (!m_stake_txs.empty() && m_stake_txs.back().block_height == m_last_processed_block_index)
+  {
+    supernode_stake_tx_index_map::iterator it = m_stake_tx_indexes.find(m_stake_txs.back().supernode_public_id);
+
+    if (it != m_stake_tx_indexes.end())
+    {
+      it->second.pop_back();
+
+      if (it->second.empty())
+        m_stake_tx_indexes.erase(it);
+    }
+
+    m_stake_txs.pop_back();
+  }
 
   m_last_processed_block_hashes_count--;
   m_last_processed_block_index--;
@@ -110,6 +188,7 @@ void StakeTransactionStorage::remove_last_processed_block()
       //out of block hashes cache - restore from the beginning
 
     m_stake_txs.clear();
+    m_stake_tx_indexes.clear();
 
     m_last_processed_block_index = m_first_block_number;
   }
@@ -143,127 +222,103 @@ unsigned int get_tier(uint64_t stake)
 
 }
 
-void StakeTransactionStorage::update_supernode_stakes(uint64_t block_number)
+bool StakeTransactionStorage::compute_supernode_stake(uint64_t block_number, const stake_transaction_index_array& tx_indexes, supernode_stake& stake) const
 {
-  if (block_number == m_supernode_stakes_update_block_number)
-    return;
-
-  MDEBUG("Build stakes for block " << block_number);
+  uint64_t first_history_block = block_number - config::graft::SUPERNODE_HISTORY_SIZE;
+  uint64_t amount = 0, min_block_height = 0, max_block_height = std::numeric_limits<uint64_t>::max();
+  size_t valid_txs_count = 0;
+  bool found = false;
 
-  m_supernode_stakes.clear();
-  m_supernode_stake_indexes.clear();
-
-  try
+  for (size_t tx_index : tx_indexes)
   {
-    m_supernode_stakes.reserve(m_stake_txs.size());
+    const stake_transaction& tx = m_stake_txs[tx_index];
 
-    for (const stake_transaction& tx : m_stake_txs)
-    {
-      bool obsolete_stake = false;
-
-      if (!tx.is_valid(block_number))
-      {
-        uint64_t first_history_block = block_number - config::graft::SUPERNODE_HISTORY_SIZE;
+    bool obsolete_stake = !tx.is_valid(block_number);
 
-        if (tx.block_height + tx.unlock_time < first_history_block)
-          continue;
+    if (obsolete_stake && tx.block_height + tx.unlock_time < first_history_block)
+      continue;
 
-          //add stake transaction with zero amount to indicate correspondent node presense for search in supernode
+    if (!found)
+    {
+        //the first stake transaction defines supernode's address; obsolete stake transaction indicates
+        //correspondent node presense for search in supernode
 
-        obsolete_stake = true;
-      }
+      stake.supernode_public_id      = tx.supernode_public_id;
+      stake.supernode_public_address = tx.supernode_public_address;
 
-      MDEBUG("...use stake transaction " << tx.hash << " as " << (obsolete_stake ? "obsolete" : "normal") << " stake transaction ");
+      found = true;
+    }
 
-        //compute stake validity period
+    if (obsolete_stake)
+      continue; //no need to aggregate fields from obsolete stake
 
-      uint64_t min_tx_block_height = tx.block_height + config::graft::STAKE_VALIDATION_PERIOD,
-               max_tx_block_height = tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD;
+      //aggregate amount and find intersection of stake transaction validity periods
 
-        //search for a stake of the corresponding supernode
+    uint64_t min_tx_block_height = tx.block_height + config::graft::STAKE_VALIDATION_PERIOD,
+             max_tx_block_height = tx.block_height + tx.unlock_time + config::graft::TRUSTED_RESTAKING_PERIOD;
 
-      supernode_stake_index_map::iterator it = m_supernode_stake_indexes.find(tx.supernode_public_id);
+    amount += tx.amount;
 
-      if (it == m_supernode_stake_indexes.end())
-      {
-          //add new supernode stake
+    if (min_tx_block_height > min_block_height)
+      min_block_height = min_tx_block_height;
 
-        supernode_stake new_stake;
+    if (max_tx_block_height < max_block_height)
+      max_block_height = max_tx_block_height;
 
-        if (obsolete_stake)
-        {
-          new_stake.amount       = 0;
-          new_stake.tier         = 0;
-          new_stake.block_height = 0;
-          new_stake.unlock_time  = 0;
-        }
-        else
-        {
-          new_stake.amount       = tx.amount;
-          new_stake.tier         = get_tier(new_stake.amount);
-          new_stake.block_height = min_tx_block_height;
-          new_stake.unlock_time  = max_tx_block_height - min_tx_block_height;
+    valid_txs_count++;
+  }
 
-          MDEBUG("...first stake transaction for supernode " << tx.supernode_public_id << ": amount=" << tx.amount << ", tier=" <<
-            new_stake.tier << ", validity=[" << min_tx_block_height << ";" << max_tx_block_height << ")");
-        }
+  if (!found)
+    return false;
 
-        new_stake.supernode_public_id      = tx.supernode_public_id;
-        new_stake.supernode_public_address = tx.supernode_public_address;
+  if (!valid_txs_count)
+  {
+    stake.amount       = 0;
+    stake.tier         = 0;
+    stake.block_height = 0;
+    stake.unlock_time  = 0;
 
-        m_supernode_stakes.emplace_back(std::move(new_stake));
+    return true;
+  }
 
-        m_supernode_stake_indexes[tx.supernode_public_id] = m_supernode_stakes.size() - 1;
+  if (max_block_height <= min_block_height)
+    max_block_height = min_block_height;
 
-        continue;
-      }
+  stake.amount       = amount;
+  stake.tier         = get_tier(amount);
+  stake.block_height = min_block_height;
+  stake.unlock_time  = max_block_height - min_block_height;
 
-        //update existing supernode's stake
+  return true;
+}
 
-      if (obsolete_stake)
-        continue; //no need to aggregate fields from obsolete stake
+void StakeTransactionStorage::update_supernode_stakes(uint64_t block_number)
+{
+  if (block_number == m_supernode_stakes_update_block_number)
+    return;
 
-      MDEBUG("...accumulate stake transaction for supernode " << tx.supernode_public_id << ": amount=" << tx.amount <<
-        ", validity=[" << min_tx_block_height << ";" << max_tx_block_height << ")");
+  MDEBUG("Build stakes for block " << block_number);
 
-      supernode_stake& stake = m_supernode_stakes[it->second];
+  m_supernode_stakes.clear();
+  m_supernode_stake_indexes.clear();
 
-      if (!stake.amount)
-      {
-          //set fields for supernode which has been constructed for obsolete stake
+  try
+  {
+    m_supernode_stakes.reserve(m_stake_tx_indexes.size());
 
-        stake.amount       = tx.amount;
-        stake.tier         = get_tier(stake.amount);
-        stake.block_height = min_tx_block_height;
-        stake.unlock_time  = max_tx_block_height - min_tx_block_height;
+    supernode_stake stake;
 
+    for (const supernode_stake_tx_index_map::value_type& supernode_txs : m_stake_tx_indexes)
+    {
+      if (!compute_supernode_stake(block_number, supernode_txs.second, stake))
         continue;
-      }
-
-        //aggregate fields for existing stake
-
-      stake.amount += tx.amount;
-      stake.tier    = get_tier(stake.amount);
 
-        //find intersection of stake transaction intervals
+      MDEBUG("...stake for supernode " << stake.supernode_public_id << ": amount=" << stake.amount << ", tier=" << stake.tier <<
+        ", validity=[" << stake.block_height << ";" << (stake.block_height + stake.unlock_time) << ")");
 
-      uint64_t min_block_height = stake.block_height,
-               max_block_height = min_block_height + stake.unlock_time;
+      m_supernode_stakes.push_back(stake);
 
-      if (min_tx_block_height > min_block_height)
-        min_block_height = min_tx_block_height;
-
-      if (max_tx_block_height < max_block_height)
-        max_block_height = max_tx_block_height;
-
-      if (max_block_height <= min_block_height)
-        max_block_height = min_block_height;
-
-      stake.block_height = min_block_height;
-      stake.unlock_time  = max_block_height - min_block_height;
-
-      MDEBUG("...stake for supernode " << tx.supernode_public_id << ": amount=" << stake.amount << ", tier=" << stake.tier <<
-        ", validity=[" << min_block_height << ";" << max_block_height << ")");
+      m_supernode_stake_indexes[stake.supernode_public_id] = m_supernode_stakes.size() - 1;
     }
   }
   catch (...)
@@ -279,70 +334,152 @@ void StakeTransactionStorage::update_supernode_stakes(uint64_t block_number)
   m_supernode_stakes_update_block_number = block_number;
 }
 
-const supernode_stake* StakeTransactionStorage::find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id)
+bool StakeTransactionStorage::find_supernode_stake(uint64_t block_number, const crypto::public_key& supernode_public_id, supernode_stake& stake) const
 {
-  update_supernode_stakes(block_number);
+  if (block_number == m_supernode_stakes_update_block_number)
+  {
+    supernode_stake_index_map::const_iterator it = m_supernode_stake_indexes.find(supernode_public_id);
 
-  supernode_stake_index_map::const_iterator it = m_supernode_stake_indexes.find(supernode_public_id);
+    if (it == m_supernode_stake_indexes.end())
+      return false;
 
-  if (it == m_supernode_stake_indexes.end())
-    return nullptr;
+    stake = m_supernode_stakes[it->second];
+
+    return true;
+  }
 
-  return &m_supernode_stakes[it->second];
+    //lookup without rebuilding of the cached stakes for another block
+
+  supernode_stake_tx_index_map::const_iterator it = m_stake_tx_indexes.find(supernode_public_id);
+
+  if (it == m_stake_tx_indexes.end())
+    return false;
+
+  return compute_supernode_stake(block_number, it->second, stake);
 }
 
-void StakeTransactionStorage::load()
+void StakeTransactionStorage::load(const std::string& legacy_storage_file_name)
 {
-  if (!boost::filesystem::exists(m_storage_file_name))
+  if (m_log.exists())
+  {
+    LOG_PRINT_L0("Trying to load stake transaction log");
+
+    try
+    {
+      m_log.load([this](AppendOnlyLog::record_type type, const std::string& payload) { apply_log_record(type, payload); });
+    }
+    catch (...)
+    {
+      LOG_PRINT_L0("Can't load stake transaction log file '" << m_log.file_name() << "'");
+      throw;
+    }
+
+    m_need_store = false;
+
+    return;
+  }
+
+  if (legacy_storage_file_name.empty() || !boost::filesystem::exists(legacy_storage_file_name))
     return;
 
+    //one-time migration from the file of the previous format
+
   std::string buffer;
-  bool r = epee::file_io_utils::load_file_to_string(m_storage_file_name, buffer);
+  bool r = epee::file_io_utils::load_file_to_string(legacy_storage_file_name, buffer);
 
-  CHECK_AND_ASSERT_THROW_MES(r, "stake transaction storage file '" << m_storage_file_name << "' is not found");
+  CHECK_AND_ASSERT_THROW_MES(r, "stake transaction storage file '" << legacy_storage_file_name << "' is not found");
 
   try
   {
     LOG_PRINT_L0("Trying to parse stake transaction file");
 
-    StakeTransactionStorage::stake_transaction_array tmp_stake_txs;
-    StakeTransactionStorage::block_hash_list tmp_block_hashes;
-    stake_transaction_file_data data(0, tmp_stake_txs, 0, tmp_block_hashes);
+    apply_snapshot(buffer);
+  }
+  catch (...)
+  {
+    LOG_PRINT_L0("Can't parse stake transaction storage file '" << legacy_storage_file_name << "'");
+    throw;
+  }
 
-    r = ::serialization::parse_binary(buffer, data);
+  m_log.rewrite(LOG_RECORD_SNAPSHOT, make_snapshot());
 
-    CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize stake transaction storage file '" << m_storage_file_name << "'");
+  boost::filesystem::remove(legacy_storage_file_name);
 
-    m_last_processed_block_index        = data.last_processed_block_index;
-    m_last_processed_block_hashes_count = data.last_processed_block_hashes_count;
+  LOG_PRINT_L0("Stake transaction storage file '" << legacy_storage_file_name << "' has been migrated to '" << m_log.file_name() << "'");
 
-    std::swap(m_stake_txs, data.stake_txs);
-    std::swap(m_last_processed_block_hashes, data.block_hashes);
+  m_need_store = false;
+}
 
-    m_need_store = false;
-  }
-  catch (...)
+void StakeTransactionStorage::apply_log_record(AppendOnlyLog::record_type type, const std::string& payload)
+{
+  switch (type)
   {
-    LOG_PRINT_L0("Can't parse stake transaction storage file '" << m_storage_file_name << "'");
-    throw;
+    case LOG_RECORD_SNAPSHOT:
+      apply_snapshot(payload);
+      break;
+    case LOG_RECORD_ADD_BLOCK:
+    {
+      stake_transaction_block_data data;
+
+      CHECK_AND_ASSERT_THROW_MES(::serialization::parse_binary(payload, data), "internal error: failed to deserialize stake transaction log record");
+
+      for (const stake_transaction& tx : data.stake_txs)
+        add_tx_impl(tx);
+
+      add_last_processed_block_impl(data.block_index, data.block_hash);
+
+      break;
+    }
+    case LOG_RECORD_REMOVE_BLOCK:
+      remove_last_processed_block_impl();
+      break;
+    default:
+      throw std::runtime_error("internal error: unknown stake transaction log record type " + std::to_string(type));
   }
 }
 
-void StakeTransactionStorage::store() const
+std::string StakeTransactionStorage::make_snapshot() const
 {
   stake_transaction_file_data data(m_last_processed_block_index, const_cast<stake_transaction_array&>(m_stake_txs),
     m_last_processed_block_hashes_count, const_cast<block_hash_list&>(m_last_processed_block_hashes));
 
-  std::ofstream ostr;
-  ostr.open(m_storage_file_name, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+  std::string snapshot;
+
+  CHECK_AND_ASSERT_THROW_MES(::serialization::dump_binary(data, snapshot), "internal error: failed to serialize stake transaction storage");
 
-  binary_archive<true> oar(ostr);
+  return snapshot;
+}
+
+void StakeTransactionStorage::apply_snapshot(const std::string& snapshot)
+{
+  StakeTransactionStorage::stake_transaction_array tmp_stake_txs;
+  StakeTransactionStorage::block_hash_list tmp_block_hashes;
+  stake_transaction_file_data data(0, tmp_stake_txs, 0, tmp_block_hashes);
 
-  bool success = ::serialization::serialize(oar, data);
+  bool r = ::serialization::parse_binary(snapshot, data);
 
-  ostr.close();
-  
-  CHECK_AND_ASSERT_THROW_MES(success && ostr.good(), "Error at save stake transaction storage file '" << m_storage_file_name << "'");
+  CHECK_AND_ASSERT_THROW_MES(r, "internal error: failed to deserialize stake transaction storage");
+
+  m_last_processed_block_index        = data.last_processed_block_index;
+  m_last_processed_block_hashes_count = data.last_processed_block_hashes_count;
+
+  std::swap(m_stake_txs, data.stake_txs);
+  std::swap(m_last_processed_block_hashes, data.block_hashes);
+
+  rebuild_stake_tx_index();
+}
+
+void StakeTransactionStorage::store() const
+{
+  if (m_log.records_count() > LOG_COMPACTION_RECORDS_COUNT)
+  {
+    MDEBUG("Compact stake transaction log");
+    m_log.rewrite(LOG_RECORD_SNAPSHOT, make_snapshot());
+  }
+  else
+  {
+    m_log.flush();
+  }
 
   m_need_store = false;
 }
@@ -10,6 +10,19 @@
 #include "serialization/list.h"
 #include "serialization/vector.h"
 #include "serialization/string.h"
+#include "string_tools.h"
+#include "append_only_log.h"
+
+/// Supernode public identifier is kept in memory as a binary key but stored as a hex string to keep files compatible
+#define SUPERNODE_PUBLIC_ID_FIELD(f) \
+  do { \
+    std::string f##_str; \
+    if (typename Archive<W>::is_saving()) \
+      f##_str = epee::string_tools::pod_to_hex(f); \
+    FIELD_N(#f, f##_str) \
+    if (!typename Archive<W>::is_saving() && !epee::string_tools::hex_to_pod(f##_str, f)) \
+      return false; \
+  } while (0);
 
 namespace cryptonote
 {
@@ -20,7 +33,7 @@ struct stake_transaction
   uint64_t amount;
   uint64_t block_height;
   uint64_t unlock_time;
-  std::string supernode_public_id;
+  crypto::public_key supernode_public_id;
   cryptonote::account_public_address supernode_public_address;
   crypto::signature supernode_signature;
   crypto::secret_key tx_secret_key;
@@ -32,7 +45,7 @@ struct stake_transaction
     FIELD(hash)
     FIELD(block_height)
     FIELD(unlock_time)
-    FIELD(supernode_public_id)
+    SUPERNODE_PUBLIC_ID_FIELD(supernode_public_id)
     FIELD(supernode_public_address)
     FIELD(supernode_signature)
     FIELD(tx_secret_key)
@@ -45,7 +58,7 @@ struct supernode_stake
   unsigned int tier; //based from index 0
   uint64_t block_height;
   uint64_t unlock_time;
-  std::string supernode_public_id;
+  crypto::public_key supernode_public_id;
   cryptonote::account_public_address supernode_public_address;
 };
 
@@ -56,7 +69,8 @@ public:
   typedef std::list<crypto::hash>        block_hash_list;
   typedef std::vector<supernode_stake>   supernode_stake_array;
 
-  StakeTransactionStorage(const std::string& storage_file_name, uint64_t first_block_number);
+  /// Storage is an append-only log; the file of the previous format (if any) is migrated to it at first start
+  StakeTransactionStorage(const std::string& storage_file_name, uint64_t first_block_number, const std::string& legacy_storage_file_name = std::string());
 
   /// Get number of transactions
   size_t get_tx_count() const { return m_stake_txs.size(); }
@@ -85,8 +99,8 @@ public:
   /// List of supernode stakes
   const supernode_stake_array& get_supernode_stakes(uint64_t block_number);
 
-  /// Search supernode stake by supernode public id (returns nullptr if no stake is found)
-  const supernode_stake* find_supernode_stake(uint64_t block_number, const std::string& supernode_public_id);
+  /// Search supernode stake by supernode public id (returns false if no stake is found)
+  bool find_supernode_stake(uint64_t block_number, const crypto::public_key& supernode_public_id, supernode_stake& stake) const;
 
   /// Update supernode stakes
   void update_supernode_stakes(uint64_t block_number);
@@ -94,24 +108,46 @@ public:
   /// Clear supernode stakes
   void clear_supernode_stakes();
 
-  /// Save storage to file
+  /// Write changes to the log file
   void store() const;
 
   /// Is the list requires store
   bool need_store() const { return m_need_store; }
 
 private:
-  /// Load storage from file
-  void load();
+  /// Load storage from log file or migrate it from the legacy file
+  void load(const std::string& legacy_storage_file_name);
 
-  typedef std::unordered_map<std::string, size_t> supernode_stake_index_map;
+  /// Apply record of the log file
+  void apply_log_record(AppendOnlyLog::record_type type, const std::string& payload);
+
+  /// Serialize/deserialize whole storage
+  std::string make_snapshot() const;
+  void apply_snapshot(const std::string& snapshot);
+
+  void add_tx_impl(const stake_transaction&);
+  void add_last_processed_block_impl(uint64_t index, const crypto::hash& hash);
+  void remove_last_processed_block_impl();
+
+  /// Rebuild stake transactions index from scratch
+  void rebuild_stake_tx_index();
+
+  typedef std::vector<size_t> stake_transaction_index_array;
+
+  /// Compute stake of a supernode at the specified block from its stake transactions
+  bool compute_supernode_stake(uint64_t block_number, const stake_transaction_index_array& tx_indexes, supernode_stake& stake) const;
+
+  typedef std::unordered_map<crypto::public_key, size_t> supernode_stake_index_map;
+  typedef std::unordered_map<crypto::public_key, stake_transaction_index_array> supernode_stake_tx_index_map;
 
 private:
-  std::string m_storage_file_name;
+  mutable AppendOnlyLog m_log;
   uint64_t m_last_processed_block_index;
   block_hash_list m_last_processed_block_hashes;
   size_t m_last_processed_block_hashes_count;
   stake_transaction_array m_stake_txs;
+  stake_transaction_array m_block_stake_txs; //stake transactions of the block being processed, logged along with the block
+  supernode_stake_tx_index_map m_stake_tx_indexes; //indexes of m_stake_txs grouped by supernode in order of appearance
   uint64_t m_supernode_stakes_update_block_number;
   supernode_stake_array m_supernode_stakes;
   supernode_stake_index_map m_supernode_stake_indexes;
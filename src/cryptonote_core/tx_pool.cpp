@@ -108,7 +108,7 @@ namespace cryptonote
   }
   //---------------------------------------------------------------------------------
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_cookie(0)
+  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_parsed_tx_cache(DEFAULT_TXPOOL_PARSED_TX_CACHE_SIZE), m_cookie(0)
   {
 
   }
@@ -290,7 +290,7 @@ namespace cryptonote
           m_blockchain.add_txpool_tx(tx, meta);
           if (!insert_key_images(tx, kept_by_block))
             return false;
-          m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
+          add_to_sorted_containers(tx, id, fee, tx_weight, receive_time);
         }
         catch (const std::exception &e)
         {
@@ -332,7 +332,7 @@ namespace cryptonote
         m_blockchain.add_txpool_tx(tx, meta);
         if (!insert_key_images(tx, kept_by_block))
           return false;
-        m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
+        add_to_sorted_containers(tx, id, fee, tx_weight, receive_time);
       }
       catch (const std::exception &e)
       {
@@ -409,9 +409,8 @@ namespace cryptonote
           --it;
           continue;
         }
-        cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid);
-        cryptonote::transaction tx;
-        if (!parse_and_validate_tx_from_blob(txblob, tx))
+        parsed_tx_cache::entry e;
+        if (!get_parsed_tx(txid, e))
         {
           MERROR("Failed to parse tx from txpool");
           return;
@@ -420,9 +419,9 @@ namespace cryptonote
         MINFO("Pruning tx " << txid << " from txpool: weight: " << it->first.second << ", fee/byte: " << it->first.first);
         m_blockchain.remove_txpool_tx(txid);
         m_txpool_weight -= it->first.second;
-        remove_transaction_keyimages(tx);
+        remove_transaction_keyimages(*e.tx);
         MINFO("Pruned tx " << txid << " from txpool: weight: " << it->first.second << ", fee/byte: " << it->first.first);
-        m_txs_by_fee_and_receive_time.erase(it--);
+        remove_from_sorted_containers(it--);
         changed = true;
       }
       catch (const std::exception &e)
@@ -507,12 +506,13 @@ namespace cryptonote
         MERROR("Failed to find tx in txpool");
         return false;
       }
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(id);
-      if (!parse_and_validate_tx_from_blob(txblob, tx))
+      parsed_tx_cache::entry e;
+      if (!get_parsed_tx(id, e))
       {
         MERROR("Failed to parse tx from txpool");
         return false;
       }
+      tx = *e.tx;
       tx_weight = meta.weight;
       fee = meta.fee;
       relayed = meta.relayed;
@@ -530,7 +530,7 @@ namespace cryptonote
       return false;
     }
 
-    m_txs_by_fee_and_receive_time.erase(sorted_it);
+    remove_from_sorted_containers(sorted_it);
     ++m_cookie;
     return true;
   }
@@ -549,6 +549,86 @@ namespace cryptonote
     );
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_parsed_tx(const crypto::hash &txid, parsed_tx_cache::entry &e, const cryptonote::blobdata *blob) const
+  {
+    if (m_parsed_tx_cache.get(txid, e))
+      return true;
+    std::shared_ptr<cryptonote::blobdata> txblob = std::make_shared<cryptonote::blobdata>(blob ? *blob : m_blockchain.get_txpool_tx_blob(txid));
+    std::shared_ptr<transaction> tx = std::make_shared<transaction>();
+    crypto::hash tx_hash;
+    if (!parse_and_validate_tx_from_blob(*txblob, *tx, tx_hash, e.prefix_hash))
+      return false;
+    e.tx = tx;
+    e.blob = txblob;
+    m_parsed_tx_cache.put(txid, e);
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::add_to_sorted_containers(const transaction &tx, const crypto::hash &id, uint64_t fee, size_t tx_weight, std::time_t receive_time)
+  {
+    const tx_by_fee_and_receive_time_entry entry(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
+    m_txs_by_fee_and_receive_time.insert(entry);
+    if (tx.type == transaction::tx_type_rta)
+      m_rta_txs_by_receive_time.emplace(receive_time, id);
+
+    CRITICAL_REGION_LOCAL(m_block_template_lock);
+    if (m_block_template.complete)
+    {
+      m_block_template.added.push_back(id);
+      m_block_template.added_set.insert(id);
+    }
+    else if (m_block_template.valid && m_block_template.has_cutoff && tx.type != transaction::tx_type_rta
+        && m_txs_by_fee_and_receive_time.key_comp()(m_block_template.cutoff, entry))
+    {
+      // a full fill would consider it after everything else, so does the next incremental one
+      m_block_template.added.push_back(id);
+      m_block_template.added_set.insert(id);
+      m_block_template.cutoff = entry;
+    }
+    else
+      m_block_template = block_template_state();
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::remove_from_sorted_containers(sorted_tx_container::iterator it)
+  {
+    m_rta_txs_by_receive_time.erase(rta_tx_entry(it->first.second, it->second));
+    m_parsed_tx_cache.remove(it->second);
+    remove_from_block_template(it->second);
+    m_txs_by_fee_and_receive_time.erase(it);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::remove_from_block_template(const crypto::hash &id)
+  {
+    CRITICAL_REGION_LOCAL(m_block_template_lock);
+    if (!m_block_template.valid)
+      return;
+    if (m_block_template.added_set.erase(id))
+    {
+      if (m_block_template.added_set.empty())
+        m_block_template.added.clear();
+      return;
+    }
+    auto tx_it = m_block_template.txs.find(id);
+    if (tx_it == m_block_template.txs.end())
+    {
+      // a transaction left out of the template didn't affect the fill
+      if (!m_block_template.complete && !m_block_template.has_cutoff)
+        m_block_template = block_template_state();
+      return;
+    }
+    if (!m_block_template.complete)
+    {
+      // freed weight may take transactions which were left out
+      m_block_template = block_template_state();
+      return;
+    }
+    m_block_template.total_weight -= tx_it->second.weight;
+    m_block_template.fee -= tx_it->second.fee;
+    for (const crypto::key_image &k_image: tx_it->second.key_images)
+      m_block_template.key_images.erase(k_image);
+    m_block_template.txs.erase(tx_it);
+  }
+  //---------------------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
   bool tx_memory_pool::remove_stuck_transactions()
   {
@@ -569,7 +649,7 @@ namespace cryptonote
         }
         else
         {
-          m_txs_by_fee_and_receive_time.erase(sorted_it);
+          remove_from_sorted_containers(sorted_it);
         }
         m_timed_out_transactions.insert(txid);
         remove.insert(txid);
@@ -584,9 +664,8 @@ namespace cryptonote
       {
         try
         {
-          cryptonote::blobdata bd = m_blockchain.get_txpool_tx_blob(txid);
-          cryptonote::transaction tx;
-          if (!parse_and_validate_tx_from_blob(bd, tx))
+          parsed_tx_cache::entry e;
+          if (!get_parsed_tx(txid, e))
           {
             MERROR("Failed to parse tx from txpool");
             // continue
@@ -595,9 +674,10 @@ namespace cryptonote
           {
             // remove first, so we only remove key images if the tx removal succeeds
             m_blockchain.remove_txpool_tx(txid);
-            m_txpool_weight -= get_transaction_weight(tx, bd.size());
-            remove_transaction_keyimages(tx);
+            m_txpool_weight -= get_transaction_weight(*e.tx, e.blob->size());
+            remove_transaction_keyimages(*e.tx);
           }
+          m_parsed_tx_cache.remove(txid);
         }
         catch (const std::exception &e)
         {
@@ -629,8 +709,9 @@ namespace cryptonote
         {
           try
           {
-            cryptonote::blobdata bd = m_blockchain.get_txpool_tx_blob(txid);
-            txs.push_back(std::make_pair(txid, bd));
+            parsed_tx_cache::entry e;
+            if (get_parsed_tx(txid, e))
+              txs.push_back(std::make_pair(txid, *e.blob));
           }
           catch (const std::exception &e)
           {
@@ -682,15 +763,25 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     txs.reserve(m_blockchain.get_txpool_tx_count(include_unrelayed_txes));
-    m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
-      transaction tx;
-      if (!parse_and_validate_tx_from_blob(*bd, tx))
+    m_blockchain.for_all_txpool_txes([this, &txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
+      parsed_tx_cache::entry e;
+      try
       {
-        MERROR("Failed to parse tx from txpool");
+        // blob is read by the same cursor pass, so cache misses don't look the tx up again
+        if (!get_parsed_tx(txid, e, bd))
+        {
+          MERROR("Failed to parse tx from txpool");
+          // continue
+          return true;
+        }
+      }
+      catch (const std::exception &ex)
+      {
+        MERROR("Failed to get tx from txpool: " << ex.what());
         // continue
         return true;
       }
-      txs.push_back(tx);
+      txs.push_back(*e.tx);
       return true;
     }, true, include_unrelayed_txes);
   }
@@ -751,6 +842,12 @@ namespace cryptonote
       return true;
       }, false, include_unrelayed_txes);
     stats.bytes_med = epee::misc_utils::median(weights);
+    const parsed_tx_cache::stats cache_stats = m_parsed_tx_cache.get_stats();
+    stats.tx_cache_hits = cache_stats.hits;
+    stats.tx_cache_misses = cache_stats.misses;
+    stats.tx_cache_entries = cache_stats.entries;
+    stats.tx_cache_bytes = cache_stats.bytes;
+    stats.tx_cache_max_bytes = cache_stats.max_bytes;
     if (stats.txs_total > 1)
     {
       /* looking for 98th percentile */
@@ -875,18 +972,27 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL1(m_blockchain);
     tx_infos.reserve(m_blockchain.get_txpool_tx_count());
     key_image_infos.reserve(m_blockchain.get_txpool_tx_count());
-    m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
+    m_blockchain.for_all_txpool_txes([this, &tx_infos, key_image_infos](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
       cryptonote::rpc::tx_in_pool txi;
       txi.tx_hash = txid;
-      transaction tx;
-      if (!parse_and_validate_tx_from_blob(*bd, tx))
+      parsed_tx_cache::entry e;
+      try
       {
-        MERROR("Failed to parse tx from txpool");
+        if (!get_parsed_tx(txid, e, bd))
+        {
+          MERROR("Failed to parse tx from txpool");
+          // continue
+          return true;
+        }
+      }
+      catch (const std::exception &ex)
+      {
+        MERROR("Failed to get tx from txpool: " << ex.what());
         // continue
         return true;
       }
-      txi.tx = tx;
-      txi.blob_size = bd->size();
+      txi.tx = *e.tx;
+      txi.blob_size = e.blob->size();
       txi.weight = meta.weight;
       txi.fee = meta.fee;
       txi.kept_by_block = meta.kept_by_block;
@@ -950,6 +1056,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
+    invalidate_block_template();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -957,6 +1064,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
+    invalidate_block_template();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -1015,25 +1123,15 @@ namespace cryptonote
     return ret;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction &tx) const
+  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const std::function<const cryptonote::transaction&(void)> &get_tx) const
   {
-    struct transction_parser
-    {
-      transction_parser(const cryptonote::blobdata &txblob, transaction &tx): txblob(txblob), tx(tx), parsed(false) {}
-      cryptonote::transaction &operator()()
-      {
-        if (!parsed)
-        {
-          if (!parse_and_validate_tx_from_blob(txblob, tx))
-            throw std::runtime_error("failed to parse transaction blob");
-          parsed = true;
-        }
-        return tx;
-      }
-      const cryptonote::blobdata &txblob;
-      transaction &tx;
-      bool parsed;
-    } lazy_tx(txblob, tx);
+    // inputs check may modify the transaction (expand it), so it gets its own copy
+    std::unique_ptr<transaction> inputs_tx;
+    auto get_inputs_tx = [&inputs_tx, &get_tx]()->cryptonote::transaction& {
+      if (!inputs_tx)
+        inputs_tx.reset(new transaction(get_tx()));
+      return *inputs_tx;
+    };
 
     //not the best implementation at this time, sorry :(
     //check is ring_signature already checked ?
@@ -1044,7 +1142,7 @@ namespace cryptonote
         return false;//we already sure that this tx is broken for this height
 
       tx_verification_context tvc;
-      if(!check_tx_inputs([&lazy_tx]()->cryptonote::transaction&{ return lazy_tx(); }, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
+      if(!check_tx_inputs(get_inputs_tx, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
       {
         txd.last_failed_height = m_blockchain.get_current_blockchain_height()-1;
         txd.last_failed_id = m_blockchain.get_block_id_by_height(txd.last_failed_height);
@@ -1061,7 +1159,7 @@ namespace cryptonote
           return false;
         //check ring signature again, it is possible (with very small chance) that this transaction become again valid
         tx_verification_context tvc;
-        if(!check_tx_inputs([&lazy_tx]()->cryptonote::transaction&{ return lazy_tx(); }, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
+        if(!check_tx_inputs(get_inputs_tx, txid, txd.max_used_block_height, txd.max_used_block_id, tvc))
         {
           txd.last_failed_height = m_blockchain.get_current_blockchain_height()-1;
           txd.last_failed_id = m_blockchain.get_block_id_by_height(txd.last_failed_height);
@@ -1070,7 +1168,7 @@ namespace cryptonote
       }
     }
     //if we here, transaction seems valid, but, anyway, check for key_images collisions with blockchain, just to be sure
-    if(m_blockchain.have_tx_keyimges_as_spent(lazy_tx()))
+    if(m_blockchain.have_tx_keyimges_as_spent(get_tx()))
     {
       txd.double_spend_seen = true;
       return false;
@@ -1142,7 +1240,10 @@ namespace cryptonote
       }
     }
     if (changed)
+    {
+      invalidate_block_template();
       ++m_cookie;
+    }
   }
   //---------------------------------------------------------------------------------
   std::string tx_memory_pool::print_pool(bool short_format) const
@@ -1179,6 +1280,16 @@ namespace cryptonote
   //TODO: investigate whether boolean return is appropriate
   bool tx_memory_pool::fill_block_template(block &bl, size_t median_weight, uint64_t already_generated_coins, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward, uint8_t version)
   {
+    {
+      // nothing changed since the last template, no need to look at the pool
+      CRITICAL_REGION_LOCAL(m_block_template_lock);
+      if (get_current_block_template(bl, median_weight, already_generated_coins, version, total_weight, fee, expected_reward))
+      {
+        LOG_PRINT_L2("Using current block template with " << bl.tx_hashes.size() << " txes");
+        return true;
+      }
+    }
+
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
 
@@ -1194,27 +1305,35 @@ namespace cryptonote
     size_t max_total_weight_v5 = 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
     size_t max_total_weight = version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
     std::unordered_set<crypto::key_image> k_images;
+    std::vector<crypto::hash> tx_hashes;
 
     LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
 
     LockedTXN lock(m_blockchain);
 
-    auto sorted_it = m_txs_by_fee_and_receive_time.begin();
-    for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
+    // RTA transactions are zero fee, so they get a reserved part of the penalty free weight before fee paying ones
+    const size_t rta_max_total_weight = std::min(max_total_weight, median_weight * config::graft::RTA_TX_TEMPLATE_WEIGHT_SHARE / 100);
+    std::unordered_map<crypto::hash, block_template_tx> template_txs;
+
+    // returns true if the transaction was added
+    auto add_tx = [&](const crypto::hash &txid, size_t weight_limit) -> bool
     {
+      if (template_txs.count(txid))
+        return false; // already added from RTA lane
+
       txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
+      if (!m_blockchain.get_txpool_tx_meta(txid, meta))
       {
         MERROR("  failed to find tx meta");
-        continue;
+        return false;
       }
-      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase));
+      LOG_PRINT_L2("Considering " << txid << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << weight_limit << ", current coinbase " << print_money(best_coinbase));
 
       // Can not exceed maximum block weight
-      if (max_total_weight < total_weight + meta.weight)
+      if (weight_limit < total_weight + meta.weight)
       {
         LOG_PRINT_L2("  would exceed maximum block weight");
-        continue;
+        return false;
       }
 
       // start using the optimal filling algorithm from v5
@@ -1226,28 +1345,28 @@ namespace cryptonote
         if(!get_block_reward(median_weight, total_weight + meta.weight, already_generated_coins, block_reward, version))
         {
           LOG_PRINT_L2("  would exceed maximum block weight");
-          continue;
+          return false;
         }
         coinbase = block_reward + fee + meta.fee;
         if (coinbase < template_accept_threshold(best_coinbase))
         {
           LOG_PRINT_L2("  would decrease coinbase to " << print_money(coinbase));
-          continue;
+          return false;
         }
       }
-      else
-      {
-        // If we've exceeded the penalty free weight,
-        // stop including more tx
-        if (total_weight > median_weight)
+
+      // the transaction is taken from the cache or read and parsed only when needed
+      std::shared_ptr<const transaction> tx;
+      auto get_tx = [this, &tx, &txid]()->const cryptonote::transaction& {
+        if (!tx)
         {
-          LOG_PRINT_L2("  would exceed median block weight");
-          break;
+          parsed_tx_cache::entry e;
+          if (!get_parsed_tx(txid, e))
+            throw std::runtime_error("failed to parse transaction blob");
+          tx = e.tx;
         }
-      }
-
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second);
-      cryptonote::transaction tx;
+        return *tx;
+      };
 
       // Skip transactions that are not ready to be
       // included into the blockchain or that are
@@ -1256,7 +1375,7 @@ namespace cryptonote
       bool ready = false;
       try
       {
-        ready = is_transaction_ready_to_go(meta, sorted_it->second, txblob, tx);
+        ready = is_transaction_ready_to_go(meta, txid, get_tx);
       }
       catch (const std::exception &e)
       {
@@ -1267,7 +1386,7 @@ namespace cryptonote
       {
         try
 	{
-	  m_blockchain.update_txpool_tx(sorted_it->second, meta);
+	  m_blockchain.update_txpool_tx(txid, meta);
 	}
         catch (const std::exception &e)
 	{
@@ -1278,29 +1397,175 @@ namespace cryptonote
       if (!ready)
       {
         LOG_PRINT_L2("  not ready to go");
-        continue;
+        return false;
+      }
+      try
+      {
+        get_tx();
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to get transaction " << txid << ": " << e.what());
+        return false;
       }
-      if (have_key_images(k_images, tx))
+      if (have_key_images(k_images, *tx))
       {
         LOG_PRINT_L2("  key images already seen");
-        continue;
+        return false;
       }
 
-      bl.tx_hashes.push_back(sorted_it->second);
+      tx_hashes.push_back(txid);
       total_weight += meta.weight;
       fee += meta.fee;
       best_coinbase = coinbase;
-      append_key_images(k_images, tx);
-      LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
+      append_key_images(k_images, *tx);
+      block_template_tx &template_tx = template_txs[txid];
+      template_tx.weight = meta.weight;
+      template_tx.fee = meta.fee;
+      for (const txin_v &in: tx->vin)
+        if (in.type() == typeid(txin_to_key))
+          template_tx.key_images.push_back(boost::get<txin_to_key>(in).k_image);
+      LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << weight_limit << ", coinbase " << print_money(best_coinbase));
+      return true;
+    };
+
+    // the last template still is what a full fill would give (see block_template_state),
+    // only the transactions added to the pool since then are to be considered
+    bool incremental = false;
+    bool complete = false;
+    std::vector<crypto::hash> added_txs;
+    {
+      CRITICAL_REGION_LOCAL(m_block_template_lock);
+      if (m_block_template.valid && (m_block_template.complete || m_block_template.has_cutoff) && m_block_template.median_weight == median_weight
+          && m_block_template.already_generated_coins == already_generated_coins && m_block_template.version == version)
+      {
+        incremental = true;
+        complete = m_block_template.complete;
+        tx_hashes.swap(m_block_template.tx_hashes);
+        template_txs.swap(m_block_template.txs);
+        k_images.swap(m_block_template.key_images);
+        added_txs.reserve(m_block_template.added_set.size());
+        for (const crypto::hash &txid: m_block_template.added)
+          if (m_block_template.added_set.count(txid))
+            added_txs.push_back(txid);
+        total_weight = m_block_template.total_weight;
+        fee = m_block_template.fee;
+      }
+      m_block_template = block_template_state();
+    }
+
+    if (incremental)
+    {
+      // drop transactions removed from the template
+      tx_hashes.erase(std::remove_if(tx_hashes.begin(), tx_hashes.end(), [&template_txs](const crypto::hash &txid) {
+        return !template_txs.count(txid);
+      }), tx_hashes.end());
+
+      LOG_PRINT_L2("Updating " << (complete ? "complete" : "saturated") << " block template with " << tx_hashes.size() << " txes, " << added_txs.size() << " added to the pool");
+      get_block_reward(median_weight, total_weight, already_generated_coins, best_coinbase, version);
+      best_coinbase += fee;
+      for (const crypto::hash &txid: added_txs)
+      {
+        if (complete)
+        {
+          if (!add_tx(txid, median_weight))
+          {
+            LOG_PRINT_L2("Block template needs a full fill");
+            incremental = false;
+            break;
+          }
+          continue;
+        }
+
+        // the way a full fill considers transactions after all the others
+        if (version < 5 && total_weight > median_weight)
+        {
+          LOG_PRINT_L2("  would exceed median block weight");
+          break;
+        }
+        add_tx(txid, max_total_weight);
+      }
+    }
+
+    if (!incremental)
+    {
+      tx_hashes.clear();
+      template_txs.clear();
+      k_images.clear();
+      total_weight = 0;
+      fee = 0;
+      get_block_reward(median_weight, total_weight, already_generated_coins, best_coinbase, version);
+
+      LOG_PRINT_L2("Filling RTA lane, " << m_rta_txs_by_receive_time.size() << " RTA txes, weight budget " << rta_max_total_weight);
+      for (const rta_tx_entry &entry : m_rta_txs_by_receive_time)
+      {
+        // If we've exceeded the penalty free weight,
+        // stop including more tx
+        if (version < 5 && total_weight > median_weight)
+          break;
+        add_tx(entry.second, rta_max_total_weight);
+        if (total_weight >= rta_max_total_weight)
+          break;
+      }
+
+      for (const tx_by_fee_and_receive_time_entry &entry : m_txs_by_fee_and_receive_time)
+      {
+        if (version < 5 && total_weight > median_weight)
+        {
+          LOG_PRINT_L2("  would exceed median block weight");
+          break;
+        }
+        add_tx(entry.second, max_total_weight);
+      }
+    }
+
+    {
+      CRITICAL_REGION_LOCAL(m_block_template_lock);
+      m_block_template.valid = true;
+      m_block_template.complete = tx_hashes.size() == m_txs_by_fee_and_receive_time.size() && total_weight <= median_weight;
+      m_block_template.has_cutoff = !m_txs_by_fee_and_receive_time.empty();
+      if (m_block_template.has_cutoff)
+        m_block_template.cutoff = *m_txs_by_fee_and_receive_time.rbegin();
+      m_block_template.median_weight = median_weight;
+      m_block_template.already_generated_coins = already_generated_coins;
+      m_block_template.version = version;
+      m_block_template.tx_hashes.swap(tx_hashes);
+      m_block_template.txs.swap(template_txs);
+      m_block_template.key_images.swap(k_images);
+      m_block_template.total_weight = total_weight;
+      m_block_template.fee = fee;
+      get_current_block_template(bl, median_weight, already_generated_coins, version, total_weight, fee, expected_reward);
     }
 
-    expected_reward = best_coinbase;
     LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
-        << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase)
+        << total_weight << "/" << max_total_weight << ", coinbase " << print_money(expected_reward)
         << " (including " << print_money(fee) << " in fees)");
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_current_block_template(block &bl, size_t median_weight, uint64_t already_generated_coins, uint8_t version, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward) const
+  {
+    if (!m_block_template.valid || !m_block_template.added_set.empty() || m_block_template.median_weight != median_weight
+        || m_block_template.already_generated_coins != already_generated_coins || m_block_template.version != version)
+      return false;
+    bl.tx_hashes.clear();
+    bl.tx_hashes.reserve(m_block_template.txs.size());
+    for (const crypto::hash &txid: m_block_template.tx_hashes)
+      if (m_block_template.txs.count(txid))
+        bl.tx_hashes.push_back(txid);
+    total_weight = m_block_template.total_weight;
+    fee = m_block_template.fee;
+    get_block_reward(median_weight, total_weight, already_generated_coins, expected_reward, version);
+    expected_reward += fee;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::invalidate_block_template()
+  {
+    CRITICAL_REGION_LOCAL(m_block_template_lock);
+    m_block_template = block_template_state();
+  }
+  //---------------------------------------------------------------------------------
   size_t tx_memory_pool::validate(uint8_t version)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -1330,17 +1595,17 @@ namespace cryptonote
       {
         try
         {
-          cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid);
-          cryptonote::transaction tx;
-          if (!parse_and_validate_tx_from_blob(txblob, tx))
+          parsed_tx_cache::entry e;
+          if (!get_parsed_tx(txid, e))
           {
             MERROR("Failed to parse tx from txpool");
             continue;
           }
           // remove tx from db first
           m_blockchain.remove_txpool_tx(txid);
-          m_txpool_weight -= get_transaction_weight(tx, txblob.size());
-          remove_transaction_keyimages(tx);
+          m_txpool_weight -= get_transaction_weight(*e.tx, e.blob->size());
+          remove_transaction_keyimages(*e.tx);
+          m_parsed_tx_cache.remove(txid);
           auto sorted_it = find_tx_in_sorted_container(txid);
           if (sorted_it == m_txs_by_fee_and_receive_time.end())
           {
@@ -1348,7 +1613,7 @@ namespace cryptonote
           }
           else
           {
-            m_txs_by_fee_and_receive_time.erase(sorted_it);
+            remove_from_sorted_containers(sorted_it);
           }
           ++n_removed;
         }
@@ -1371,6 +1636,9 @@ namespace cryptonote
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
+    m_rta_txs_by_receive_time.clear();
+    m_parsed_tx_cache.clear();
+    invalidate_block_template();
     m_spent_key_images.clear();
     m_txpool_weight = 0;
     std::vector<crypto::hash> remove;
@@ -1383,19 +1651,20 @@ namespace cryptonote
       bool r = m_blockchain.for_all_txpool_txes([this, &remove, kept](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
         if (!!kept != !!meta.kept_by_block)
           return true;
-        cryptonote::transaction tx;
-        if (!parse_and_validate_tx_from_blob(*bd, tx))
+        parsed_tx_cache::entry e;
+        if (!get_parsed_tx(txid, e, bd))
         {
           MWARNING("Failed to parse tx from txpool, removing");
           remove.push_back(txid);
           return true;
         }
+        const cryptonote::transaction &tx = *e.tx;
         if (!insert_key_images(tx, meta.kept_by_block))
         {
           MFATAL("Failed to insert key images from txpool tx");
           return false;
         }
-        m_txs_by_fee_and_receive_time.emplace(std::pair<double, time_t>(meta.fee / (double)meta.weight, meta.receive_time), txid);
+        add_to_sorted_containers(tx, txid, meta.fee, meta.weight, meta.receive_time);
         m_txpool_weight += meta.weight;
         return true;
       }, true);
@@ -1475,7 +1744,9 @@ namespace cryptonote
 
   bool tx_memory_pool::validate_supernode(uint64_t height, const public_key &id) const
   {
-    supernode_stake * stake = const_cast<supernode_stake*>(m_stp->find_supernode_stake(height, epee::string_tools::pod_to_hex(id)));
-    return stake ? stake->amount >= config::graft::TIER1_STAKE_AMOUNT : false;
+    supernode_stake stake;
+    if (!m_stp->find_supernode_stake(height, id, stake))
+      return false;
+    return stake.amount >= config::graft::TIER1_STAKE_AMOUNT;
   };
 }
@@ -31,6 +31,8 @@
 #pragma once
 #include "include_base_utils.h"
 
+#include <functional>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -44,6 +46,7 @@
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_basic/verification_context.h"
 #include "blockchain_db/blockchain_db.h"
+#include "parsed_tx_cache.h"
 #include "crypto/hash.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "rpc/message_data_structs.h"
@@ -77,6 +80,22 @@ namespace cryptonote
   //! container for sorting transactions by fee per unit size
   typedef std::set<tx_by_fee_and_receive_time_entry, txCompare> sorted_tx_container;
 
+  typedef std::pair<std::time_t, crypto::hash> rta_tx_entry;
+
+  class rtaTxCompare
+  {
+  public:
+    bool operator()(const rta_tx_entry& a, const rta_tx_entry& b) const
+    {
+      // oldest first
+      if (a.first != b.first) return a.first < b.first;
+      return memcmp(&a.second, &b.second, sizeof(crypto::hash)) < 0;
+    }
+  };
+
+  //! container for RTA transactions ordered by receive time
+  typedef std::set<rta_tx_entry, rtaTxCompare> rta_tx_container;
+
   /**
    * @brief Transaction pool, handles transactions which are not part of a block
    *
@@ -514,12 +533,52 @@ namespace cryptonote
      *
      * @param txd the transaction to check (and info about it)
      * @param txid the txid of the transaction to check
-     * @param txblob the transaction blob to check
-     * @param tx the parsed transaction, if successful
+     * @param get_tx returns the parsed transaction, called only when it's needed for the checks
      *
      * @return true if the transaction is good to go, otherwise false
      */
-    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction &tx) const;
+    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const std::function<const cryptonote::transaction&(void)> &get_tx) const;
+
+    /**
+     * @brief add a transaction to the sorted containers
+     *
+     * @param tx the transaction
+     * @param id the transaction's hash
+     * @param fee the transaction's fee
+     * @param tx_weight the transaction's weight
+     * @param receive_time the time the transaction has been received
+     */
+    void add_to_sorted_containers(const transaction &tx, const crypto::hash &id, uint64_t fee, size_t tx_weight, std::time_t receive_time);
+
+    /**
+     * @brief remove a transaction from the sorted containers and the block template cache
+     *
+     * @param it the transaction's position in m_txs_by_fee_and_receive_time
+     */
+    void remove_from_sorted_containers(sorted_tx_container::iterator it);
+
+    /**
+     * @brief follow a transaction removal in the block template state
+     *
+     * A template holding every pool transaction drops it. A saturated
+     * template is kept if the transaction was left out of it, otherwise it
+     * is invalidated.
+     *
+     * @param id the hash of the removed transaction
+     */
+    void remove_from_block_template(const crypto::hash &id);
+
+    //! drop the block template state, the next template is filled from scratch
+    void invalidate_block_template();
+
+    /**
+     * @brief get the last block template if nothing it depends on changed
+     *
+     * Must be called with m_block_template_lock held.
+     *
+     * @return true if the template was returned
+     */
+    bool get_current_block_template(block &bl, size_t median_weight, uint64_t already_generated_coins, uint8_t version, size_t &total_weight, uint64_t &fee, uint64_t &expected_reward) const;
 
     /**
      * @brief mark all transactions double spending the one passed
@@ -568,6 +627,59 @@ private:
     //!< container for transactions organized by fee per size and receive time
     sorted_tx_container m_txs_by_fee_and_receive_time;
 
+    //! RTA transactions, considered before the others when filling a block template
+    rta_tx_container m_rta_txs_by_receive_time;
+
+    //! what the block template state keeps of an included transaction, so it can be removed again
+    struct block_template_tx
+    {
+      size_t weight;
+      uint64_t fee;
+      std::vector<crypto::key_image> key_images;
+    };
+
+    /**
+     * @brief state of the last block template
+     *
+     * The template is exactly what a full fill would give as long as:
+     * - it holds every pool transaction within the penalty free weight
+     *   (complete), then pool removals are applied to it directly and pool
+     *   additions are queued to be checked by the next fill_block_template
+     *   call;
+     * - or it is saturated, and every transaction added to the pool since
+     *   then sorts after the cutoff, i.e. after all the transactions the
+     *   fill considered. Such additions are queued to be considered last,
+     *   removals of transactions left out of the template change nothing.
+     * Any other pool change or a new block resets it and the next template
+     * is filled from scratch.
+     */
+    struct block_template_state
+    {
+      block_template_state(): valid(false), complete(false), median_weight(0), already_generated_coins(0), version(0), has_cutoff(false), total_weight(0), fee(0) {}
+
+      bool valid;
+      bool complete; //!< holds every pool transaction within the penalty free weight
+      size_t median_weight;
+      uint64_t already_generated_coins;
+      uint8_t version;
+      bool has_cutoff;
+      tx_by_fee_and_receive_time_entry cutoff; //!< last pool transaction considered by a saturated template
+      std::vector<crypto::hash> tx_hashes; //!< may keep removed transactions, txs is authoritative
+      std::unordered_map<crypto::hash, block_template_tx> txs;
+      std::unordered_set<crypto::key_image> key_images;
+      std::vector<crypto::hash> added; //!< transactions added to the pool since the template was filled, in order
+      std::unordered_set<crypto::hash> added_set; //!< the ones of added still in the pool
+      size_t total_weight;
+      uint64_t fee;
+    };
+
+    //! lock for m_block_template, taken after m_transactions_lock, alone when the template is current
+    mutable epee::critical_section m_block_template_lock;
+    block_template_state m_block_template;
+
+    //! parsed pool transactions, so hot paths neither read nor parse the blobs again
+    mutable parsed_tx_cache m_parsed_tx_cache;
+
     std::atomic<uint64_t> m_cookie; //!< incremented at each change
 
     /**
@@ -579,6 +691,19 @@ private:
      */
     sorted_tx_container::iterator find_tx_in_sorted_container(const crypto::hash& id) const;
 
+    /**
+     * @brief get a parsed pool transaction, from the cache or read and parsed
+     *
+     * Entries are evicted when the transaction leaves the pool.
+     *
+     * @param txid the transaction id
+     * @param e return-by-reference the parsed transaction, its prefix hash and blob
+     * @param blob the transaction blob if already at hand, read from the db otherwise
+     *
+     * @return false if the blob fails to parse, throws if it can not be read
+     */
+    bool get_parsed_tx(const crypto::hash &txid, parsed_tx_cache::entry &e, const cryptonote::blobdata *blob = nullptr) const;
+
     //! cache/call Blockchain::check_tx_inputs results
     bool check_tx_inputs(const std::function<cryptonote::transaction&(void)> &get_tx, const crypto::hash &txid, uint64_t &max_used_block_height, crypto::hash &max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false) const;
 
@@ -1026,6 +1026,11 @@ bool t_rpc_command_executor::print_transaction_pool_stats() {
       << "fees " << cryptonote::print_money(res.pool_stats.fee_total) << " (avg " << cryptonote::print_money(n_transactions ? res.pool_stats.fee_total / n_transactions : 0) << " per tx" << ", " << cryptonote::print_money(res.pool_stats.bytes_total ? res.pool_stats.fee_total / res.pool_stats.bytes_total : 0) << " per byte)" << std::endl
       << res.pool_stats.num_double_spends << " double spends, " << res.pool_stats.num_not_relayed << " not relayed, " << res.pool_stats.num_failing << " failing, " << res.pool_stats.num_10m << " older than 10 minutes (oldest " << (res.pool_stats.oldest == 0 ? "-" : get_human_time_ago(res.pool_stats.oldest, now)) << "), " << backlog_message;
 
+  const uint64_t tx_cache_lookups = res.pool_stats.tx_cache_hits + res.pool_stats.tx_cache_misses;
+  tools::msg_writer() << "parsed tx cache: " << res.pool_stats.tx_cache_entries << " tx(es), " << res.pool_stats.tx_cache_bytes << "/" << res.pool_stats.tx_cache_max_bytes << " bytes, "
+      << res.pool_stats.tx_cache_hits << " hits, " << res.pool_stats.tx_cache_misses << " misses ("
+      << (tx_cache_lookups ? 100.0 * res.pool_stats.tx_cache_hits / tx_cache_lookups : 0.0) << "% hit rate)";
+
   if (n_transactions > 1 && res.pool_stats.histo.size())
   {
     std::vector<uint64_t> times;
@@ -31,6 +31,9 @@ constexpr uint64_t TIER4_STAKE_AMOUNT = COIN * 250000;
 
 constexpr size_t TIERS_COUNT = 4;
 
+// share of the median block weight (percent) reserved for RTA transactions in block templates
+constexpr size_t RTA_TX_TEMPLATE_WEIGHT_SHARE = 50;
+
 }
 
 }
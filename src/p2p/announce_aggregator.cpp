@@ -0,0 +1,95 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "announce_aggregator.h"
+
+namespace nodetool
+{
+  announce_aggregator::announce_aggregator()
+    : m_stats()
+  {
+  }
+
+  bool announce_aggregator::add(const COMMAND_SUPERNODE_ANNOUNCE::request& request, std::string relay_blob)
+  {
+    const std::string key = request.supernode_public_id + ':' + std::to_string(request.height);
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    auto it = m_pending_index.find(key);
+    if (it != m_pending_index.end())
+    {
+      // keep the shortest route, relay if any of the copies has to be relayed
+      announce& pending = m_pending[it->second];
+      if (!relay_blob.empty() && (pending.relay_blob.empty() || request.hop < pending.request.hop))
+      {
+        pending.request = request;
+        pending.relay_blob = std::move(relay_blob);
+      }
+      ++m_stats.deduplicated;
+      return false;
+    }
+
+    m_pending_index.emplace(key, m_pending.size());
+    m_pending.push_back(announce{request, std::move(relay_blob)});
+    ++m_stats.aggregated;
+    return true;
+  }
+
+  bool announce_aggregator::take(std::vector<announce>& batch)
+  {
+    batch.clear();
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_pending.empty())
+      return false;
+    batch.swap(m_pending);
+    m_pending_index.clear();
+    ++m_stats.batches;
+    return true;
+  }
+
+  void announce_aggregator::add_saved_messages(uint64_t messages, uint64_t bytes)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stats.messages_saved += messages;
+    m_stats.bytes_saved += bytes;
+  }
+
+  void announce_aggregator::add_saved_posts(uint64_t posts)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stats.posts_saved += posts;
+  }
+
+  announce_aggregator_stats announce_aggregator::get_stats() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_stats;
+  }
+}
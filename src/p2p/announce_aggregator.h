@@ -0,0 +1,101 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "p2p_protocol_defs.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief announce_aggregator_stats - counters of the supernode announce aggregator
+   */
+  struct announce_aggregator_stats
+  {
+    uint64_t aggregated;       ///< announces queued for delivery
+    uint64_t deduplicated;     ///< announces dropped as duplicates of a queued one
+    uint64_t batches;          ///< flushed batches
+    uint64_t messages_saved;   ///< p2p messages saved by sending batches instead of single announces
+    uint64_t bytes_saved;      ///< p2p bytes saved by sending batches instead of single announces
+    uint64_t posts_saved;      ///< HTTP posts to local supernodes saved by posting batches
+  };
+
+  /*!
+   * \brief announce_aggregator - coalesces supernode announces received within a short window
+   *
+   * Announces are deduplicated by (supernode id, height) and taken by the p2p node as one batch, which
+   * is relayed to each peer in a single levin message and posted to each local supernode at once.
+   */
+  class announce_aggregator
+  {
+  public:
+    struct announce
+    {
+      COMMAND_SUPERNODE_ANNOUNCE::request request; ///< announce as received
+      std::string relay_blob;                      ///< serialized announce with incremented hop, empty if it isn't relayed
+    };
+
+    announce_aggregator();
+
+    announce_aggregator(const announce_aggregator&) = delete;
+    announce_aggregator& operator=(const announce_aggregator&) = delete;
+
+    /*!
+     * \brief add - queue announce for delivery
+     * \param request    - received announce
+     * \param relay_blob - serialized announce to relay to peers, empty to deliver it to local supernodes only
+     * \return           - false if the same announce is already queued
+     */
+    bool add(const COMMAND_SUPERNODE_ANNOUNCE::request& request, std::string relay_blob);
+
+    /*!
+     * \brief take - take all queued announces
+     * \return     - false if there are no queued announces
+     */
+    bool take(std::vector<announce>& batch);
+
+    void add_saved_messages(uint64_t messages, uint64_t bytes);
+    void add_saved_posts(uint64_t posts);
+
+    announce_aggregator_stats get_stats() const;
+
+  private:
+    mutable boost::mutex m_mutex;
+    std::vector<announce> m_pending;
+    std::unordered_map<std::string, size_t> m_pending_index;
+    announce_aggregator_stats m_stats;
+  };
+}
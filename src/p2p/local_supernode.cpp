@@ -0,0 +1,187 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <limits>
+
+#include "local_supernode.h"
+#include "net/http_client.h"
+#include "misc_log_ex.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "net.p2p.supernode"
+
+namespace nodetool
+{
+  local_supernode::local_supernode(std::string host, uint64_t port, std::string uri, const options& opts)
+    : m_options(opts)
+    , m_http_host(std::move(host))
+    , m_http_port(port)
+    , m_uri(std::move(uri))
+    , m_server_version(0)
+    , m_stats()
+    , m_total_latency_ms(0)
+    , m_stop(false)
+    , m_acknowledged_list_version(0)
+  {
+    if (!m_options.max_queue_size)
+      m_options.max_queue_size = 1;
+    if (!m_options.workers_count)
+      m_options.workers_count = 1;
+
+    m_workers.reserve(m_options.workers_count);
+    for (size_t i = 0; i < m_options.workers_count; ++i)
+      m_workers.push_back(boost::thread(&local_supernode::worker, this));
+  }
+
+  local_supernode::~local_supernode()
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_has_work.notify_all();
+    for (boost::thread &thread : m_workers)
+      if (thread.joinable())
+        thread.join();
+  }
+
+  void local_supernode::update(const std::string &new_host, uint64_t new_port, const std::string &new_uri)
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (new_host != m_http_host || new_port != m_http_port) {
+      m_http_host = new_host;
+      m_http_port = new_port;
+      m_uri = new_uri;
+      ++m_server_version; // workers reconnect before the next request
+    }
+  }
+
+  const std::string& local_supernode::json_content_type()
+  {
+    static const std::string content_type("application/json; charset=utf-8");
+    return content_type;
+  }
+
+  const std::string& local_supernode::binary_content_type()
+  {
+    static const std::string content_type("application/octet-stream");
+    return content_type;
+  }
+
+  bool local_supernode::post(const std::string& endpoint, std::string body, const response_handler& handler, const std::string& content_type)
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      if (m_queue.size() >= m_options.max_queue_size) {
+        ++m_stats.dropped;
+        if (m_options.policy == drop_newest) {
+          MWARNING("Supernode " << m_http_host << ":" << m_http_port << " queue is full, dropping request to " << endpoint);
+          return false;
+        }
+        MWARNING("Supernode " << m_http_host << ":" << m_http_port << " queue is full, dropping request to " << m_queue.front().endpoint);
+        m_queue.pop_front();
+      }
+      request req;
+      req.endpoint = endpoint;
+      req.body = std::move(body);
+      req.content_type = content_type;
+      req.handler = handler;
+      m_queue.push_back(std::move(req));
+      ++m_stats.queued;
+      if (m_queue.size() > m_stats.max_queue_depth)
+        m_stats.max_queue_depth = m_queue.size();
+    }
+    m_has_work.notify_one();
+    return true;
+  }
+
+  local_supernode_stats local_supernode::get_stats() const
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    local_supernode_stats stats = m_stats;
+    stats.queue_depth = m_queue.size();
+    stats.avg_latency_ms = m_stats.sent + m_stats.failed ? m_total_latency_ms / (m_stats.sent + m_stats.failed) : 0;
+    return stats;
+  }
+
+  void local_supernode::worker()
+  {
+    epee::net_utils::http::http_simple_client client;
+    uint64_t server_version = std::numeric_limits<uint64_t>::max();
+    epee::net_utils::http::fields_list additional_params(1, std::make_pair(std::string("Content-Type"), json_content_type()));
+
+    for (;;)
+    {
+      request req;
+      std::string uri;
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (!m_stop && m_queue.empty())
+          m_has_work.wait(lock);
+        if (m_stop)
+          return;
+        req = std::move(m_queue.front());
+        m_queue.pop_front();
+        ++m_stats.in_flight;
+        if (server_version != m_server_version) {
+          client.set_server(m_http_host, std::to_string(m_http_port), {});
+          server_version = m_server_version;
+        }
+        uri = m_uri + req.endpoint;
+      }
+
+      additional_params.front().second = req.content_type;
+      const auto start = std::chrono::steady_clock::now();
+      const epee::net_utils::http::http_response_info *info = nullptr;
+      bool r = client.invoke(uri, "POST", req.body, m_options.timeout, std::addressof(info), additional_params);
+      if (!r || !info) {
+        LOG_PRINT_L1("Failed to invoke http request to " << uri);
+        r = false;
+      } else if (info->m_response_code != 200) {
+        LOG_PRINT_L1("Failed to invoke http request to " << uri << ", wrong response code: " << info->m_response_code);
+        r = false;
+      } else if (req.handler) {
+        try {
+          r = req.handler(info->m_body);
+        } catch (const std::exception &e) {
+          MERROR("Failed to handle response from " << uri << ": " << e.what());
+          r = false;
+        }
+      }
+      const uint64_t latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      --m_stats.in_flight;
+      ++(r ? m_stats.sent : m_stats.failed);
+      m_stats.last_latency_ms = latency_ms;
+      if (latency_ms > m_stats.max_latency_ms)
+        m_stats.max_latency_ms = latency_ms;
+      m_total_latency_ms += latency_ms;
+    }
+  }
+}
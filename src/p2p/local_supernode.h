@@ -0,0 +1,143 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace nodetool
+{
+  /*!
+   * \brief local_supernode_stats - delivery counters of a local supernode queue
+   */
+  struct local_supernode_stats
+  {
+    uint64_t queued;
+    uint64_t sent;
+    uint64_t failed;
+    uint64_t dropped;
+    uint64_t queue_depth;
+    uint64_t max_queue_depth;
+    uint64_t in_flight;
+    uint64_t last_latency_ms;
+    uint64_t avg_latency_ms;
+    uint64_t max_latency_ms;
+  };
+
+  /*!
+   * \brief local_supernode - supernode connected to this daemon via HTTP
+   *
+   * Requests are posted to a bounded queue and delivered by dedicated worker threads over kept-alive
+   * connections, so the caller (p2p handlers) never waits for the supernode.
+   */
+  class local_supernode
+  {
+  public:
+    enum overflow_policy
+    {
+      drop_oldest, ///< drop the oldest queued request to make room for a new one
+      drop_newest  ///< reject a new request while the queue is full
+    };
+
+    struct options
+    {
+      size_t max_queue_size;
+      size_t workers_count;
+      overflow_policy policy;
+      std::chrono::milliseconds timeout;
+
+      options() : max_queue_size(1000), workers_count(1), policy(drop_oldest), timeout(3000) {}
+    };
+
+    /// Checks HTTP response body of a delivered request
+    typedef std::function<bool(const std::string& response_body)> response_handler;
+
+    local_supernode(std::string host, uint64_t port, std::string uri, const options& opts = options());
+    ~local_supernode();
+
+    local_supernode(const local_supernode&) = delete;
+    local_supernode& operator=(const local_supernode&) = delete;
+
+    void update(const std::string &new_host, uint64_t new_port, const std::string &new_uri);
+
+    /*!
+     * \brief post - enqueue request for asynchronous delivery, never blocks on network
+     * \param endpoint     - request path relative to the supernode's base uri
+     * \param body         - serialized request body
+     * \param handler      - optional response check, called from a worker thread
+     * \param content_type - content type of the body, JSON by default
+     * \return             - false if request has been rejected because of full queue
+     */
+    bool post(const std::string& endpoint, std::string body, const response_handler& handler = response_handler(),
+              const std::string& content_type = json_content_type());
+
+    static const std::string& json_content_type();
+    static const std::string& binary_content_type();
+
+    local_supernode_stats get_stats() const;
+
+    /// Version of the blockchain based list the supernode has confirmed to receive, 0 if none
+    uint64_t acknowledged_list_version() const { return m_acknowledged_list_version; }
+    void set_acknowledged_list_version(uint64_t version) { m_acknowledged_list_version = version; }
+
+  private:
+    struct request
+    {
+      std::string endpoint;
+      std::string body;
+      std::string content_type;
+      response_handler handler;
+    };
+
+    void worker();
+
+  private:
+    options m_options;
+    std::string m_http_host;
+    uint64_t m_http_port;
+    std::string m_uri;
+    uint64_t m_server_version;
+    std::deque<request> m_queue;
+    local_supernode_stats m_stats;
+    uint64_t m_total_latency_ms;
+    bool m_stop;
+    std::atomic<uint64_t> m_acknowledged_list_version;
+    mutable boost::mutex m_mutex;
+    boost::condition_variable m_has_work;
+    std::vector<boost::thread> m_workers;
+  };
+}
@@ -48,8 +48,13 @@
 #include "common/command_line.h"
 #include "net/jsonrpc_structs.h"
 #include "storages/http_abstract_invoke.h"
+#include "announce_aggregator.h"
+#include "local_supernode.h"
+#include "request_cache.h"
+#include "relay_buffer.h"
 
 #include <map>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -58,6 +63,13 @@
 PUSH_WARNINGS
 DISABLE_VS_WARNINGS(4355)
 
+#define REQUEST_CACHE_TIME 2 * 60 * 1000
+
+// Same as HANDLE_NOTIFY_T2, but the handler also gets the received body to relay it without serializing again
+#define HANDLE_RELAY_NOTIFY_T2(NOTIFY, func) \
+  if(is_notify && NOTIFY::ID == command) \
+  {handled=true;return epee::net_utils::buff_to_t_adapter<internal_owner_type_name, typename NOTIFY::request>(this, command, in_buff, boost::bind(func, this, _1, _2, _3, boost::cref(in_buff)), context);}
+
 namespace nodetool
 {
   using Uuid = boost::uuids::uuid;
@@ -72,27 +84,6 @@ namespace nodetool
     bool m_in_timedsync;
   };
 
-  struct local_supernode {
-    local_supernode(std::string host, uint64_t port, std::string uri) : http_host(std::move(host)), http_port(port), uri(std::move(uri)) {
-        client.set_server(http_host, std::to_string(http_port), {});
-    }
-
-    void update(const std::string &new_host, uint64_t new_port, const std::string &new_uri) {
-        if (new_host != http_host || new_port != http_port) {
-            if (client.is_connected()) client.disconnect();
-            client.set_server(new_host, std::to_string(new_port), {});
-            http_host = new_host;
-            http_port = new_port;
-            uri = new_uri;
-        }
-    }
-
-    std::string http_host;
-    uint64_t http_port;
-    std::string uri;
-    epee::net_utils::http::http_simple_client client;
-  };
-
   template<class t_payload_net_handler>
   class node_server: public epee::levin::levin_commands_handler<p2p_connection_context_t<typename t_payload_net_handler::connection_context> >,
                      public i_p2p_endpoint<typename t_payload_net_handler::connection_context>,
@@ -181,7 +172,7 @@ namespace nodetool
      */
     void do_unicast(const cryptonote::COMMAND_RPC_UNICAST::request &req);
 
-    std::vector<cryptonote::route_data> get_tunnels() const;
+    std::vector<cryptonote::route_data> get_tunnels();
 
   private:
     const std::vector<std::string> m_seed_nodes_list =
@@ -197,10 +188,11 @@ namespace nodetool
     CHAIN_LEVIN_NOTIFY_MAP2(p2p_connection_context); //move levin_commands_handler interface notify(...) callbacks into nothing
 
     BEGIN_INVOKE_MAP2(node_server)
-      HANDLE_NOTIFY_T2(COMMAND_SUPERNODE_ANNOUNCE, &node_server::handle_supernode_announce)
-      HANDLE_NOTIFY_T2(COMMAND_BROADCAST, &node_server::handle_broadcast)
-      HANDLE_NOTIFY_T2(COMMAND_MULTICAST, &node_server::handle_multicast)
-      HANDLE_NOTIFY_T2(COMMAND_UNICAST, &node_server::handle_unicast)
+      HANDLE_RELAY_NOTIFY_T2(COMMAND_SUPERNODE_ANNOUNCE, &node_server::handle_supernode_announce)
+      HANDLE_RELAY_NOTIFY_T2(COMMAND_SUPERNODE_ANNOUNCE_BATCH, &node_server::handle_supernode_announce_batch)
+      HANDLE_RELAY_NOTIFY_T2(COMMAND_BROADCAST, &node_server::handle_broadcast)
+      HANDLE_RELAY_NOTIFY_T2(COMMAND_MULTICAST, &node_server::handle_multicast)
+      HANDLE_RELAY_NOTIFY_T2(COMMAND_UNICAST, &node_server::handle_unicast)
 
       HANDLE_INVOKE_T2(COMMAND_HANDSHAKE, &node_server::handle_handshake)
       HANDLE_INVOKE_T2(COMMAND_TIMED_SYNC, &node_server::handle_timed_sync)
@@ -222,11 +214,39 @@ namespace nodetool
     uint64_t get_max_hop(const std::list<std::string> &addresses);
     std::list<std::string> get_routes();
 
+    typedef std::map<std::string, nodetool::supernode_route> supernode_route_map;
+
+    /*!
+     * \brief get_routes_snapshot - immutable copy of the supernode route table
+     *
+     * The copy is rebuilt only after announces changed peers or hops of a route, so readers neither copy
+     * the table nor take m_supernode_lock while it's unchanged. Announce heights and times in the copy
+     * may be outdated.
+     */
+    std::shared_ptr<const supernode_route_map> get_routes_snapshot();
+
     // sometimes supernode gets very busy so it doesn't respond within 1 second, increasing timeout to 3s
     static constexpr size_t SUPERNODE_HTTP_TIMEOUT_MILLIS = 3 * 1000;
+    /*!
+     * \brief make_supernode_response_handler - checks status of supernode's response
+     */
     template<class request_struct>
-    int post_request_to_supernode(local_supernode &supernode, const std::string &method, const typename request_struct::request &body,
-                                  const std::string &endpoint = std::string())
+    static local_supernode::response_handler make_supernode_response_handler(bool binary = false)
+    {
+        return [binary](const std::string &response_body) {
+            typename request_struct::response resp = AUTO_VAL_INIT(resp);
+            bool r = binary ? epee::serialization::load_t_from_binary(resp, response_body)
+                            : epee::serialization::load_t_from_json(resp, response_body);
+            return r && resp.status != 0;
+        };
+    }
+
+    /*!
+     * \brief make_supernode_request - serializes request to JSON-RPC body and returns request uri
+     */
+    template<class request_struct>
+    static bool make_supernode_request(const std::string &method, const typename request_struct::request &body,
+                                       const std::string &endpoint, std::string &uri, std::string &req_body)
     {
         boost::value_initialized<epee::json_rpc::request<typename request_struct::request> > init_req;
         epee::json_rpc::request<typename request_struct::request>& req = static_cast<epee::json_rpc::request<typename request_struct::request> &>(init_req);
@@ -235,39 +255,75 @@ namespace nodetool
         req.method = method;
         req.params = body;
 
-        std::string uri = "/" + method;
+        uri = "/" + method;
         if (!endpoint.empty())
         {
             uri = endpoint;
         }
-        typename request_struct::response resp = AUTO_VAL_INIT(resp);
-        bool r = epee::net_utils::invoke_http_json(supernode.uri + uri,
-                                                   req, resp, supernode.client,
-                                                   std::chrono::milliseconds(size_t(SUPERNODE_HTTP_TIMEOUT_MILLIS)), "POST");
-        if (!r || resp.status == 0)
+        return epee::serialization::store_t_to_json(req, req_body);
+    }
+
+    /*!
+     * \brief post_request_to_supernode - queues request to local supernode, doesn't wait for delivery
+     * \return                          - 1 if request has been queued, 0 otherwise
+     */
+    template<class request_struct>
+    int post_request_to_supernode(local_supernode &supernode, const std::string &method, const typename request_struct::request &body,
+                                  const std::string &endpoint = std::string())
+    {
+        std::string uri, req_body;
+        if (!make_supernode_request<request_struct>(method, body, endpoint, uri, req_body))
         {
             return 0;
         }
-        return 1;
+        bool r = supernode.post(uri, std::move(req_body), make_supernode_response_handler<request_struct>());
+        return r ? 1 : 0;
     }
 
+    /*!
+     * \brief post_request_to_supernodes - queues request to all local supernodes, request is serialized once
+     * \return                           - number of supernodes the request has been queued to
+     */
     template<class request_struct>
     int post_request_to_supernodes(const std::string &method, const typename request_struct::request &body,
                                    const std::string &endpoint = std::string())
+    {
+        std::string uri, req_body;
+        if (!make_supernode_request<request_struct>(method, body, endpoint, uri, req_body))
+        {
+            return 0;
+        }
+        return post_body_to_supernodes(uri, req_body, make_supernode_response_handler<request_struct>());
+    }
+
+    int post_body_to_supernodes(const std::string &uri, const std::string &body, const local_supernode::response_handler &handler,
+                                const std::string &content_type = local_supernode::json_content_type())
     {
         int ret = 0;
         for (auto &supernode : m_supernodes)
-            ret += post_request_to_supernode<request_struct>(supernode.second, method, body, endpoint);
+            ret += supernode.second->post(uri, body, handler, content_type) ? 1 : 0;
         return ret;
     }
 
-    void remove_old_request_cache();
+    /*!
+     * \brief aggregate_supernode_announce - updates route to the announced supernode and queues announce for delivery
+     * \param arg_buff - received body of a single announce, nullptr for an announce of a batch
+     * \return         - false if announce doesn't need to be delivered
+     */
+    bool aggregate_supernode_announce(COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context, const std::string* arg_buff);
+    /*!
+     * \brief flush_supernode_announces - delivers queued announces to local supernodes and relays them to peers
+     */
+    bool flush_supernode_announces();
+    void post_supernode_announces(const std::vector<announce_aggregator::announce>& announces);
+    void relay_supernode_announces(const std::vector<announce_aggregator::announce>& announces);
 
     //----------------- commands handlers ----------------------------------------------
-    int handle_supernode_announce(int command, typename COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context);
-    int handle_broadcast(int command, typename COMMAND_BROADCAST::request &arg, p2p_connection_context &context);
-    int handle_multicast(int command, typename COMMAND_MULTICAST::request &arg, p2p_connection_context &context);
-    int handle_unicast(int command, typename COMMAND_UNICAST::request &arg, p2p_connection_context &context);
+    int handle_supernode_announce(int command, typename COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context, const std::string& arg_buff);
+    int handle_supernode_announce_batch(int command, typename COMMAND_SUPERNODE_ANNOUNCE_BATCH::request& arg, p2p_connection_context& context, const std::string& arg_buff);
+    int handle_broadcast(int command, typename COMMAND_BROADCAST::request &arg, p2p_connection_context &context, const std::string &arg_buff);
+    int handle_multicast(int command, typename COMMAND_MULTICAST::request &arg, p2p_connection_context &context, const std::string &arg_buff);
+    int handle_unicast(int command, typename COMMAND_UNICAST::request &arg, p2p_connection_context &context, const std::string &arg_buff);
     int handle_handshake(int command, typename COMMAND_HANDSHAKE::request& arg, typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context);
     int handle_timed_sync(int command, typename COMMAND_TIMED_SYNC::request& arg, typename COMMAND_TIMED_SYNC::response& rsp, p2p_connection_context& context);
     int handle_ping(int command, COMMAND_PING::request& arg, COMMAND_PING::response& rsp, p2p_connection_context& context);
@@ -305,6 +361,13 @@ namespace nodetool
      * \return                - true on success
      */
     bool relay_notify(int command, const std::string& data_buff, const boost::uuids::uuid& connection_id);
+    /*!
+     * \brief relay_notify    - send pre-framed levin notification to remote connection
+     * \param frame           - header and body built once by epee::levin::make_notify_frame, shared by all recipients
+     * \param connection_id   - connection id
+     * \return                - true on success
+     */
+    bool relay_notify(const epee::net_utils::shared_buffer& frame, const boost::uuids::uuid& connection_id);
     //----------------- i_connection_filter  --------------------------------------------------------
     virtual bool is_remote_host_allowed(const epee::net_utils::network_address &address);
     //-----------------------------------------------------------------------------------------------
@@ -344,6 +407,8 @@ namespace nodetool
     std::set<std::string> get_seed_nodes(cryptonote::network_type nettype) const;
     bool connect_to_seed();
     bool find_connection_id_by_peer(const peerlist_entry &pe, boost::uuids::uuid &conn_id);
+    void add_peer_connection(const p2p_connection_context& context);
+    void remove_peer_connection(const p2p_connection_context& context);
     template <class Container>
     bool connect_to_peerlist(const Container& peers);
 
@@ -407,17 +472,20 @@ namespace nodetool
     {
         epee::net_utils::http::url_content parsed{};
         bool ret = epee::net_utils::parse_url(url, parsed);
+        std::unique_ptr<local_supernode> removed;
         boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
         auto it = m_supernodes.find(addr);
         if (!ret) {
-            if (it != m_supernodes.end()) m_supernodes.erase(it);
+            if (it != m_supernodes.end()) {
+                removed = std::move(it->second);
+                m_supernodes.erase(it);
+            }
         } else if (it == m_supernodes.end()) {
             LOG_PRINT_L0("Adding supernode " << addr << " at " << parsed.host << ":" << parsed.port);
-            m_supernodes.emplace(std::piecewise_construct,
-                    std::forward_as_tuple(addr),
-                    std::forward_as_tuple(std::move(parsed.host), parsed.port, std::move(parsed.uri)));
+            m_supernodes.emplace(addr, std::unique_ptr<local_supernode>(
+                    new local_supernode(std::move(parsed.host), parsed.port, std::move(parsed.uri), m_supernode_options)));
         } else {
-            it->second.update(parsed.host, parsed.port, parsed.uri);
+            it->second->update(parsed.host, parsed.port, parsed.uri);
         }
     }
 
@@ -442,14 +510,37 @@ namespace nodetool
         return s.str();
     }
 
-    bool remove_supernode(const std::string &addr) {
+    std::vector<std::pair<std::string, local_supernode_stats>> get_supernodes_stats() {
         boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-        return m_supernodes.erase(addr);
+        std::vector<std::pair<std::string, local_supernode_stats>> stats;
+        stats.reserve(m_supernodes.size());
+        for (auto &sn : m_supernodes) {
+            stats.emplace_back(sn.first, sn.second->get_stats());
+        }
+        return stats;
+    }
+
+    // supernodes are unlinked under the lock and stopped after it is released, stopping waits for
+    // requests in flight, up to the HTTP timeout
+    bool remove_supernode(const std::string &addr) {
+        std::unique_ptr<local_supernode> removed;
+        {
+            boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+            auto it = m_supernodes.find(addr);
+            if (it == m_supernodes.end())
+                return false;
+            removed = std::move(it->second);
+            m_supernodes.erase(it);
+        }
+        return true;
     }
 
     void reset_supernodes() {
-        boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-        m_supernodes.clear();
+        std::unordered_map<std::string, std::unique_ptr<local_supernode>> removed;
+        {
+            boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+            removed.swap(m_supernodes);
+        }
     }
 
     bool notify_peer_list(int command, const std::string& buf, const std::vector<peerlist_entry>& peers_to_send, bool try_connect = false);
@@ -463,18 +554,38 @@ namespace nodetool
     uint64_t get_broadcast_bytes_out() const { return m_broadcast_bytes_out; }
     uint64_t get_multicast_bytes_in() const { return m_multicast_bytes_in; }
     uint64_t get_multicast_bytes_out() const { return m_multicast_bytes_out; }
+    request_cache_stats get_request_cache_stats() const { return m_request_cache.get_stats(); }
+    announce_aggregator_stats get_announce_aggregator_stats() const { return m_announce_aggregator.get_stats(); }
 
   private:
     void handle_stakes_update(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_stake_array& stakes);
-    void handle_blockchain_based_list_update(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers);
+    void handle_blockchain_based_list_update(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_tier_array_ptr& tiers);
+    void make_blockchain_based_list_request(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers,
+                                            cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request& request);
+    void make_blockchain_based_list_delta_request(uint64_t block_number, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers,
+                                                  uint64_t prev_block_number, const cryptonote::StakeTransactionProcessor::supernode_tier_array& prev_tiers,
+                                                  cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA::request& request);
+    std::string get_supernode_address_str(const crypto::public_key& supernode_public_id, const cryptonote::account_public_address& address);
 
   private:
-    std::multimap<int, std::string> m_supernode_requests_timestamps;
-    std::set<std::string> m_supernode_requests_cache;
-    std::map<std::string, nodetool::supernode_route> m_supernode_routes;
-    std::unordered_map<std::string, local_supernode> m_supernodes;
+    request_cache m_request_cache {std::chrono::milliseconds(REQUEST_CACHE_TIME)};
+    announce_aggregator m_announce_aggregator;
+    uint32_t m_announce_aggregation_window_ms {0}; //0 - announces are delivered as soon as they are received
+    bool m_supernode_announce_batch {false};
+    supernode_route_map m_supernode_routes;
+    std::shared_ptr<const supernode_route_map> m_supernode_routes_snapshot;
+    std::atomic<bool> m_supernode_routes_changed {true};
+    std::unordered_multimap<peerid_type, boost::uuids::uuid> m_peer_connections; //connections of handshaked peers
+    boost::mutex m_peer_connections_lock;
+    std::unordered_map<std::string, std::unique_ptr<local_supernode>> m_supernodes;
+    local_supernode::options m_supernode_options;
+    bool m_push_blockchain_based_list_delta {false};
+    uint64_t m_pushed_blockchain_based_list_height {0}; //last list pushed to local supernodes, 0 if delta can't be applied
+    uint64_t m_pushed_blockchain_based_list_version {0}; //incremented on each push, supernodes which acknowledged the last version receive delta
+    cryptonote::StakeTransactionProcessor::supernode_tier_array_ptr m_pushed_blockchain_based_list;
+    std::unordered_map<crypto::public_key, std::pair<cryptonote::account_public_address, std::string>> m_supernode_address_cache;
+    boost::mutex m_supernode_address_cache_lock;
     boost::recursive_mutex m_supernode_lock;
-    boost::recursive_mutex m_request_cache_lock;
     std::vector<epee::net_utils::network_address> m_custom_seed_nodes;
 
     std::string m_config_folder;
@@ -68,7 +68,6 @@
 #define MIN_WANTED_SEED_NODES 12
 
 #define MAX_TUNNEL_PEERS (3u)
-#define REQUEST_CACHE_TIME 2 * 60 * 1000
 #define HOP_RETRIES_MULTIPLIER 2
 
 namespace nodetool
@@ -102,6 +101,12 @@ namespace nodetool
     const command_line::arg_descriptor<int64_t> arg_limit_rate = {"limit-rate", "set limit-rate [kB/s]", -1};
 
     const command_line::arg_descriptor<bool> arg_save_graph = {"save-graph", "Save data for dr monero", false};
+    const command_line::arg_descriptor<uint32_t> arg_rta_supernode_queue_size = {"rta-supernode-queue-size", "Max number of RTA messages waiting for delivery to each local supernode", 1000};
+    const command_line::arg_descriptor<uint32_t> arg_rta_supernode_workers = {"rta-supernode-workers", "Number of concurrent connections used for delivery of RTA messages to each local supernode", 1};
+    const command_line::arg_descriptor<std::string> arg_rta_supernode_overflow = {"rta-supernode-overflow", "Policy for full supernode queue: drop-oldest or drop-newest", "drop-oldest"};
+    const command_line::arg_descriptor<bool>        arg_rta_blockchain_based_list_delta = {"rta-blockchain-based-list-delta", "Push blockchain based list changes to local supernodes in binary delta format instead of full list on each block", false};
+    const command_line::arg_descriptor<uint32_t>    arg_rta_announce_aggregation_window = {"rta-announce-aggregation-window", "Time window in milliseconds to coalesce received supernode announces before delivering them in batches, 0 to deliver each announce immediately", 200};
+    const command_line::arg_descriptor<bool>        arg_rta_supernode_announce_batch = {"rta-supernode-announce-batch", "Post aggregated supernode announces to each local supernode in one send_supernode_announces request", false};
     const command_line::arg_descriptor<Uuid> arg_p2p_net_id = {"net-id", "The way to replace hardcoded NETWORK_ID. Effective only with --testnet, ex.: 'net-id = 54686520-4172-7420-6f77-205761722037'"};
 
     // helper struct used to notify peers by uuid
@@ -131,16 +136,6 @@ namespace nodetool
             }
         } while (out.empty());
     }
-    /*!
-     * helper to calculate p2p command size in bytes
-     */
-    template <typename T>
-    size_t get_command_size(const T &arg)
-    {
-        std::string buff;
-        epee::serialization::store_t_to_binary(arg, buff);
-        return buff.size();
-    }
 
   }
 
@@ -165,6 +160,12 @@ namespace nodetool
     command_line::add_arg(desc, arg_limit_rate_down);
     command_line::add_arg(desc, arg_limit_rate);
     command_line::add_arg(desc, arg_save_graph);
+    command_line::add_arg(desc, arg_rta_supernode_queue_size);
+    command_line::add_arg(desc, arg_rta_supernode_workers);
+    command_line::add_arg(desc, arg_rta_supernode_overflow);
+    command_line::add_arg(desc, arg_rta_blockchain_based_list_delta);
+    command_line::add_arg(desc, arg_rta_announce_aggregation_window);
+    command_line::add_arg(desc, arg_rta_supernode_announce_batch);
     command_line::add_arg(desc, arg_p2p_net_id);
   }
   //-----------------------------------------------------------------------------------
@@ -380,6 +381,23 @@ namespace nodetool
       set_save_graph(true);
     }
 
+    m_supernode_options.max_queue_size = command_line::get_arg(vm, arg_rta_supernode_queue_size);
+    m_supernode_options.workers_count = command_line::get_arg(vm, arg_rta_supernode_workers);
+    m_supernode_options.timeout = std::chrono::milliseconds(size_t(SUPERNODE_HTTP_TIMEOUT_MILLIS));
+    const std::string overflow_policy = command_line::get_arg(vm, arg_rta_supernode_overflow);
+    if (overflow_policy == "drop-oldest")
+      m_supernode_options.policy = local_supernode::drop_oldest;
+    else if (overflow_policy == "drop-newest")
+      m_supernode_options.policy = local_supernode::drop_newest;
+    else
+    {
+      MERROR("Invalid value for " << arg_rta_supernode_overflow.name << ": " << overflow_policy);
+      return false;
+    }
+    m_push_blockchain_based_list_delta = command_line::get_arg(vm, arg_rta_blockchain_based_list_delta);
+    m_announce_aggregation_window_ms = command_line::get_arg(vm, arg_rta_announce_aggregation_window);
+    m_supernode_announce_batch = command_line::get_arg(vm, arg_rta_supernode_announce_batch);
+
     if (command_line::has_arg(vm,arg_p2p_add_exclusive_node))
     {
       if (!parse_peers_and_add_to_container(vm, arg_p2p_add_exclusive_node, m_exclusive_peers))
@@ -553,7 +571,7 @@ namespace nodetool
     );
 
     m_payload_handler.get_core().set_update_blockchain_based_list_handler(
-      [&](uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers) { handle_blockchain_based_list_update(block_height, tiers); }
+      [&](uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array_ptr& tiers) { handle_blockchain_based_list_update(block_height, tiers); }
     );
 
     std::set<std::string> full_addrs;
@@ -763,6 +781,8 @@ namespace nodetool
 
     m_net_server.add_idle_handler(boost::bind(&node_server<t_payload_net_handler>::idle_worker, this), 1000);
     m_net_server.add_idle_handler(boost::bind(&t_payload_net_handler::on_idle, &m_payload_handler), 1000);
+    if (m_announce_aggregation_window_ms)
+      m_net_server.add_idle_handler(boost::bind(&node_server<t_payload_net_handler>::flush_supernode_announces, this), m_announce_aggregation_window_ms);
 
     boost::thread::attributes attrs;
     attrs.set_stack_size(THREAD_STACK_SIZE);
@@ -849,6 +869,9 @@ namespace nodetool
   bool node_server<t_payload_net_handler>::notify_peer_list(int command, const std::string& buf, const std::vector<peerlist_entry>& peers_to_send, bool try_connect)
   {
       MDEBUG("P2P Request: notify_peer_list: start notify, total peers: " << peers_to_send.size());
+      if (peers_to_send.empty())
+        return true;
+      const epee::net_utils::shared_buffer frame = epee::levin::make_notify_frame(command, buf);
       for (unsigned i = 0; i < peers_to_send.size(); i++) {
           const peerlist_entry &pe = peers_to_send[i];
           boost::uuids::uuid conn_id;
@@ -860,7 +883,7 @@ namespace nodetool
                        << ", try connect: " << try_connect);
           if (connection_exists) {
               MDEBUG("P2P Request: notify_peer_list: peer is connected, sending to : " << pe.adr.host_str());
-              sent = relay_notify(command, buf, conn_id);
+              sent = relay_notify(frame, conn_id);
               if (!sent)
                 MWARNING("P2P Request: notify_peer_list: peer is connected, sending to : " << pe.adr.host_str() << " FAILED");
           } else if (try_connect) {
@@ -873,7 +896,7 @@ namespace nodetool
                                        m_config.m_net_config.connection_timeout, con, m_bind_ip)) {
                   MDEBUG("P2P Request: notify_peer_list: connected to peer: " << pe.adr.host_str()
                                << ", sending command");
-                  sent = relay_notify(command, buf, con.m_connection_id);
+                  sent = relay_notify(frame, con.m_connection_id);
                   if (!sent)
                     MWARNING("P2P Request: notify_peer_list: peer is connected, sending to : " << pe.adr.host_str() << " FAILED");
               } else {
@@ -893,49 +916,37 @@ namespace nodetool
                    << boost::algorithm::join(addresses, ", "));
       std::vector<peerlist_entry> tunnels;
       {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
-          {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
-          }
-          for (auto addr : addresses)
+          const std::shared_ptr<const supernode_route_map> routes = get_routes_snapshot();
+          std::unordered_set<peerid_type> used_peerids(exclude_peerids.begin(), exclude_peerids.end());
+          for (const std::string &addr : addresses)
           {
               MDEBUG("P2P Request: multicast_send: looking for tunnel for " << addr);
-              auto it = local_supernode_routes.find(addr);
-              if (it == local_supernode_routes.end())
+              auto it = routes->find(addr);
+              if (it == routes->end())
               {
                   MWARNING("no tunnel found for address: " << addr);
                   continue;
               }
               // peers for address
-              std::vector<peerlist_entry> addr_tunnels = (*it).second.peers;
+              const std::vector<peerlist_entry> &addr_tunnels = (*it).second.peers;
               unsigned int count = 0;
               for (auto peer_it = addr_tunnels.begin(); peer_it != addr_tunnels.end(); ++peer_it)
               {
-                  peerlist_entry addr_tunnel = *peer_it;
+                  const peerlist_entry &addr_tunnel = *peer_it;
 
+                  // don't allow duplicate entries and excluded peers
+                  if (used_peerids.count(addr_tunnel.id))
+                    continue;
 
                   // check if peer connected connections
                   boost::uuids::uuid dummy;
                   if (!find_connection_id_by_peer(addr_tunnel, dummy))
                     continue;
 
-                  // don't allow duplicate entries
-                  auto tunnel_it = std::find_if(tunnels.begin(), tunnels.end(),
-                                                [addr_tunnel](const peerlist_entry &entry) -> bool {
-                      return entry.id == addr_tunnel.id;
-                  });
-                  // check if our peer is in excluded peers
-                  auto exclude_it = std::find(exclude_peerids.begin(), exclude_peerids.end(),
-                                              addr_tunnel.id);
-                  if (tunnel_it == tunnels.end() && exclude_it == exclude_peerids.end())
-                  {
-                      MDEBUG("found tunnel for address: " << addr << ":  " << addr_tunnel.adr.str());
-                      tunnels.push_back(addr_tunnel);
-                      count++;
-                  }
+                  MDEBUG("found tunnel for address: " << addr << ":  " << addr_tunnel.adr.str());
+                  used_peerids.insert(addr_tunnel.id);
+                  tunnels.push_back(addr_tunnel);
+                  count++;
                   if (count >= MAX_TUNNEL_PEERS)
                   {
                       break;
@@ -955,17 +966,11 @@ namespace nodetool
   {
       uint64_t max_hop = 0;
       {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
-          {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
-          }
-          for (auto addr : addresses)
+          const std::shared_ptr<const supernode_route_map> routes = get_routes_snapshot();
+          for (const std::string &addr : addresses)
           {
-              auto it = local_supernode_routes.find(addr);
-              if (it != local_supernode_routes.end() && max_hop < (*it).second.max_hop)
+              auto it = routes->find(addr);
+              if (it != routes->end() && max_hop < (*it).second.max_hop)
               {
                   max_hop = (*it).second.max_hop;
               }
@@ -980,14 +985,8 @@ namespace nodetool
   {
       std::list<std::string> routes;
       {
-          std::map<std::string, nodetool::supernode_route> local_supernode_routes;
-          {
-              MDEBUG("P2P Request: multicast_send: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-              MDEBUG("P2P Request: multicast_send: unlock");
-              local_supernode_routes = m_supernode_routes;
-          }
-          for (auto it = local_supernode_routes.begin(); it != local_supernode_routes.end(); ++it)
+          const std::shared_ptr<const supernode_route_map> local_supernode_routes = get_routes_snapshot();
+          for (auto it = local_supernode_routes->begin(); it != local_supernode_routes->end(); ++it)
           {
               routes.push_back((*it).first);
           }
@@ -997,30 +996,49 @@ namespace nodetool
 
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  void node_server<t_payload_net_handler>::remove_old_request_cache()
+  std::shared_ptr<const typename node_server<t_payload_net_handler>::supernode_route_map> node_server<t_payload_net_handler>::get_routes_snapshot()
   {
-      int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-      for (auto it = m_supernode_requests_timestamps.begin(); it != m_supernode_requests_timestamps.end();)
+      if (m_supernode_routes_changed)
       {
-          if ((*it).first + REQUEST_CACHE_TIME < timestamp)
-          {
-              m_supernode_requests_cache.erase((*it).second);
-              it = m_supernode_requests_timestamps.erase(it);
-          }
-          else
+          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+          if (m_supernode_routes_changed)
           {
-              break;
+              std::atomic_store(&m_supernode_routes_snapshot, std::shared_ptr<const supernode_route_map>(std::make_shared<supernode_route_map>(m_supernode_routes)));
+              m_supernode_routes_changed = false;
           }
       }
+      return std::atomic_load(&m_supernode_routes_snapshot);
   }
 
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  int node_server<t_payload_net_handler>::handle_supernode_announce(int command, COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context)
+  int node_server<t_payload_net_handler>::handle_supernode_announce(int command, COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context, const std::string& arg_buff)
   {
       MDEBUG("P2P Request: handle_supernode_announce: start");
 
-      m_announce_bytes_in += get_command_size(arg);
+      m_announce_bytes_in += arg_buff.size();
+
+      if (context.m_state != p2p_connection_context::state_normal) {
+          MWARNING(context << " invalid connection (no handshake)");
+          return 1;
+      }
+
+#ifdef LOCK_RTA_SENDING
+    return 1;
+#endif
+      if (aggregate_supernode_announce(arg, context, &arg_buff) && !m_announce_aggregation_window_ms)
+          flush_supernode_announces();
+
+      MDEBUG("P2P Request: handle_supernode_announce: end");
+      return 1;
+  }
+
+  template<class t_payload_net_handler>
+  int node_server<t_payload_net_handler>::handle_supernode_announce_batch(int command, COMMAND_SUPERNODE_ANNOUNCE_BATCH::request& arg, p2p_connection_context& context, const std::string& arg_buff)
+  {
+      MDEBUG("P2P Request: handle_supernode_announce_batch: " << arg.announces.size() << " announce(s)");
+
+      m_announce_bytes_in += arg_buff.size();
 
       if (context.m_state != p2p_connection_context::state_normal) {
           MWARNING(context << " invalid connection (no handshake)");
@@ -1030,7 +1048,19 @@ namespace nodetool
 #ifdef LOCK_RTA_SENDING
     return 1;
 #endif
-      static std::string supernode_endpoint("send_supernode_announce");
+      bool queued = false;
+      for (COMMAND_SUPERNODE_ANNOUNCE::request &announce : arg.announces)
+          queued |= aggregate_supernode_announce(announce, context, nullptr);
+
+      if (queued && !m_announce_aggregation_window_ms)
+          flush_supernode_announces();
+
+      return 1;
+  }
+
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::aggregate_supernode_announce(COMMAND_SUPERNODE_ANNOUNCE::request& arg, p2p_connection_context& context, const std::string* arg_buff)
+  {
       std::string supernode_str = arg.supernode_public_id;
 
       bool is_local;
@@ -1039,29 +1069,23 @@ namespace nodetool
           is_local = m_supernodes.count(supernode_str) > 0;
       }
       if (!is_local) {
-          MDEBUG("P2P Request: handle_supernode_announce: update tunnels for " << arg.supernode_public_id << " Hop: " << arg.hop << " Address: " << arg.network_address);
+          MDEBUG("P2P Request: aggregate_supernode_announce: update tunnels for " << arg.supernode_public_id << " Hop: " << arg.hop << " Address: " << arg.network_address);
 
           peerlist_entry pe;
           // TODO: Need to investigate it and mechanism for adding peer to the peerlist
           if (!m_peerlist.find_peer(context.peer_id, pe))
           { // unknown peer, alternative handshake with it
               MDEBUG("unknown peer, alternative handshake with it " << context.peer_id);
-              return 1;
+              return false;
           }
-          {
-              MDEBUG("P2P Request: handle_supernode_announce: lock");
-              boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-              MDEBUG("P2P Request: handle_supernode_announce: unlock");
-              remove_old_request_cache();
-          }
-          MDEBUG("P2P Request: handle_supernode_announce: lock");
+          MDEBUG("P2P Request: aggregate_supernode_announce: lock");
           boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-          MDEBUG("P2P Request: handle_supernode_announce: unlock");
+          MDEBUG("P2P Request: aggregate_supernode_announce: unlock");
 
-          MDEBUG("P2P Request: handle_supernode_announce: routes number - " << m_supernode_routes.size());
+          MDEBUG("P2P Request: aggregate_supernode_announce: routes number - " << m_supernode_routes.size());
           for (auto it2 = m_supernode_routes.begin(); it2 != m_supernode_routes.end(); ++it2)
           {
-              MDEBUG("P2P Request: handle_supernode_announce: " << (*it2).first << " " << (*it2).second.peers.size());
+              MDEBUG("P2P Request: aggregate_supernode_announce: " << (*it2).first << " " << (*it2).second.peers.size());
           }
 
 
@@ -1076,6 +1100,7 @@ namespace nodetool
               route.max_hop = arg.hop;
               route.peers = peer_vec;
               m_supernode_routes[supernode_str] = route;
+              m_supernode_routes_changed = true;
           }
           else {
               auto &route = it->second;
@@ -1085,7 +1110,7 @@ namespace nodetool
               {
                   MINFO("SUPERNODE_ANNOUNCE from " << context.peer_id
                         << " too old, corrent route height " << (*it).second.last_announce_height);
-                  return 1;
+                  return false;
               }
 #endif
 
@@ -1098,77 +1123,166 @@ namespace nodetool
                   if (peer_it == route.peers.end())
                   {
                       route.peers.push_back(pe);
+                      m_supernode_routes_changed = true;
                       if (route.max_hop < arg.hop)
                       {
                           route.max_hop = arg.hop;
                       }
                   }
-                  return 1;
+                  return false;
+              }
+              // announce of a new height usually comes through the same peer, so the snapshot is
+              // rebuilt only if the peers or the hops of the route differ
+              if (route.peers.size() != 1 || route.peers.front().id != pe.id || !(route.peers.front().adr == pe.adr)
+                  || route.max_hop != arg.hop)
+              {
+                  route.peers.clear();
+                  route.peers.push_back(pe);
+                  route.max_hop = arg.hop;
+                  m_supernode_routes_changed = true;
               }
-              route.peers.clear();
-              route.peers.push_back(pe);
               route.last_announce_height = arg.height;
               route.last_announce_time = time(nullptr);
-              route.max_hop = arg.hop;
           }
       }
 
-      std::list<std::reference_wrapper<local_supernode>> post_to_sn;
-      {
-          LOG_PRINT_L3("P2P Request: handle_supernode_announce: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-          LOG_PRINT_L3("P2P Request: handle_supernode_announce: unlock");
-          for (auto &sn : m_supernodes) {
-              if (sn.first != supernode_str)
-                  post_to_sn.push_back(std::ref(sn.second));
+      std::string relay_blob;
+      if (!is_local) {
+          // relayed copy is made now, while the received body is available
+          const uint64_t hop = arg.hop + 1;
+          if (!arg_buff || !make_relay_buffer(*arg_buff, hop, relay_blob)) {
+              COMMAND_SUPERNODE_ANNOUNCE::request relayed = arg;
+              relayed.hop = hop;
+              epee::serialization::store_t_to_binary(relayed, relay_blob);
           }
       }
-      for (auto &sn : post_to_sn) {
-          LOG_PRINT_L1("P2P Request: handle_supernode_announce: post to supernode");
-          post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE>(sn, supernode_endpoint, arg);
+
+      return m_announce_aggregator.add(arg, std::move(relay_blob));
+  }
+
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::flush_supernode_announces()
+  {
+      std::vector<announce_aggregator::announce> announces;
+      if (!m_announce_aggregator.take(announces))
+          return true;
+
+      MDEBUG("P2P Request: flush_supernode_announces: " << announces.size() << " announce(s)");
+
+      post_supernode_announces(announces);
+      relay_supernode_announces(announces);
+      return true;
+  }
+
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::post_supernode_announces(const std::vector<announce_aggregator::announce>& announces)
+  {
+      static const std::string supernode_endpoint("send_supernode_announce");
+      static const std::string supernode_batch_endpoint("send_supernode_announces");
+
+      // posting only queues the request, so it's done under the lock
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+      if (m_supernodes.empty())
+          return;
+
+      if (!m_supernode_announce_batch) {
+          // each announce is serialized once for all local supernodes
+          const local_supernode::response_handler handler = make_supernode_response_handler<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE>();
+          for (const announce_aggregator::announce &announce : announces) {
+              std::string uri, body;
+              if (!make_supernode_request<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCE>(supernode_endpoint, announce.request, std::string(), uri, body))
+                  continue;
+              for (auto &sn : m_supernodes) {
+                  if (sn.first != announce.request.supernode_public_id)
+                      sn.second->post(uri, body, handler);
+              }
+          }
+          return;
       }
 
-      if (!is_local) {
-          // Notify neighbours about new ANNOUNCE
-          arg.hop++;
-          MDEBUG("P2P Request: handle_supernode_announce: notify peers " << arg.hop);
+      for (auto &sn : m_supernodes) {
+          cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCES::request request;
+          for (const announce_aggregator::announce &announce : announces) {
+              if (announce.request.supernode_public_id != sn.first)
+                  request.announces.push_back(announce.request);
+          }
+          if (request.announces.empty())
+              continue;
+          LOG_PRINT_L1("P2P Request: post_supernode_announces: post " << request.announces.size() << " announce(s) to supernode " << sn.first);
+          if (post_request_to_supernode<cryptonote::COMMAND_RPC_SUPERNODE_ANNOUNCES>(*sn.second, supernode_batch_endpoint, request))
+              m_announce_aggregator.add_saved_posts(request.announces.size() - 1);
+      }
+  }
 
-          std::list<boost::uuids::uuid> all_connections, random_connections;
-          m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
-          {
-            // skip ourself connections
-            if(cntxt.peer_id == m_config.m_peer_id)
-              return true;
-            all_connections.push_back(cntxt.m_connection_id);
-            return true;
-          });
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::relay_supernode_announces(const std::vector<announce_aggregator::announce>& announces)
+  {
+      std::list<boost::uuids::uuid> all_connections;
+      std::set<boost::uuids::uuid> batch_connections;
+      m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
+      {
+        // skip ourself connections
+        if(cntxt.peer_id == m_config.m_peer_id)
+          return true;
+        all_connections.push_back(cntxt.m_connection_id);
+        if (cntxt.support_flags & P2P_SUPPORT_FLAG_SUPERNODE_ANNOUNCE_BATCH)
+          batch_connections.insert(cntxt.m_connection_id);
+        return true;
+      });
 
+      // each announce still goes to its own random subset of neighbours, announces for the same neighbour are grouped
+      std::map<boost::uuids::uuid, std::vector<const announce_aggregator::announce*>> connection_announces;
+      for (const announce_aggregator::announce &announce : announces) {
+          if (announce.relay_blob.empty())
+              continue;
           if (all_connections.empty()) {
-            MWARNING("P2P Request: no connections to relay announce");
-            return 1;
+              MWARNING("P2P Request: no connections to relay announce");
+              return;
           }
-
+          std::list<boost::uuids::uuid> random_connections;
           select_subset_with_probability(1.0 / all_connections.size(), all_connections, random_connections);
+          for (const boost::uuids::uuid &connection_id : random_connections)
+              connection_announces[connection_id].push_back(&announce);
+      }
 
-          std::string arg_buff;
-          epee::serialization::store_t_to_binary(arg, arg_buff);
+      MDEBUG("P2P Request: relay_supernode_announces: relaying to neighbours: " << connection_announces.size());
 
-          MDEBUG("P2P Request: handle_supernode_announce: relaying to neighbours: " << random_connections.size());
+      for (const auto &item : connection_announces) {
+          const std::list<boost::uuids::uuid> connection(1, item.first);
+          const std::vector<const announce_aggregator::announce*> &relayed = item.second;
 
-          relay_notify_to_list(command, arg_buff, random_connections);
-          m_announce_bytes_out += arg_buff.size() * random_connections.size();
-      }
+          if (relayed.size() > 1 && batch_connections.count(item.first)) {
+              COMMAND_SUPERNODE_ANNOUNCE_BATCH::request request;
+              request.announces.reserve(relayed.size());
+              uint64_t single_bytes = 0;
+              for (const announce_aggregator::announce *announce : relayed) {
+                  request.announces.push_back(announce->request);
+                  ++request.announces.back().hop;
+                  single_bytes += announce->relay_blob.size() + sizeof(epee::levin::bucket_head2);
+              }
+              std::string blob;
+              if (epee::serialization::store_t_to_binary(request, blob)) {
+                  relay_notify_to_list(COMMAND_SUPERNODE_ANNOUNCE_BATCH::ID, blob, connection);
+                  m_announce_bytes_out += blob.size();
+                  const uint64_t batch_bytes = blob.size() + sizeof(epee::levin::bucket_head2);
+                  m_announce_aggregator.add_saved_messages(relayed.size() - 1, single_bytes > batch_bytes ? single_bytes - batch_bytes : 0);
+                  continue;
+              }
+          }
 
-      MDEBUG("P2P Request: handle_supernode_announce: end");
-      return 1;
+          for (const announce_aggregator::announce *announce : relayed) {
+              relay_notify_to_list(COMMAND_SUPERNODE_ANNOUNCE::ID, announce->relay_blob, connection);
+              m_announce_bytes_out += announce->relay_blob.size();
+          }
+      }
   }
 
   template<class t_payload_net_handler>
-  int node_server<t_payload_net_handler>::handle_broadcast(int command, typename COMMAND_BROADCAST::request &arg, p2p_connection_context &context)
+  int node_server<t_payload_net_handler>::handle_broadcast(int command, typename COMMAND_BROADCAST::request &arg, p2p_connection_context &context, const std::string &arg_buff)
   {
       MDEBUG("P2P Request: handle_broadcast: start");
 
-      m_broadcast_bytes_in += get_command_size(arg);
+      m_broadcast_bytes_in += arg_buff.size();
 
       if (context.m_state != p2p_connection_context::state_normal) {
           MWARNING(context << " invalid connection (no handshake)");
@@ -1179,54 +1293,51 @@ namespace nodetool
     return 1;
 #endif
 
+      if (!m_request_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_broadcast: request found in cache, skipping");
+          return 1;
+      }
+
       {
           MDEBUG("P2P Request: handle_broadcast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
+          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
           MDEBUG("P2P Request: handle_broadcast: unlock");
           MDEBUG("P2P Request: handle_broadcast: sender_address: " << arg.sender_address
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
-          {
-              MDEBUG("P2P Request: handle_broadcast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
+          MDEBUG("P2P Request: handle_broadcast: post to supernodes");
 
-              post_request_to_supernodes<cryptonote::COMMAND_RPC_BROADCAST>("broadcast", arg, arg.callback_uri);
+          post_request_to_supernodes<cryptonote::COMMAND_RPC_BROADCAST>("broadcast", arg, arg.callback_uri);
 
-              if (arg.hop > 0)
-              {
-                  MDEBUG("P2P Request: handle_broadcast: notify broadcast from " << arg.sender_address
-                               << " to peers. Hop level: " << arg.hop);
-                  arg.hop--;
-                  std::string buff;
+          if (arg.hop > 0)
+          {
+              MDEBUG("P2P Request: handle_broadcast: notify broadcast from " << arg.sender_address
+                           << " to peers. Hop level: " << arg.hop);
+              arg.hop--;
+              std::string buff;
+              if (!make_relay_buffer(arg_buff, arg.hop, buff))
                   epee::serialization::store_t_to_binary(arg, buff);
 
-                  m_broadcast_bytes_out += buff.size() * get_connections_count();
+              m_broadcast_bytes_out += buff.size() * get_connections_count();
 
-                  relay_notify_to_all(command, buff, context);
-              }
-              else
-              {
-                  MDEBUG("P2P Request: handle_broadcast: hop counter ended for broadcast from "
-                               << arg.sender_address);
-              }
+              relay_notify_to_all(command, buff, context);
+          }
+          else
+          {
+              MDEBUG("P2P Request: handle_broadcast: hop counter ended for broadcast from "
+                           << arg.sender_address);
           }
-          MDEBUG("P2P Request: handle_broadcast: clean request cache");
-          remove_old_request_cache();
       }
       MDEBUG("P2P Request: handle_broadcast: end");
       return 1;
   }
 
   template<class t_payload_net_handler>
-  int node_server<t_payload_net_handler>::handle_multicast(int command, typename COMMAND_MULTICAST::request &arg, p2p_connection_context &context)
+  int node_server<t_payload_net_handler>::handle_multicast(int command, typename COMMAND_MULTICAST::request &arg, p2p_connection_context &context, const std::string &arg_buff)
   {
       MDEBUG("P2P Request: handle_multicast: start");
 
-      m_multicast_bytes_in += get_command_size(arg);
+      m_multicast_bytes_in += arg_buff.size();
 
       if (context.m_state != p2p_connection_context::state_normal) {
           MWARNING(context << " invalid connection (no handshake)");
@@ -1237,51 +1348,43 @@ namespace nodetool
     return 1;
 #endif
 
+      if (!m_request_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_multicast: request found in cache, skipping");
+          return 1;
+      }
+
       std::list<std::string> addresses = arg.receiver_addresses;
       bool forward = false;
       {
           MDEBUG("P2P Request: handle_multicast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
+          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
 
           MDEBUG("P2P Request: handle_multicast: unlock");
           MDEBUG("P2P Request: handle_multicast: sender_address: " << arg.sender_address
                        << ", receiver_addresses: " << boost::algorithm::join(arg.receiver_addresses, ", ")
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
-          {
-              MDEBUG("P2P Request: handle_multicast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
-              for (auto it = addresses.begin(); it != addresses.end(); ) {
-                  auto snit = m_supernodes.find(*it);
-                  if (snit != m_supernodes.end()) {
-                      MDEBUG("P2P Request: handle_multicast: posting to local supernode " << snit->first);
-                      post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(snit->second, "multicast", arg, arg.callback_uri);
-                      it = addresses.erase(it);
-                  } else {
-                      ++it;
-                  }
+          MDEBUG("P2P Request: handle_multicast: post to supernodes");
+          for (auto it = addresses.begin(); it != addresses.end(); ) {
+              auto snit = m_supernodes.find(*it);
+              if (snit != m_supernodes.end()) {
+                  MDEBUG("P2P Request: handle_multicast: posting to local supernode " << snit->first);
+                  post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(*snit->second, "multicast", arg, arg.callback_uri);
+                  it = addresses.erase(it);
+              } else {
+                  ++it;
               }
+          }
 
-              if (arg.hop > 0)
-              {
-                  forward = true;
-              }
-              else
-              {
-                  MDEBUG("P2P Request: handle_multicast: hop counter ended for multicast from "
-                               << arg.sender_address);
-              }
+          if (arg.hop > 0)
+          {
+              forward = true;
           }
           else
           {
-              MDEBUG("P2P Request: handle_multicast: request found in cache, skipping");
+              MDEBUG("P2P Request: handle_multicast: hop counter ended for multicast from "
+                           << arg.sender_address);
           }
-          MDEBUG("P2P Request: handle_multicast: clean request cache");
-          remove_old_request_cache();
       }
       if (forward)
       {
@@ -1292,7 +1395,8 @@ namespace nodetool
           exclude_peers.push_back(context.peer_id);
 
           std::string buff;
-          epee::serialization::store_t_to_binary(arg, buff);
+          if (!make_relay_buffer(arg_buff, arg.hop, buff))
+              epee::serialization::store_t_to_binary(arg, buff);
           multicast_send(command, buff, addresses, exclude_peers);
       }
       MDEBUG("P2P Request: handle_multicast: end");
@@ -1300,10 +1404,10 @@ namespace nodetool
   }
 
   template<class t_payload_net_handler>
-  int node_server<t_payload_net_handler>::handle_unicast(int command, typename COMMAND_UNICAST::request &arg, p2p_connection_context &context)
+  int node_server<t_payload_net_handler>::handle_unicast(int command, typename COMMAND_UNICAST::request &arg, p2p_connection_context &context, const std::string &arg_buff)
   {
       MDEBUG("P2P Request: handle_unicast: start");
-      m_multicast_bytes_in += get_command_size(arg);
+      m_multicast_bytes_in += arg_buff.size();
       if (context.m_state != p2p_connection_context::state_normal) {
           MWARNING(context << " invalid connection (no handshake)");
           return 1;
@@ -1313,45 +1417,37 @@ namespace nodetool
     return 1;
 #endif
 
+      if (!m_request_cache.insert(arg.message_id))
+      {
+          MDEBUG("P2P Request: handle_unicast: request found in cache, skipping");
+          return 1;
+      }
+
       std::string address = arg.receiver_address;
       bool forward = false;
       {
           MDEBUG("P2P Request: handle_unicast: lock");
-          boost::unique_lock<boost::recursive_mutex> cache_guard(m_request_cache_lock, boost::defer_lock),
-              sn_guard(m_supernode_lock, boost::defer_lock);
-          boost::lock(cache_guard, sn_guard);
+          boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
           MDEBUG("P2P Request: handle_unicast: unlock");
           MDEBUG("P2P Request: handle_unicast: sender_address: " << arg.sender_address
                        << ", receiver_address: " << arg.receiver_address
                        << ", our address(es): " << join_supernodes_addresses(", "));
-          if (m_supernode_requests_cache.find(arg.message_id) == m_supernode_requests_cache.end())
+          MDEBUG("P2P Request: handle_unicast: post to supernodes");
+          auto it = m_supernodes.find(address);
+          bool local_sn = it != m_supernodes.end();
+          if (local_sn) {
+              MDEBUG("P2P Request: handle_unicast: sending to local supernode " << address);
+              post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(*it->second, "unicast", arg, arg.callback_uri);
+          }
+          else if (arg.hop > 0)
           {
-              MDEBUG("P2P Request: handle_unicast: post to supernodes");
-              m_supernode_requests_cache.insert(arg.message_id);
-              int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-              m_supernode_requests_timestamps.insert(std::make_pair(timestamp, arg.message_id));
-              auto it = m_supernodes.find(address);
-              bool local_sn = it != m_supernodes.end();
-              if (local_sn) {
-                  MDEBUG("P2P Request: handle_unicast: sending to local supernode " << address);
-                  post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(it->second, "unicast", arg, arg.callback_uri);
-              }
-              else if (arg.hop > 0)
-              {
-                  forward = true;
-              }
-              else
-              {
-                  MDEBUG("P2P Request: handle_unicast: hop counter ended for unicast from "
-                               << arg.sender_address);
-              }
+              forward = true;
           }
           else
           {
-              MDEBUG("P2P Request: handle_unicast: request found in cache, skipping");
+              MDEBUG("P2P Request: handle_unicast: hop counter ended for unicast from "
+                           << arg.sender_address);
           }
-          MDEBUG("P2P Request: handle_unicast: clean request cache");
-          remove_old_request_cache();
       }
 
       if (forward)
@@ -1366,7 +1462,8 @@ namespace nodetool
           exclude_peers.push_back(context.peer_id);
 
           std::string buff;
-          epee::serialization::store_t_to_binary(arg, buff);
+          if (!make_relay_buffer(arg_buff, arg.hop, buff))
+              epee::serialization::store_t_to_binary(arg, buff);
           multicast_send(command, buff, addresses, exclude_peers);
       }
       MDEBUG("P2P Request: handle_unicast: end");
@@ -1419,6 +1516,7 @@ namespace nodetool
         }
 
         pi = context.peer_id = rsp.node_data.peer_id;
+        add_peer_connection(context);
         m_peerlist.set_peer_just_seen(rsp.node_data.peer_id, context.m_remote_address);
 
         if(rsp.node_data.peer_id == m_config.m_peer_id)
@@ -1818,18 +1916,43 @@ namespace nodetool
   {
     bool ret = false;
     MDEBUG("find_connection_id_by_peer: looking for: " << pe.adr.str());
-    m_net_server.get_config_object().foreach_connection([&pe, &ret, &conn_id](p2p_connection_context& cntxt)
     {
-      if (cntxt.peer_id == pe.id) {
-        conn_id = cntxt.m_connection_id;
+      boost::lock_guard<boost::mutex> guard(m_peer_connections_lock);
+      auto it = m_peer_connections.find(pe.id);
+      if (it != m_peer_connections.end()) {
+        conn_id = it->second;
         ret = true;
-        return false; // found connection, stopping foreach_connection loop
       }
-      return true;
-    });
-    MDEBUG("find_connection_id_by_peer: done looking for: " << pe.adr.str() << ", found: " << conn_id);
+    }
+    MDEBUG("find_connection_id_by_peer: done looking for: " << pe.adr.str() << ", found: " << ret);
     return ret;
   }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::add_peer_connection(const p2p_connection_context& context)
+  {
+    boost::lock_guard<boost::mutex> guard(m_peer_connections_lock);
+    auto range = m_peer_connections.equal_range(context.peer_id);
+    for (auto it = range.first; it != range.second; ++it)
+      if (it->second == context.m_connection_id)
+        return;
+    m_peer_connections.emplace(context.peer_id, context.m_connection_id);
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::remove_peer_connection(const p2p_connection_context& context)
+  {
+    boost::lock_guard<boost::mutex> guard(m_peer_connections_lock);
+    auto range = m_peer_connections.equal_range(context.peer_id);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second == context.m_connection_id)
+      {
+        m_peer_connections.erase(it);
+        return;
+      }
+    }
+  }
 
 
   //-----------------------------------------------------------------------------------
@@ -2194,11 +2317,20 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::relay_notify(const epee::net_utils::shared_buffer& frame, const boost::uuids::uuid& connection_id)
+  {
+      return m_net_server.get_config_object().notify(frame, connection_id) >= 0;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, const std::string& data_buff, const std::list<boost::uuids::uuid> &connections)
   {
+    if (connections.empty())
+      return true;
+    const epee::net_utils::shared_buffer frame = epee::levin::make_notify_frame(command, data_buff);
     for(const auto& c_id: connections)
     {
-      m_net_server.get_config_object().notify(command, data_buff, c_id);
+      m_net_server.get_config_object().notify(frame, c_id);
     }
     return true;
   }
@@ -2408,6 +2540,7 @@ namespace nodetool
 
     //associate peer_id with this connection
     context.peer_id = arg.node_data.peer_id;
+    add_peer_connection(context);
     context.m_in_timedsync = false;
 
     if(arg.node_data.peer_id != m_config.m_peer_id && arg.node_data.my_port)
@@ -2599,17 +2732,7 @@ namespace nodetool
       p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(get_routes());
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_broadcast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_broadcast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_broadcast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_request_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_broadcast: prepare peerlist");
 
@@ -2689,7 +2812,7 @@ namespace nodetool
               auto it = m_supernodes.find(addr);
               if (it != m_supernodes.end()) {
                   MDEBUG("P2P Request: do_multicast: multicast to " << addr);
-                  post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(it->second, "multicast", req, req.callback_uri);
+                  post_request_to_supernode<cryptonote::COMMAND_RPC_MULTICAST>(*it->second, "multicast", req, req.callback_uri);
               }
               else {
                   remaining_addresses.push_back(addr);
@@ -2715,17 +2838,7 @@ namespace nodetool
       p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(p2p_req.receiver_addresses);
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_multicast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_multicast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_multicast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_request_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_multicast: multicast send");
       std::string blob;
@@ -2768,7 +2881,7 @@ namespace nodetool
           auto it = m_supernodes.find(addr);
           if (it != m_supernodes.end()) {
               LOG_PRINT_L2("P2P Request: do_unicast: unicast to local supernode " << addr);
-              post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(it->second, "unicast", req, req.callback_uri);
+              post_request_to_supernode<cryptonote::COMMAND_RPC_UNICAST>(*it->second, "unicast", req, req.callback_uri);
               LOG_PRINT_L2("P2P request: do_unicast: End (unicast recipient was local)");
               return;
           }
@@ -2783,17 +2896,7 @@ namespace nodetool
       p2p_req.hop = HOP_RETRIES_MULTIPLIER * get_max_hop(addresses);
       p2p_req.message_id = epee::string_tools::pod_to_hex(message_hash);
 
-      {
-          MDEBUG("P2P Request: do_unicast: lock");
-          boost::lock_guard<boost::recursive_mutex> guard(m_request_cache_lock);
-          MDEBUG("P2P Request: do_unicast: unlock");
-          m_supernode_requests_cache.insert(p2p_req.message_id);
-          int timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-          m_supernode_requests_timestamps.insert(std::make_pair(timestamp, p2p_req.message_id));
-
-          MDEBUG("P2P Request: do_unicast: clean request cache");
-          remove_old_request_cache();
-      }
+      m_request_cache.insert(p2p_req.message_id);
 
       MDEBUG("P2P Request: do_unicast: unicast send");
       std::string blob;
@@ -2804,9 +2907,11 @@ namespace nodetool
 
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  std::vector<cryptonote::route_data> node_server<t_payload_net_handler>::get_tunnels() const
+  std::vector<cryptonote::route_data> node_server<t_payload_net_handler>::get_tunnels()
   {
       std::vector<cryptonote::route_data> tunnels;
+      // announce heights are not tracked by the snapshot, so the live table is read
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
       for (auto it = m_supernode_routes.begin(); it != m_supernode_routes.end(); ++it)
       {
           cryptonote::route_data route;
@@ -2864,6 +2969,8 @@ namespace nodetool
       m_peerlist.remove_from_peer_anchor(na);
     }
 
+    remove_peer_connection(context);
+
     m_payload_handler.on_connection_close(context);
 
     MINFO("["<< epee::net_utils::print_connection_context(context) << "] CLOSE CONNECTION");
@@ -3163,15 +3270,43 @@ namespace nodetool
     }
   }
 
+  template<class t_payload_net_handler>
+  std::string node_server<t_payload_net_handler>::get_supernode_address_str(const crypto::public_key& supernode_public_id, const cryptonote::account_public_address& address)
+  {
+    static const size_t MAX_CACHE_SIZE = 100000;
+
+    boost::lock_guard<boost::mutex> guard(m_supernode_address_cache_lock);
+
+    auto it = m_supernode_address_cache.find(supernode_public_id);
+
+    if (it != m_supernode_address_cache.end() && it->second.first == address)
+      return it->second.second;
+
+    if (it == m_supernode_address_cache.end())
+    {
+      if (m_supernode_address_cache.size() >= MAX_CACHE_SIZE)
+        m_supernode_address_cache.clear();
+
+      it = m_supernode_address_cache.emplace(supernode_public_id, std::make_pair(address, std::string())).first;
+    }
+
+    it->second.first  = address;
+    it->second.second = cryptonote::get_account_address_as_str(m_nettype, false, address);
+
+    return it->second.second;
+  }
+
   template<class t_payload_net_handler>
   void node_server<t_payload_net_handler>::handle_stakes_update(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_stake_array& stakes)
   {
     static std::string supernode_endpoint("send_supernode_stakes");
 
-    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+    {
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
 
-    if (m_supernodes.empty())
-      return;
+      if (m_supernodes.empty())
+        return;
+    }
 
     MDEBUG("handle_stakes_update to supernode for block #" << block_height);
 
@@ -3189,12 +3324,14 @@ namespace nodetool
       dst_stake.tier = src_stake.tier;
       dst_stake.block_height = src_stake.block_height;
       dst_stake.unlock_time = src_stake.unlock_time;
-      dst_stake.supernode_public_id = src_stake.supernode_public_id;
-      dst_stake.supernode_public_address = cryptonote::get_account_address_as_str(m_nettype, false, src_stake.supernode_public_address);
+      dst_stake.supernode_public_id = epee::string_tools::pod_to_hex(src_stake.supernode_public_id);
+      dst_stake.supernode_public_address = get_supernode_address_str(src_stake.supernode_public_id, src_stake.supernode_public_address);
 
       request.stakes.emplace_back(std::move(dst_stake));
     }
 
+    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+
     post_request_to_supernodes<cryptonote::COMMAND_RPC_SUPERNODE_STAKES>(supernode_endpoint, request);
   }
 
@@ -3205,20 +3342,12 @@ namespace nodetool
   }
 
   template<class t_payload_net_handler>
-  void node_server<t_payload_net_handler>::handle_blockchain_based_list_update(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers)
+  void node_server<t_payload_net_handler>::make_blockchain_based_list_request(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers,
+    cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request& request)
   {
-    static std::string supernode_endpoint("blockchain_based_list");
-
-    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
-
-    if (m_supernodes.empty())
-      return;
-
-    MDEBUG("handle_blockchain_based_list_update to supernode for block #" << block_height);
-
-    cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request request;
-
     request.block_height = block_height;
+    request.tiers.clear();
+    request.tiers.reserve(tiers.size());
 
     for (size_t i=0; i<tiers.size(); i++)
     {
@@ -3231,8 +3360,8 @@ namespace nodetool
       {
         cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::supernode dst_supernode;
 
-        dst_supernode.supernode_public_id      = src_supernode.supernode_public_id;
-        dst_supernode.supernode_public_address = cryptonote::get_account_address_as_str(m_nettype, false, src_supernode.supernode_public_address);
+        dst_supernode.supernode_public_id      = epee::string_tools::pod_to_hex(src_supernode.supernode_public_id);
+        dst_supernode.supernode_public_address = get_supernode_address_str(src_supernode.supernode_public_id, src_supernode.supernode_public_address);
         dst_supernode.amount                   = src_supernode.amount;
 
         dst_tier.supernodes.emplace_back(std::move(dst_supernode));
@@ -3240,8 +3369,161 @@ namespace nodetool
 
       request.tiers.emplace_back(std::move(dst_tier));
     }
+  }
+
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::make_blockchain_based_list_delta_request(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& tiers,
+    uint64_t prev_block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array& prev_tiers,
+    cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA::request& request)
+  {
+    request.block_height      = block_height;
+    request.prev_block_height = prev_block_height;
+    request.tiers.clear();
+    request.tiers.reserve(tiers.size());
+
+    for (size_t i=0; i<tiers.size(); i++)
+    {
+      const cryptonote::StakeTransactionProcessor::supernode_tier_array::value_type& src_tier = tiers[i];
+      cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA::tier            dst_tier;
+
+      static const cryptonote::StakeTransactionProcessor::supernode_tier_array::value_type empty_tier;
+      const cryptonote::StakeTransactionProcessor::supernode_tier_array::value_type& prev_tier = i < prev_tiers.size() ? prev_tiers[i] : empty_tier;
+
+      dst_tier.items.reserve(src_tier.size());
+
+        //supernodes kept from the previous list are copied as is, so they are referenced by index
+
+      std::unordered_map<crypto::public_key, size_t> prev_indexes;
+
+      prev_indexes.reserve(prev_tier.size());
+
+      for (size_t prev_index=0; prev_index<prev_tier.size(); prev_index++)
+        prev_indexes.emplace(prev_tier[prev_index].supernode_public_id, prev_index);
+
+      for (const cryptonote::BlockchainBasedList::supernode& src_supernode : src_tier)
+      {
+        auto prev_it = prev_indexes.find(src_supernode.supernode_public_id);
+
+        if (prev_it != prev_indexes.end())
+        {
+          const cryptonote::BlockchainBasedList::supernode& prev_supernode = prev_tier[prev_it->second];
+
+          if (prev_supernode.amount == src_supernode.amount && prev_supernode.supernode_public_address == src_supernode.supernode_public_address)
+          {
+            dst_tier.items.push_back(static_cast<uint32_t>(prev_it->second));
+            continue;
+          }
+        }
+
+        cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA::supernode dst_supernode;
+
+        dst_supernode.supernode_public_id      = epee::string_tools::pod_to_hex(src_supernode.supernode_public_id);
+        dst_supernode.supernode_public_address = get_supernode_address_str(src_supernode.supernode_public_id, src_supernode.supernode_public_address);
+        dst_supernode.amount                   = src_supernode.amount;
+
+        dst_tier.items.push_back(static_cast<uint32_t>(prev_tier.size() + dst_tier.added_supernodes.size()));
+        dst_tier.added_supernodes.emplace_back(std::move(dst_supernode));
+      }
+
+      request.tiers.emplace_back(std::move(dst_tier));
+    }
+  }
+
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::handle_blockchain_based_list_update(uint64_t block_height, const cryptonote::StakeTransactionProcessor::supernode_tier_array_ptr& tiers)
+  {
+    static std::string supernode_endpoint("blockchain_based_list");
+    static std::string supernode_delta_endpoint("/blockchain_based_list_delta");
+
+    uint64_t prev_block_height = 0, prev_version = 0;
+    cryptonote::StakeTransactionProcessor::supernode_tier_array_ptr prev_tiers;
+
+    {
+      boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+
+      if (m_supernodes.empty())
+        return;
+
+        //delta is possible only for the next block after the last pushed list, otherwise (gaps, reorgs, history requests) full list is sent
+
+      if (m_push_blockchain_based_list_delta && m_pushed_blockchain_based_list_height && block_height == m_pushed_blockchain_based_list_height + 1)
+      {
+        prev_block_height = m_pushed_blockchain_based_list_height;
+        prev_version      = m_pushed_blockchain_based_list_version;
+        prev_tiers        = m_pushed_blockchain_based_list;
+      }
+    }
+
+    MDEBUG("handle_blockchain_based_list_update to supernode for block #" << block_height << (prev_block_height ? " (delta)" : ""));
+
+    std::string delta_body;
+
+    if (prev_block_height)
+    {
+      cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA::request request;
+
+      make_blockchain_based_list_delta_request(block_height, *tiers, prev_block_height, *prev_tiers, request);
+
+      if (!epee::serialization::store_t_to_binary(request, delta_body))
+        delta_body.clear();
+    }
+
+      //full list is serialized outside of the lock as well, supernodes which missed the previous list need it
+
+    std::string full_uri, full_body;
+
+    {
+      cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::request request;
+
+      make_blockchain_based_list_request(block_height, *tiers, request);
+
+      if (!make_supernode_request<cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST>(supernode_endpoint, request, std::string(), full_uri, full_body))
+      {
+        MERROR("Failed to serialize blockchain based list for block #" << block_height);
+        return;
+      }
+    }
+
+    boost::lock_guard<boost::recursive_mutex> guard(m_supernode_lock);
+
+    if (!delta_body.empty() && m_pushed_blockchain_based_list_version != prev_version)
+    {
+        //another list has been pushed while delta was prepared
+
+      delta_body.clear();
+    }
+
+    const uint64_t version = ++m_pushed_blockchain_based_list_version;
+
+      //delta is applicable only for supernodes which confirmed to receive the previous list, so lists which are
+      //dropped from the queue, failed or delivered out of order are followed by a full list
+
+    for (auto &sn : m_supernodes)
+    {
+      local_supernode* supernode = sn.second.get();
+      const bool delta = !delta_body.empty() && supernode->acknowledged_list_version() == prev_version;
+
+      const local_supernode::response_handler check = delta
+        ? make_supernode_response_handler<cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA>(true)
+        : make_supernode_response_handler<cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST>();
+
+        //handler is called by the supernode's worker, which is stopped before the supernode is destroyed
+
+      local_supernode::response_handler handler = [supernode, version, check](const std::string& response_body) {
+        if (!check(response_body))
+          return false;
+        supernode->set_acknowledged_list_version(version);
+        return true;
+      };
+
+      if (delta)
+        supernode->post(supernode_delta_endpoint, delta_body, handler, local_supernode::binary_content_type());
+      else
+        supernode->post(full_uri, full_body, handler);
+    }
 
-    post_request_to_supernodes<cryptonote::COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST>(supernode_endpoint, request);
+    m_pushed_blockchain_based_list_height = block_height;
+    m_pushed_blockchain_based_list        = tiers;
   }
 
   template<class t_payload_net_handler>
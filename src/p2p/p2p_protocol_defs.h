@@ -266,6 +266,21 @@ namespace nodetool
       struct response : public cryptonote::COMMAND_RPC_UNICAST::response { };
   };
 
+  // sent only to peers with P2P_SUPPORT_FLAG_SUPERNODE_ANNOUNCE_BATCH
+  struct COMMAND_SUPERNODE_ANNOUNCE_BATCH
+  {
+      const static int ID = P2P_COMMANDS_POOL_BASE + 24;
+
+      struct request
+      {
+          std::vector<COMMAND_SUPERNODE_ANNOUNCE::request> announces;
+
+          BEGIN_KV_SERIALIZE_MAP()
+            KV_SERIALIZE(announces)
+          END_KV_SERIALIZE_MAP()
+      };
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -0,0 +1,216 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "misc_log_ex.h"
+#include "storages/portable_storage.h"
+#include "relay_buffer.h"
+
+namespace nodetool
+{
+  namespace
+  {
+    const size_t MAX_DEPTH = 100;
+    const size_t HEADER_SIZE = 9;
+
+    uint32_t read_uint32(const char* data)
+    {
+      uint32_t value = 0;
+      for (size_t i = 0; i < sizeof(value); ++i)
+        value |= uint32_t(static_cast<uint8_t>(data[i])) << (8 * i);
+      return value;
+    }
+
+    // Minimal reader of portable storage binary format, it only walks over entries to find offsets
+    class blob_reader
+    {
+    public:
+      blob_reader(const std::string& blob) : m_begin(blob.data()), m_ptr(blob.data()), m_end(blob.data() + blob.size()) {}
+
+      size_t offset() const { return m_ptr - m_begin; }
+
+      bool skip(size_t count)
+      {
+        if (size_t(m_end - m_ptr) < count)
+          return false;
+        m_ptr += count;
+        return true;
+      }
+
+      bool read_byte(uint8_t& value)
+      {
+        if (m_ptr == m_end)
+          return false;
+        value = static_cast<uint8_t>(*m_ptr++);
+        return true;
+      }
+
+      bool read_varint(uint64_t& value)
+      {
+        if (m_ptr == m_end)
+          return false;
+        const size_t size = size_t(1) << (static_cast<uint8_t>(*m_ptr) & PORTABLE_RAW_SIZE_MARK_MASK);
+        if (size_t(m_end - m_ptr) < size)
+          return false;
+        value = 0;
+        for (size_t i = 0; i < size; ++i)
+          value |= uint64_t(static_cast<uint8_t>(m_ptr[i])) << (8 * i);
+        value >>= 2;
+        m_ptr += size;
+        return true;
+      }
+
+      bool read_name(std::string& name)
+      {
+        uint8_t size = 0;
+        if (!read_byte(size) || size_t(m_end - m_ptr) < size)
+          return false;
+        name.assign(m_ptr, size);
+        m_ptr += size;
+        return true;
+      }
+
+      bool skip_value(uint8_t type, size_t depth)
+      {
+        if (depth > MAX_DEPTH)
+          return false;
+
+        switch (type)
+        {
+        case SERIALIZE_TYPE_INT64:
+        case SERIALIZE_TYPE_UINT64:
+        case SERIALIZE_TYPE_DUOBLE: return skip(8);
+        case SERIALIZE_TYPE_INT32:
+        case SERIALIZE_TYPE_UINT32: return skip(4);
+        case SERIALIZE_TYPE_INT16:
+        case SERIALIZE_TYPE_UINT16: return skip(2);
+        case SERIALIZE_TYPE_INT8:
+        case SERIALIZE_TYPE_UINT8:
+        case SERIALIZE_TYPE_BOOL:   return skip(1);
+        case SERIALIZE_TYPE_STRING:
+        {
+          uint64_t size = 0;
+          return read_varint(size) && skip(size);
+        }
+        case SERIALIZE_TYPE_OBJECT: return skip_section(depth + 1);
+        case SERIALIZE_TYPE_ARRAY:
+        {
+          uint8_t array_type = 0;
+          return read_byte(array_type) && (array_type & SERIALIZE_FLAG_ARRAY) && skip_array(array_type, depth + 1);
+        }
+        default:
+          return false;
+        }
+      }
+
+      bool skip_array(uint8_t type, size_t depth)
+      {
+        uint64_t count = 0;
+        if (!read_varint(count))
+          return false;
+        type &= ~SERIALIZE_FLAG_ARRAY;
+        while (count--)
+          if (!skip_value(type, depth))
+            return false;
+        return true;
+      }
+
+      bool skip_entry(size_t depth)
+      {
+        uint8_t type = 0;
+        if (!read_byte(type))
+          return false;
+        return type & SERIALIZE_FLAG_ARRAY ? skip_array(type, depth) : skip_value(type, depth);
+      }
+
+      bool skip_section(size_t depth)
+      {
+        uint64_t count = 0;
+        if (!read_varint(count))
+          return false;
+        std::string name;
+        while (count--)
+          if (!read_name(name) || !skip_entry(depth))
+            return false;
+        return true;
+      }
+
+    private:
+      const char* m_begin;
+      const char* m_ptr;
+      const char* m_end;
+    };
+  }
+
+  bool find_uint64_field(const std::string& blob, const std::string& name, size_t& offset)
+  {
+    blob_reader reader(blob);
+
+    // header: signature a (4 bytes), signature b (4 bytes), version (1 byte)
+    if (!reader.skip(HEADER_SIZE))
+      return false;
+    if (read_uint32(blob.data()) != PORTABLE_STORAGE_SIGNATUREA ||
+        read_uint32(blob.data() + 4) != PORTABLE_STORAGE_SIGNATUREB ||
+        static_cast<uint8_t>(blob[8]) != PORTABLE_STORAGE_FORMAT_VER)
+      return false;
+
+    uint64_t count = 0;
+    if (!reader.read_varint(count))
+      return false;
+
+    std::string entry_name;
+    while (count--)
+    {
+      if (!reader.read_name(entry_name))
+        return false;
+      if (entry_name == name)
+      {
+        uint8_t type = 0;
+        if (!reader.read_byte(type) || type != SERIALIZE_TYPE_UINT64)
+          return false;
+        offset = reader.offset();
+        return reader.skip(sizeof(uint64_t));
+      }
+      if (!reader.skip_entry(0))
+        return false;
+    }
+    return false;
+  }
+
+  bool make_relay_buffer(const std::string& received, uint64_t hop, std::string& relay)
+  {
+    size_t offset = 0;
+    if (!find_uint64_field(received, "hop", offset))
+      return false;
+
+    relay = received;
+    for (size_t i = 0; i < sizeof(hop); ++i)
+      relay[offset + i] = static_cast<char>(hop >> (8 * i));
+    return true;
+  }
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace nodetool
+{
+  /*!
+   * \brief find_uint64_field - locates value of a top level uint64 field in a portable storage binary blob
+   * \param blob   - serialized p2p command
+   * \param name   - name of the field
+   * \param offset - offset of the 8-byte little endian value in the blob
+   * \return       - false if the blob is malformed or has no such uint64 field
+   */
+  bool find_uint64_field(const std::string& blob, const std::string& name, size_t& offset);
+
+  /*!
+   * \brief make_relay_buffer - makes a copy of received RTA message with new hop counter
+   *
+   * Integers are stored with fixed width by portable storage, so the received body is forwarded as is with
+   * the hop field patched in place instead of deserializing and serializing the (possibly large) payload again.
+   * \param received - body of received p2p command
+   * \param hop      - hop counter of the relayed message
+   * \param relay    - body of the relayed p2p command
+   * \return         - false if hop field can't be found, the message should be serialized in the usual way then
+   */
+  bool make_relay_buffer(const std::string& received, uint64_t hop, std::string& relay);
+}
@@ -0,0 +1,127 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <cstring>
+
+#include "crypto/crypto.h"
+#include "request_cache.h"
+
+namespace nodetool
+{
+  request_cache::request_cache(std::chrono::milliseconds cache_time)
+    : m_bucket_time_ms(std::max<uint64_t>(1, (cache_time.count() + BUCKETS_COUNT - 2) / (BUCKETS_COUNT - 1)))
+    , m_secret(crypto::rand<crypto::hash>())
+    , m_hits(0)
+    , m_misses(0)
+    , m_evicted(0)
+  {
+    // an id lives for (BUCKETS_COUNT - 1) full buckets at least, i.e. not less than cache_time
+  }
+
+  bool request_cache::insert(const std::string& message_id)
+  {
+    return insert(message_id, std::chrono::steady_clock::now());
+  }
+
+  bool request_cache::insert(const std::string& message_id, std::chrono::steady_clock::time_point now)
+  {
+    const crypto::hash key = make_key(message_id);
+    const uint64_t epoch = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() / m_bucket_time_ms;
+
+    shard& s = m_shards[static_cast<unsigned char>(key.data[sizeof(key.data) - 1]) % SHARDS_COUNT];
+
+    {
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+
+      expire(s, epoch);
+
+      bool found = false;
+      for (const std::unordered_set<crypto::hash>& bucket : s.buckets)
+      {
+        if (bucket.count(key))
+        {
+          found = true;
+          break;
+        }
+      }
+
+      if (!found)
+      {
+        s.buckets[s.epoch % BUCKETS_COUNT].insert(key);
+        ++s.size;
+        ++m_misses;
+        return true;
+      }
+    }
+
+    ++m_hits;
+    return false;
+  }
+
+  crypto::hash request_cache::make_key(const std::string& message_id) const
+  {
+    std::string data(sizeof(m_secret) + message_id.size(), '\0');
+    memcpy(&data[0], &m_secret, sizeof(m_secret));
+    memcpy(&data[sizeof(m_secret)], message_id.data(), message_id.size());
+    return crypto::cn_fast_hash(data.data(), data.size());
+  }
+
+  void request_cache::expire(shard& s, uint64_t epoch)
+  {
+    if (epoch <= s.epoch)
+      return;
+
+    // a slot which becomes current held ids of BUCKETS_COUNT slots ago
+    const uint64_t steps = std::min<uint64_t>(epoch - s.epoch, BUCKETS_COUNT);
+    for (uint64_t i = 1; i <= steps; ++i)
+    {
+      std::unordered_set<crypto::hash>& bucket = s.buckets[(s.epoch + i) % BUCKETS_COUNT];
+      m_evicted += bucket.size();
+      s.size -= bucket.size();
+      bucket.clear();
+    }
+    s.epoch = epoch;
+  }
+
+  request_cache_stats request_cache::get_stats() const
+  {
+    request_cache_stats stats;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.evicted = m_evicted;
+    stats.size = 0;
+    for (const shard& s : m_shards)
+    {
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+      stats.size += s.size;
+    }
+    return stats;
+  }
+}
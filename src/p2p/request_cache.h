@@ -0,0 +1,111 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+#include "crypto/hash.h"
+
+namespace nodetool
+{
+  /*!
+   * \brief request_cache_stats - counters of the RTA message id cache
+   */
+  struct request_cache_stats
+  {
+    uint64_t hits;    ///< messages recognized as already seen
+    uint64_t misses;  ///< messages seen for the first time
+    uint64_t evicted; ///< message ids dropped after expiration
+    uint64_t size;    ///< message ids currently kept
+  };
+
+  /*!
+   * \brief request_cache - set of recently seen RTA message ids used to drop duplicated broadcasts
+   *
+   * Ids are keyed with a random per-process secret and hashed with cn_fast_hash, so peers can neither
+   * craft colliding ids to suppress other messages nor flood a single hash bucket. Hashes are spread
+   * over independently locked shards, so concurrent p2p handlers rarely contend. Each shard keeps a
+   * ring of time buckets; a whole bucket is dropped once it is older than the cache time, so
+   * expiration never scans individual ids.
+   */
+  class request_cache
+  {
+  public:
+    explicit request_cache(std::chrono::milliseconds cache_time);
+
+    request_cache(const request_cache&) = delete;
+    request_cache& operator=(const request_cache&) = delete;
+
+    /*!
+     * \brief insert - remember message id
+     * \param message_id - id of the message
+     * \return           - true if the id has not been seen during the cache time
+     */
+    bool insert(const std::string& message_id);
+    bool insert(const std::string& message_id, std::chrono::steady_clock::time_point now);
+
+    request_cache_stats get_stats() const;
+
+  private:
+    static const size_t SHARDS_COUNT  = 16;
+    static const size_t BUCKETS_COUNT = 4;
+
+    struct shard
+    {
+      mutable boost::mutex mutex;
+      uint64_t epoch; ///< time slot of the newest bucket
+      std::array<std::unordered_set<crypto::hash>, BUCKETS_COUNT> buckets;
+      size_t size;
+
+      shard() : epoch(0), size(0) {}
+    };
+
+    /// Keyed hash of the message id
+    crypto::hash make_key(const std::string& message_id) const;
+
+    /// Drop buckets which are out of the cache time for the current time slot
+    void expire(shard& s, uint64_t epoch);
+
+  private:
+    uint64_t m_bucket_time_ms;
+    crypto::hash m_secret;
+    std::array<shard, SHARDS_COUNT> m_shards;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_evicted;
+  };
+}
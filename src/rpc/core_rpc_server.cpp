@@ -2352,6 +2352,33 @@ namespace cryptonote
       res.broadcast_bytes_out = m_p2p.get_broadcast_bytes_out();
       res.multicast_bytes_in = m_p2p.get_multicast_bytes_in();
       res.multicast_bytes_out = m_p2p.get_multicast_bytes_out();
+      const nodetool::request_cache_stats cache_stats = m_p2p.get_request_cache_stats();
+      res.request_cache_hits = cache_stats.hits;
+      res.request_cache_misses = cache_stats.misses;
+      res.request_cache_evicted = cache_stats.evicted;
+      res.request_cache_size = cache_stats.size;
+      const nodetool::announce_aggregator_stats announce_stats = m_p2p.get_announce_aggregator_stats();
+      res.announces_aggregated = announce_stats.aggregated;
+      res.announces_deduplicated = announce_stats.deduplicated;
+      res.announce_messages_saved = announce_stats.messages_saved;
+      res.announce_bytes_saved = announce_stats.bytes_saved;
+      res.announce_posts_saved = announce_stats.posts_saved;
+      for (const auto &sn : m_p2p.get_supernodes_stats())
+      {
+          COMMAND_RPC_RTA_STATS::supernode_queue queue;
+          queue.address = sn.first;
+          queue.queued = sn.second.queued;
+          queue.sent = sn.second.sent;
+          queue.failed = sn.second.failed;
+          queue.dropped = sn.second.dropped;
+          queue.queue_depth = sn.second.queue_depth;
+          queue.max_queue_depth = sn.second.max_queue_depth;
+          queue.in_flight = sn.second.in_flight;
+          queue.last_latency_ms = sn.second.last_latency_ms;
+          queue.avg_latency_ms = sn.second.avg_latency_ms;
+          queue.max_latency_ms = sn.second.max_latency_ms;
+          res.supernodes.push_back(std::move(queue));
+      }
       return true;
   }
 
@@ -1570,8 +1570,13 @@ namespace cryptonote
     uint64_t histo_98pc;
     std::vector<txpool_histo> histo;
     uint32_t num_double_spends;
+    uint64_t tx_cache_hits;
+    uint64_t tx_cache_misses;
+    uint64_t tx_cache_entries;
+    uint64_t tx_cache_bytes;
+    uint64_t tx_cache_max_bytes;
 
-    txpool_stats(): bytes_total(0), bytes_min(0), bytes_max(0), bytes_med(0), fee_total(0), oldest(0), txs_total(0), num_failing(0), num_10m(0), num_not_relayed(0), histo_98pc(0), num_double_spends(0) {}
+    txpool_stats(): bytes_total(0), bytes_min(0), bytes_max(0), bytes_med(0), fee_total(0), oldest(0), txs_total(0), num_failing(0), num_10m(0), num_not_relayed(0), histo_98pc(0), num_double_spends(0), tx_cache_hits(0), tx_cache_misses(0), tx_cache_entries(0), tx_cache_bytes(0), tx_cache_max_bytes(0) {}
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(bytes_total)
@@ -1587,6 +1592,11 @@ namespace cryptonote
       KV_SERIALIZE(histo_98pc)
       KV_SERIALIZE_CONTAINER_POD_AS_BLOB(histo)
       KV_SERIALIZE(num_double_spends)
+      KV_SERIALIZE_OPT(tx_cache_hits, (uint64_t)0)
+      KV_SERIALIZE_OPT(tx_cache_misses, (uint64_t)0)
+      KV_SERIALIZE_OPT(tx_cache_entries, (uint64_t)0)
+      KV_SERIALIZE_OPT(tx_cache_bytes, (uint64_t)0)
+      KV_SERIALIZE_OPT(tx_cache_max_bytes, (uint64_t)0)
     END_KV_SERIALIZE_MAP()
   };
 
@@ -2358,6 +2368,40 @@ namespace cryptonote
     };
   };
 
+  /*!
+   * Changes of blockchain based list relative to the list of the previous block, pushed to supernodes in binary format.
+   * Each tier of the new list is encoded as a sequence of items: an item below the size of the corresponding tier of
+   * the previous list refers to that list's supernode, otherwise (item - previous tier size) is an index in added_supernodes.
+   */
+  struct COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST_DELTA
+  {
+    typedef COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::supernode supernode;
+
+    struct tier
+    {
+      std::vector<uint32_t> items;
+      std::vector<supernode> added_supernodes;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(items)
+        KV_SERIALIZE(added_supernodes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct request
+    {
+      uint64_t block_height;
+      uint64_t prev_block_height;
+      std::vector<tier> tiers;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(block_height)
+        KV_SERIALIZE(prev_block_height)
+        KV_SERIALIZE(tiers)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    typedef COMMAND_RPC_SUPERNODE_BLOCKCHAIN_BASED_LIST::response response;
+  };
+
   struct COMMAND_RPC_SUPERNODE_ANNOUNCE
   {
     struct request
@@ -2385,6 +2429,20 @@ namespace cryptonote
     };
   };
 
+  struct COMMAND_RPC_SUPERNODE_ANNOUNCES
+  {
+    struct request
+    {
+      std::vector<COMMAND_RPC_SUPERNODE_ANNOUNCE::request> announces;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(announces)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    typedef COMMAND_RPC_SUPERNODE_ANNOUNCE::response response;
+  };
+
   struct COMMAND_RPC_BROADCAST
   {
     struct request
@@ -2524,6 +2582,34 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
 
+    struct supernode_queue
+    {
+      std::string address;
+      uint64_t queued;
+      uint64_t sent;
+      uint64_t failed;
+      uint64_t dropped;
+      uint64_t queue_depth;
+      uint64_t max_queue_depth;
+      uint64_t in_flight;
+      uint64_t last_latency_ms;
+      uint64_t avg_latency_ms;
+      uint64_t max_latency_ms;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(address)
+        KV_SERIALIZE(queued)
+        KV_SERIALIZE(sent)
+        KV_SERIALIZE(failed)
+        KV_SERIALIZE(dropped)
+        KV_SERIALIZE(queue_depth)
+        KV_SERIALIZE(max_queue_depth)
+        KV_SERIALIZE(in_flight)
+        KV_SERIALIZE(last_latency_ms)
+        KV_SERIALIZE(avg_latency_ms)
+        KV_SERIALIZE(max_latency_ms)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response
     {
       uint64_t announce_bytes_in;
@@ -2532,6 +2618,16 @@ namespace cryptonote
       uint64_t broadcast_bytes_out;
       uint64_t multicast_bytes_in;
       uint64_t multicast_bytes_out;
+      uint64_t request_cache_hits;
+      uint64_t request_cache_misses;
+      uint64_t request_cache_evicted;
+      uint64_t request_cache_size;
+      uint64_t announces_aggregated;
+      uint64_t announces_deduplicated;
+      uint64_t announce_messages_saved;
+      uint64_t announce_bytes_saved;
+      uint64_t announce_posts_saved;
+      std::vector<supernode_queue> supernodes;
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(announce_bytes_in)
         KV_SERIALIZE(announce_bytes_out)
@@ -2539,6 +2635,16 @@ namespace cryptonote
         KV_SERIALIZE(broadcast_bytes_out)
         KV_SERIALIZE(multicast_bytes_in)
         KV_SERIALIZE(multicast_bytes_out)
+        KV_SERIALIZE(request_cache_hits)
+        KV_SERIALIZE(request_cache_misses)
+        KV_SERIALIZE(request_cache_evicted)
+        KV_SERIALIZE(request_cache_size)
+        KV_SERIALIZE(announces_aggregated)
+        KV_SERIALIZE(announces_deduplicated)
+        KV_SERIALIZE(announce_messages_saved)
+        KV_SERIALIZE(announce_bytes_saved)
+        KV_SERIALIZE(announce_posts_saved)
+        KV_SERIALIZE(supernodes)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -38,7 +38,7 @@
 namespace supernode {
 	class AuthSample : public BaseRTAProcessor {
 		public:
-
+		const char* Name() const override { return "AuthSample"; }
 
 
 		protected:
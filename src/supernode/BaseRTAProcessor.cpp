@@ -31,11 +31,51 @@
 
 
 static const unsigned s_ObjectLifetime = 20*60*1000;//20 min
+static const unsigned s_RemovedObjectLifetime = 5*60*1000;//5 min
+static const unsigned s_TimerSlot = 1000;
+static const size_t s_TimerSlotsCount = 2048;//~34 min round, objects expire in the first round
+static const unsigned s_TickPeriod = 1000;
+static const unsigned s_StatsLogPeriod = 60*1000;//1 min
+
+supernode::BaseRTAProcessor::BaseRTAProcessor()
+	: m_ObjectTimers(s_TimerSlot, s_TimerSlotsCount)
+	, m_RemovedObjects(s_TimerSlot, s_TimerSlotsCount)
+{}
+
+supernode::BaseRTAProcessor::~BaseRTAProcessor() {
+	BaseRTAProcessor::Stop();
+}
+
+void supernode::BaseRTAProcessor::Start() {
+	if( m_Thread ) return;
+	m_Running = true;
+	m_Thread.reset( new boost::thread(&BaseRTAProcessor::RunTimer, this) );
+}
 
-supernode::BaseRTAProcessor::~BaseRTAProcessor() {}
+void supernode::BaseRTAProcessor::Stop() {
+	if( !m_Thread ) return;
+	m_Running = false;
+	m_Thread->join();
+	m_Thread.reset();
+}
 
-void supernode::BaseRTAProcessor::Start() {}
-void supernode::BaseRTAProcessor::Stop() {}
+void supernode::BaseRTAProcessor::RunTimer() {
+	auto stats_logged_at = boost::posix_time::microsec_clock::universal_time();
+	while(m_Running) {
+		boost::this_thread::sleep_for( boost::chrono::milliseconds(s_TickPeriod) );
+		if(!m_Running) break;
+
+		// objects and idle pooled DAPI clients expire even when no new calls are made
+		Tick();
+		DAPI_RPC_ClientPool::Instance().ExpireIdle();
+
+		auto now = boost::posix_time::microsec_clock::universal_time();
+		if( (now-stats_logged_at).total_milliseconds()<s_StatsLogPeriod ) continue;
+		stats_logged_at = now;
+		RTAObjectsStats stats = GetStats();
+		LOG_PRINT_L1(Name()<<" objects live: "<<stats.Live<<", removed: "<<stats.Removed<<", expired total: "<<stats.Expired);
+	}
+}
 
 void supernode::BaseRTAProcessor::Set(const FSN_ServantBase* ser, DAPI_RPC_Server* dapi) {
 	m_Servant = ser;
@@ -45,8 +85,9 @@ void supernode::BaseRTAProcessor::Set(const FSN_ServantBase* ser, DAPI_RPC_Serve
 
 void supernode::BaseRTAProcessor::Add(boost::shared_ptr<BaseRTAObject> obj) {
 	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		m_Objects.push_back(obj);
+		boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+		m_Objects.emplace(obj->TransactionRecord.PaymentID, obj);
+		m_ObjectTimers.Add(obj, obj->TimeMark + boost::posix_time::milliseconds(s_ObjectLifetime));
 	}
 	Tick();
 }
@@ -56,55 +97,55 @@ void supernode::BaseRTAProcessor::Setup(boost::shared_ptr<BaseRTAObject> obj) {
 }
 
 boost::shared_ptr<supernode::BaseRTAObject> supernode::BaseRTAProcessor::ObjectByPayment(const string& payment_id) {
-	boost::shared_ptr<BaseRTAObject> ret;
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		for(auto& a : m_Objects) if(a->TransactionRecord.PaymentID==payment_id) {
-			ret = a;
-			break;
-		}
-	}
-	return ret;
+	boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+	auto it = m_Objects.find(payment_id);
+	return it!=m_Objects.end() ? it->second : boost::shared_ptr<BaseRTAObject>();
 }
 
 void supernode::BaseRTAProcessor::Remove(boost::shared_ptr<BaseRTAObject> obj) {
 	obj->MarkForDelete();
     LOG_PRINT_L4("Remove: "<<obj->TransactionRecord.PaymentID);
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-		auto it = find(m_Objects.begin(), m_Objects.end(), obj);
-		if( it!=m_Objects.end() ) m_Objects.erase(it);
-
+	boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+	auto range = m_Objects.equal_range(obj->TransactionRecord.PaymentID);
+	for(auto it=range.first;it!=range.second;++it) if( it->second==obj ) {
+		m_Objects.erase(it);
+		break;
 	}
-	{
-		obj->TimeMark = boost::posix_time::second_clock::local_time();
-		boost::lock_guard<boost::recursive_mutex> lock(m_RemoveObjectsGuard);
-		m_RemoveObjects.push_back( obj );
-	}
-
+	obj->TimeMark = boost::posix_time::second_clock::local_time();
+	m_RemovedObjects.Add(obj, obj->TimeMark + boost::posix_time::milliseconds(s_RemovedObjectLifetime));
 }
 
 
 void supernode::BaseRTAProcessor::Tick() {
 	auto now = boost::posix_time::second_clock::local_time();
+	vector< boost::shared_ptr<BaseRTAObject> > vv;
+	vector< boost::shared_ptr<BaseRTAObject> > released;
 	{
-		vector< boost::shared_ptr<BaseRTAObject> > vv;
-		{
-			boost::lock_guard<boost::recursive_mutex> lock(m_ObjectsGuard);
-			for(auto a: m_Objects) if( (now-a->TimeMark).total_milliseconds()>s_ObjectLifetime ) vv.push_back(a);//20 min
-		}
-		for(auto a : vv) Remove(a);
-	}
-	{
-		boost::lock_guard<boost::recursive_mutex> lock(m_RemoveObjectsGuard);
-		for(int i=0;i<int(m_RemoveObjects.size());i++) if( (now-m_RemoveObjects[i]->TimeMark).total_milliseconds()>(5*60*1000) ) {
-			m_RemoveObjects.erase( m_RemoveObjects.begin()+i );
-			i--;
+		boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+		vector< boost::weak_ptr<BaseRTAObject> > due;
+		m_ObjectTimers.Expire(now, due);
+		for(auto& a : due) {
+			boost::shared_ptr<BaseRTAObject> obj = a.lock();
+			if(!obj) continue;
+			auto range = m_Objects.equal_range(obj->TransactionRecord.PaymentID);
+			for(auto it=range.first;it!=range.second;++it) if( it->second==obj ) {
+				vv.push_back(obj);
+				break;
+			}
 		}
+		m_ExpiredCount += vv.size();
+		// objects are destroyed out of the lock
+		m_RemovedObjects.Expire(now, released);
 	}
-
+	for(auto a : vv) Remove(a);
+	if( vv.size() || released.size() ) LOG_PRINT_L2("RTA objects expired: "<<vv.size()<<", released: "<<released.size());
 }
 
-
-
-
+supernode::RTAObjectsStats supernode::BaseRTAProcessor::GetStats() const {
+	boost::lock_guard<boost::mutex> lock(m_ObjectsGuard);
+	RTAObjectsStats stats;
+	stats.Live = m_Objects.size();
+	stats.Removed = m_RemovedObjects.Size();
+	stats.Expired = m_ExpiredCount;
+	return stats;
+}
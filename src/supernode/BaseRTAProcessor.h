@@ -31,19 +31,37 @@
 #define BASE_RTA_PROCESSOR_H_
 
 #include "BaseRTAObject.h"
+#include "TimerWheel.h"
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 
 namespace supernode {
 
+	struct RTAObjectsStats {
+		uint64_t Live = 0;// objects in processing
+		uint64_t Removed = 0;// removed objects kept alive for calls in flight
+		uint64_t Expired = 0;// objects removed because of lifetime, total
+	};
+
 	class BaseRTAProcessor {
 		public:
+		BaseRTAProcessor();
 		virtual ~BaseRTAProcessor();
 
+		// Start runs a thread which calls Tick periodically and logs GetStats, Stop must be called before destruction
 		virtual void Start();
 		virtual void Stop();
 
 		void Set(const FSN_ServantBase* ser, DAPI_RPC_Server* dapi);
 		virtual void Tick();
 
+		RTAObjectsStats GetStats() const;
+		// name of the processor in the log
+		virtual const char* Name() const { return "RTA processor"; }
+
 		protected:
 		void Add(boost::shared_ptr<BaseRTAObject> obj);
 		void Remove(boost::shared_ptr<BaseRTAObject> obj);
@@ -51,19 +69,22 @@ namespace supernode {
 		boost::shared_ptr<BaseRTAObject> ObjectByPayment(const string& payment_id);
 
         virtual void Init() = 0;
+		void RunTimer();
 
 		protected:
 		const FSN_ServantBase* m_Servant = nullptr;
 		DAPI_RPC_Server* m_DAPIServer = nullptr;
-		mutable boost::recursive_mutex m_ObjectsGuard;
-		vector< boost::shared_ptr<BaseRTAObject> > m_Objects;
-
-		mutable boost::recursive_mutex m_RemoveObjectsGuard;
-		vector< boost::shared_ptr<BaseRTAObject> > m_RemoveObjects;
+		mutable boost::mutex m_ObjectsGuard;
+		// live objects by payment id
+		std::unordered_multimap< string, boost::shared_ptr<BaseRTAObject> > m_Objects;
+		// lifetime of live objects, an object removed earlier is skipped at expiration
+		TimerWheel< boost::weak_ptr<BaseRTAObject> > m_ObjectTimers;
+		// removed objects are kept alive for a while because of calls which may still be in flight
+		TimerWheel< boost::shared_ptr<BaseRTAObject> > m_RemovedObjects;
+		uint64_t m_ExpiredCount = 0;
 
-//		mutable boost::mutex m_DeleteGuard;
-//		map< boost::posix_time::ptime, boost::shared_ptr<BaseRTAObject> > m_ForDelete;
-		// boost::posix_time::second_clock::local_time()
+		std::atomic<bool> m_Running{false};
+		std::unique_ptr<boost::thread> m_Thread;
 
 	};
 
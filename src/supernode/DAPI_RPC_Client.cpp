@@ -28,6 +28,7 @@
 //
 
 #include "DAPI_RPC_Client.h"
+#include <algorithm>
 
 
 void supernode::DAPI_RPC_Client::Set(string ip, string port) {
@@ -36,3 +37,53 @@ void supernode::DAPI_RPC_Client::Set(string ip, string port) {
 	boost::optional<epee::net_utils::http::login> http_login{};
 	set_server(ss, http_login);
 }
+
+supernode::DAPI_RPC_ClientPool& supernode::DAPI_RPC_ClientPool::Instance() {
+	static DAPI_RPC_ClientPool pool;
+	return pool;
+}
+
+supernode::DAPI_RPC_ClientPool::client_ptr supernode::DAPI_RPC_ClientPool::Acquire(const string& ip, const string& port) {
+	{
+		boost::lock_guard<boost::mutex> lock(m_Guard);
+		ExpireIdleLocked( Clock::now() );
+		auto it = m_Idle.find( Key(ip, port) );
+		if( it!=m_Idle.end() && !it->second.empty() ) {
+			client_ptr client = it->second.back().Client;
+			it->second.pop_back();
+			return client;
+		}
+	}
+	client_ptr client = std::make_shared<DAPI_RPC_Client>();
+	client->Set(ip, port);
+	return client;
+}
+
+void supernode::DAPI_RPC_ClientPool::Release(const string& ip, const string& port, client_ptr client) {
+	if( !client->WasConnected || !client->is_connected() ) return;
+	const Clock::time_point now = Clock::now();
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	ExpireIdleLocked(now);
+	vector<SIdleClient>& idle = m_Idle[ Key(ip, port) ];
+	if( idle.size()<MaxIdlePerMember ) idle.push_back( SIdleClient{client, now} );
+}
+
+void supernode::DAPI_RPC_ClientPool::ExpireIdle() {
+	boost::lock_guard<boost::mutex> lock(m_Guard);
+	ExpireIdleLocked( Clock::now() );
+}
+
+void supernode::DAPI_RPC_ClientPool::ExpireIdleLocked(Clock::time_point now) {
+	// a sweep over all members at most once per second
+	if( now-m_LastExpired<std::chrono::seconds(1) ) return;
+	m_LastExpired = now;
+
+	const Clock::time_point expired = now-IdleTimeout;
+	for(auto it=m_Idle.begin();it!=m_Idle.end();) {
+		vector<SIdleClient>& idle = it->second;
+		auto alive = std::find_if(idle.begin(), idle.end(), [expired](const SIdleClient& c) { return c.Since>expired; });
+		idle.erase(idle.begin(), alive);
+		if( idle.empty() ) it = m_Idle.erase(it);
+		else ++it;
+	}
+}
@@ -35,7 +35,12 @@
 #include "storages/portable_storage_template_helper.h"
 #include "storages/portable_storage.h"
 #include "supernode_rpc_command.h"
+#include <boost/thread/mutex.hpp>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 using namespace std;
 
 
@@ -99,6 +104,52 @@ namespace supernode {
 
 	};
 
+	// Idle clients per supernode, so calls to the same supernode reuse kept-alive connections
+	// instead of connecting for every call. Shared by all broadcasts of the process.
+	// Clients idle for longer than IdleTimeout are closed, members of finished auth samples
+	// don't keep connections.
+	class DAPI_RPC_ClientPool {
+		public:
+		typedef std::shared_ptr<DAPI_RPC_Client> client_ptr;
+
+		static DAPI_RPC_ClientPool& Instance();
+
+		// idle client for the supernode or a new one, clients are used by one call at a time
+		client_ptr Acquire(const string& ip, const string& port);
+		// return client to the pool, the client is dropped if it was not connected
+		void Release(const string& ip, const string& port, client_ptr client);
+		// close clients idle for longer than IdleTimeout, done at most once per second, also by Acquire and Release
+		void ExpireIdle();
+
+		template<class t_request, class t_response>
+		bool Invoke(const string& ip, const string& port, const string& call, const t_request& out_struct, t_response& result_struct, std::chrono::milliseconds timeout, bool& wasConnected) {
+			client_ptr client = Acquire(ip, port);
+			bool ret = client->Invoke(call, out_struct, result_struct, timeout);
+			wasConnected = client->WasConnected;
+			Release(ip, port, client);
+			return ret;
+		}
+
+		unsigned MaxIdlePerMember = 8;
+		std::chrono::milliseconds IdleTimeout = std::chrono::seconds(30);
+
+		private:
+		typedef std::chrono::steady_clock Clock;
+
+		struct SIdleClient {
+			client_ptr Client;
+			Clock::time_point Since;
+		};
+
+		static string Key(const string& ip, const string& port) { return ip + ":" + port; }
+		void ExpireIdleLocked(Clock::time_point now);
+
+		private:
+		boost::mutex m_Guard;
+		std::unordered_map< string, vector<SIdleClient> > m_Idle;// least recently released first
+		Clock::time_point m_LastExpired;
+	};
+
 
 }
 
@@ -64,69 +64,56 @@ bool supernode::DAPI_RPC_Server::HandleRequest(const epee::net_utils::http::http
         }
         return false;
     }
-    uint64_t ticks = epee::misc_utils::get_tick_count();
     epee::serialization::portable_storage ps;
+    SRequestEnvelope envelope;
+    string error;
 
-//    epee::json_rpc::error_response rsp;
-    string version;
-    std::string callback_name;
-    epee::serialization::storage_entry id_ = epee::serialization::storage_entry(std::string());
-
-    if( !ps.load_from_json(query_info.m_body) ) {
-        LOG_ERROR("!load_from_json");
-		response_info.m_response_code = 500;
-		response_info.m_response_comment = "Parse error";
-    } else if( !ps.get_value("dapi_version", version, nullptr) ) {
-    	response_info.m_response_code = 500;
-    	response_info.m_response_comment = "No DAPI version";
-    } else if( !ps.get_value("method", callback_name, nullptr) ) {
+    if( !ParseRequest(query_info.m_body, ps, envelope, error) ) {
     	response_info.m_response_code = 500;
-    	response_info.m_response_comment = "No method";
-    } else if( version!=rpc_command::DAPI_VERSION ) {
-    	response_info.m_response_code = 500;
-    	response_info.m_response_comment = "Wrong DAPI version";
-    }
-
-    if( response_info.m_response_code!=200 ) {
-    	//epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body);
+    	response_info.m_response_comment = error;
         LOG_PRINT_L0( "Error: "<<response_info.m_response_comment );
     	return true;
     }
 
-    ps.get_value("id", id_, nullptr);
-
-    std::string payment_id;
-    {
-    	epee::json_rpc::request<SubNetData> resp;
-    	if( resp.load(ps) ) payment_id = resp.params.PaymentID;
-    }
-
-
-
-    SCallHandler* handler = nullptr;
-
-    {
-    	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
-    	for(unsigned i=0;i<m_vHandlers.size();i++) {
-    		SHandlerData& hh = m_vHandlers[i];
-
-    		if(hh.Name!=callback_name) continue;
-    		if(hh.PaymentID.size() &&  hh.PaymentID!=payment_id) continue;
-
-    		handler = hh.Handler;
-    		break;
-    	}
-    }
+    const string& callback_name = envelope.Method;
+    std::shared_ptr<SCallHandler> handler = FindHandler(callback_name, envelope.PaymentID);
     LOG_PRINT_L2(response_info.m_body);
 
     if(!handler) { LOG_ERROR("handler not found for: "<<callback_name); return false; }
-    if( !handler->Process(ps, response_info.m_body) ) { LOG_ERROR("Fail to process (ret false): "<<callback_name); return false; }
+    if( !handler->Process(ps, envelope, response_info.m_body) ) { LOG_ERROR("Fail to process (ret false): "<<callback_name); return false; }
 
     response_info.m_mime_tipe = "application/json";
     response_info.m_header_info.m_content_type = " application/json";
     return true;
 }
 
+bool supernode::DAPI_RPC_Server::ParseRequest(const string& body, epee::serialization::portable_storage& ps, SRequestEnvelope& envelope, string& error) {
+    if( !ps.load_from_json(body) ) {
+        LOG_ERROR("!load_from_json");
+        error = "Parse error";
+        return false;
+    }
+    if( !ps.get_value("dapi_version", envelope.Version, nullptr) ) {
+        error = "No DAPI version";
+        return false;
+    }
+    if( !ps.get_value("method", envelope.Method, nullptr) ) {
+        error = "No method";
+        return false;
+    }
+    if( envelope.Version!=rpc_command::DAPI_VERSION ) {
+        error = "Wrong DAPI version";
+        return false;
+    }
+
+    ps.get_value("id", envelope.Id, nullptr);
+
+    // payment id of SubNetData based params, empty for global methods
+    envelope.Params = ps.open_section("params", nullptr);
+    if(envelope.Params) ps.get_value("PaymentID", envelope.PaymentID, envelope.Params);
+    return true;
+}
+
 const string& supernode::DAPI_RPC_Server::IP() const { return m_IP; }
 const string& supernode::DAPI_RPC_Server::Port() const { return m_Port; }
 
@@ -147,20 +134,68 @@ void supernode::DAPI_RPC_Server::Start() { run(m_NumThreads); }
 
 void supernode::DAPI_RPC_Server::Stop() { send_stop_signal(); }
 
+string supernode::DAPI_RPC_Server::HandlerKey(const string& method, const string& payment_id) {
+	string key;
+	key.reserve(method.size() + 1 + payment_id.size());
+	key += method;
+	key += '\0';
+	key += payment_id;
+	return key;
+}
+
+size_t supernode::DAPI_RPC_Server::HandlerShard(const string& key) {
+	return std::hash<string>()(key) % HANDLER_SHARDS;
+}
+
+std::shared_ptr<supernode::DAPI_RPC_Server::SCallHandler> supernode::DAPI_RPC_Server::FindHandler(const string& method, const string& payment_id) const {
+	for(int pass=0;pass<2;pass++) {
+		if( pass==0 && payment_id.empty() ) continue;
+		const string key = HandlerKey(method, pass==0 ? payment_id : string());
+		std::shared_ptr<const handler_map> shard = std::atomic_load(&m_HandlerShards[HandlerShard(key)]);
+		if(!shard) continue;
+		auto it = shard->find(key);
+		if( it!=shard->end() ) return it->second.front().Handler;
+	}
+	return nullptr;
+}
+
 int supernode::DAPI_RPC_Server::AddHandlerData(const SHandlerData& h) {
-	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
+	boost::lock_guard<boost::mutex> lock(m_Handlers_Guard);
 	int idx = m_HandlerIdx;
 	m_HandlerIdx++;
-	m_vHandlers.push_back(h);
-	m_vHandlers.rbegin()->Idx = idx;
+
+	const string key = HandlerKey(h.Name, h.PaymentID);
+	std::shared_ptr<const handler_map>& shard = m_HandlerShards[HandlerShard(key)];
+	std::shared_ptr<const handler_map> current = std::atomic_load(&shard);
+	std::shared_ptr<handler_map> updated = current ? std::make_shared<handler_map>(*current) : std::make_shared<handler_map>();
+	handler_list& handlers = (*updated)[key];
+	handlers.push_back(h);
+	handlers.back().Idx = idx;
+	std::atomic_store(&shard, std::shared_ptr<const handler_map>(std::move(updated)));
+
+	m_HandlerKeys[idx] = key;
 	return idx;
 }
 
 void supernode::DAPI_RPC_Server::RemoveHandler(int idx) {
-	boost::lock_guard<boost::recursive_mutex> lock(m_Handlers_Guard);
-	for(unsigned i=0;i<m_vHandlers.size();i++) if( m_vHandlers[i].Idx==idx ) {
-		m_vHandlers.erase( m_vHandlers.begin()+i );
+	boost::lock_guard<boost::mutex> lock(m_Handlers_Guard);
+	auto key_it = m_HandlerKeys.find(idx);
+	if( key_it==m_HandlerKeys.end() ) return;
+	const string key = key_it->second;
+	m_HandlerKeys.erase(key_it);
+
+	std::shared_ptr<const handler_map>& shard = m_HandlerShards[HandlerShard(key)];
+	std::shared_ptr<const handler_map> current = std::atomic_load(&shard);
+	if(!current) return;
+	std::shared_ptr<handler_map> updated = std::make_shared<handler_map>(*current);
+	auto it = updated->find(key);
+	if( it==updated->end() ) return;
+	handler_list& handlers = it->second;
+	for(unsigned i=0;i<handlers.size();i++) if( handlers[i].Idx==idx ) {
+		handlers.erase( handlers.begin()+i );
 		break;
 	}
+	if( handlers.empty() ) updated->erase(it);
+	std::atomic_store(&shard, std::shared_ptr<const handler_map>(std::move(updated)));
 }
 
@@ -37,7 +37,10 @@
 #include <boost/program_options/variables_map.hpp>
 #include "net/http_server_impl_base.h"
 #include "FSN_Servant.h"
+#include <array>
+#include <memory>
 #include <string>
+#include <unordered_map>
 using namespace std;
 
 namespace supernode {
@@ -56,26 +59,37 @@ namespace supernode {
         void setServant(FSN_Servant *servant);
 
 		protected:
+		// fields of DAPI request envelope, extracted from the request parsed once
+		struct SRequestEnvelope {
+			string Version;
+			string Method;
+			epee::serialization::storage_entry Id = epee::serialization::storage_entry(std::string());
+			epee::serialization::portable_storage::hsection Params = nullptr;
+			string PaymentID;
+		};
+
 		class SCallHandler {
 			public:
-			virtual bool Process(epee::serialization::portable_storage& in, string& out_js)=0;
+			virtual ~SCallHandler() {}
+			virtual bool Process(epee::serialization::portable_storage& in, const SRequestEnvelope& envelope, string& out_js)=0;
 		};
 		template<class IN_t, class OUT_t>
 		class STemplateHandler : public SCallHandler {
 			public:
 			STemplateHandler( boost::function<bool (const IN_t&, OUT_t&)>& handler) : Handler(handler) {}
 
-			bool Process(epee::serialization::portable_storage& ps, string& out_js) {
-				  boost::value_initialized<epee::json_rpc::request<IN_t> > req_;
-				  epee::json_rpc::request<IN_t>& req = static_cast<epee::json_rpc::request<IN_t>&>(req_);
-				  if( !req.load(ps) ) return false;
+			bool Process(epee::serialization::portable_storage& ps, const SRequestEnvelope& envelope, string& out_js) {
+				  // params are loaded directly from the parsed request, envelope fields are already known
+				  boost::value_initialized<IN_t> params_;
+				  IN_t& params = static_cast<IN_t&>(params_);
+				  if( envelope.Params && !params.load(ps, envelope.Params) ) return false;
 
 				  boost::value_initialized<epee::json_rpc::response<OUT_t, epee::json_rpc::dummy_error> > resp_;
 				  epee::json_rpc::response<OUT_t, epee::json_rpc::dummy_error>& resp =  static_cast<epee::json_rpc::response<OUT_t, epee::json_rpc::dummy_error> &>(resp_);
 				  resp.jsonrpc = "2.0";
-				  resp.id = req.id;
+				  resp.id = envelope.Id;
 
-				  if( !Handler(req.params, resp.result) ) return false;
+				  if( !Handler(params, resp.result) ) return false;
 
 				  epee::serialization::store_t_to_json(resp, out_js);
 				  return true;
@@ -85,18 +99,25 @@ namespace supernode {
 		};
 
 		struct SHandlerData {
-			SCallHandler* Handler = nullptr;
+			std::shared_ptr<SCallHandler> Handler;
 			string Name;
 			int Idx = -1;
 			string PaymentID;
 		};
 
+		// handlers registered for the same (method, payment id), the first one is used
+		typedef vector<SHandlerData> handler_list;
+		// (method, payment id) key -> handlers, immutable once published
+		typedef std::unordered_map<string, handler_list> handler_map;
+		// number of independently updated handler maps, keeps copy-on-write cheap with many payments
+		static const size_t HANDLER_SHARDS = 64;
+
 
 		public:
 		template<class IN_t, class OUT_t>
 		int AddHandler( const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
 			SHandlerData hh;
-			hh.Handler = new STemplateHandler<IN_t, OUT_t>(handler);
+			hh.Handler = std::make_shared<STemplateHandler<IN_t, OUT_t>>(handler);
 			hh.Name = method;
 			return AddHandlerData(hh);
 		}
@@ -108,7 +129,7 @@ namespace supernode {
 		template<class IN_t, class OUT_t>
 		int Add_UUID_MethodHandler( string paymentid, const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
 			SHandlerData hh;
-			hh.Handler = new STemplateHandler<IN_t, OUT_t>(handler);
+			hh.Handler = std::make_shared<STemplateHandler<IN_t, OUT_t>>(handler);
 			hh.Name = method;
 			hh.PaymentID = paymentid;
 			return AddHandlerData(hh);
@@ -122,11 +143,19 @@ namespace supernode {
 		protected:
 		bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context) override;
 		bool HandleRequest(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, connection_context& m_conn_context);
+		// parse request body once and extract envelope fields, returns error comment on failure
+		static bool ParseRequest(const string& body, epee::serialization::portable_storage& ps, SRequestEnvelope& envelope, string& error);
 		int AddHandlerData(const SHandlerData& h);
+		// handler for method and payment id, falls back to the handler registered for any payment id
+		std::shared_ptr<SCallHandler> FindHandler(const string& method, const string& payment_id) const;
+		static string HandlerKey(const string& method, const string& payment_id);
+		static size_t HandlerShard(const string& key);
 
 		protected:
-		boost::recursive_mutex m_Handlers_Guard;
-		vector<SHandlerData> m_vHandlers;
+		// readers take a snapshot of a shard without locking, writers replace it under m_Handlers_Guard
+		std::array<std::shared_ptr<const handler_map>, HANDLER_SHARDS> m_HandlerShards;
+		boost::mutex m_Handlers_Guard;
+		std::unordered_map<int, string> m_HandlerKeys;
 		int m_HandlerIdx = 0;
 
 		protected:
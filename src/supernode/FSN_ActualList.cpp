@@ -122,7 +122,7 @@ void FSN_ActualList::DoAudit() {
 	}
 
 	for(unsigned i=0;i<all.size() && m_Running;i++) {
-		if( CheckIsFSN(all[i]) ) continue;
+		if( CheckIsFSN(all[i])!=FSN_Not ) continue;// keep the ones with the stake balance not known yet
 		auto data = m_Servant->FSN_DataByStakeAddr( all[i]->Stake.Addr );
 		if( !data ) continue;// was deleted
 
@@ -136,7 +136,7 @@ void FSN_ActualList::DoAudit() {
 
 void FSN_ActualList::CheckIfIamFSN(bool checkOnly) {
 	boost::shared_ptr<FSN_Data> data = boost::shared_ptr<FSN_Data>( new FSN_Data(m_Servant->GetMyStakeWallet(), m_Servant->GetMyMinerWallet(), m_DAPIServer->IP(), m_DAPIServer->Port()) );
-	if( !CheckIsFSN(data) ) return;
+	if( CheckIsFSN(data)!=FSN_Is ) return;
 
 	if(checkOnly) return;
 
@@ -178,7 +178,7 @@ void FSN_ActualList::OnAddFSNFromWorker(const rpc_command::BROADCACT_ADD_FULL_SU
 		data = _OnAddFSN(in);
 	}
 
-	if( data && CheckIsFSN(data) ) m_Servant->AddFsnAccount(data);// VERY SLOW!!!
+	if( data && CheckIsFSN(data)==FSN_Is ) m_Servant->AddFsnAccount(data);
 }
 
 void FSN_ActualList::OnLostFSNStatus(const rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE& in) {
@@ -190,7 +190,7 @@ void FSN_ActualList::OnLostFSNStatus(const rpc_command::BROADCACT_LOST_STATUS_FU
 void FSN_ActualList::OnLostFSNStatusFromWorker(const rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE& in) {
 	boost::shared_ptr<FSN_Data> data = m_Servant->FSN_DataByStakeAddr(in.StakeAddr);
 	if(!data) return;
-	if( CheckIsFSN(data) ) return;
+	if( CheckIsFSN(data)!=FSN_Not ) return;
 	m_Servant->RemoveFsnAccount(data);
 }
 
@@ -207,13 +207,14 @@ bool FSN_ActualList::CheckWalletOwner(boost::shared_ptr<FSN_Data> data, const st
 
 }
 
-bool FSN_ActualList::CheckIsFSN(boost::shared_ptr<FSN_Data> data) {
-	if( !CheckWalletOwner(data, data->Stake.Addr) ) return false;
-	if( !CheckWalletOwner(data, data->Miner.Addr) ) return false;
+FSN_ActualList::EFSNStatus FSN_ActualList::CheckIsFSN(boost::shared_ptr<FSN_Data> data) {
+	if( !CheckWalletOwner(data, data->Stake.Addr) ) return FSN_Not;
+	if( !CheckWalletOwner(data, data->Miner.Addr) ) return FSN_Not;
 
 
-	uint64_t bal = m_Servant->GetWalletBalance( m_Servant->GetCurrentBlockHeight(), data->Stake );
-    return bal > s_MinStakeBalance;
+	uint64_t bal = 0;
+	if( !m_Servant->GetWalletBalance( m_Servant->GetCurrentBlockHeight(), data->Stake, bal ) ) return FSN_Unknown;
+    return bal > s_MinStakeBalance ? FSN_Is : FSN_Not;
 }
 
 bool FSN_ActualList::FSN_CheckWalletOwnership(const rpc_command::FSN_CHECK_WALLET_OWNERSHIP::request& in, rpc_command::FSN_CHECK_WALLET_OWNERSHIP::response& out) {
@@ -56,8 +56,11 @@ public:
 	void OnLostFSNStatusFromWorker(const rpc_command::BROADCACT_LOST_STATUS_FULL_SUPER_NODE& in);
 
 protected:
+	// FSN status can't be decided until the stake account is scanned up to the current height
+	enum EFSNStatus { FSN_Not, FSN_Is, FSN_Unknown };
+
 	string GenStrForSign(const string& dapiIP, const string& dapiPort, const string& walletAddr);
-	bool CheckIsFSN(boost::shared_ptr<FSN_Data> data);
+	EFSNStatus CheckIsFSN(boost::shared_ptr<FSN_Data> data);
 	bool CheckWalletOwner(boost::shared_ptr<FSN_Data> data, const string& wa);
 	boost::shared_ptr<FSN_Data> _OnAddFSN(const rpc_command::BROADCACT_ADD_FULL_SUPER_NODE& in );
 	void Run();
@@ -0,0 +1,525 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "FSN_OutputScanner.h"
+#include <cryptonote_basic/cryptonote_basic_impl.h>
+#include <cryptonote_basic/cryptonote_format_utils.h>
+#include <cryptonote_config.h>
+#include <device/device.hpp>
+#include <ringct/rctSigs.h>
+#include <rpc/core_rpc_server_commands_defs.h>
+#include <serialization/keyvalue_serialization.h>
+#include <storages/http_abstract_invoke.h>
+#include <storages/portable_storage_template_helper.h>
+#include <file_io_utils.h>
+#include <boost/filesystem.hpp>
+#include <ctime>
+
+using namespace cryptonote;
+
+namespace supernode {
+
+namespace consts {
+    static const uint64_t    BLOCKS_BATCH_SIZE   = 100;
+    static const uint64_t    REORG_RESCAN_DEPTH  = 10;
+    static const size_t      BLOCK_IDS_KEPT      = 64;
+    static const std::chrono::seconds DAEMON_TIMEOUT(30);
+}
+
+// scan state of an account stored in the state directory, file per account address
+struct FSN_OutputScanner::SStoredState
+{
+    uint64_t ScanHeight = 0;
+    crypto::hash LastBlockId = crypto::null_hash; // block ScanHeight - 1, to detect reorganization while stopped
+    std::vector<SOutput> Outputs;
+
+    BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(ScanHeight)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(LastBlockId)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(Outputs)
+    END_KV_SERIALIZE_MAP()
+};
+
+FSN_OutputScanner::FSN_OutputScanner()
+{
+}
+
+FSN_OutputScanner::~FSN_OutputScanner()
+{
+    Stop();
+}
+
+void FSN_OutputScanner::Start(network_type nettype, const std::string &daemon_addr,
+                              boost::optional<epee::net_utils::http::login> login, unsigned interval_ms)
+{
+    Stop();
+    {
+        boost::lock_guard<boost::mutex> lock(m_Guard);
+        m_NetType = nettype;
+        m_Stop = false;
+    }
+    m_Client.set_server(daemon_addr, login);
+    m_Thread = boost::thread(&FSN_OutputScanner::Worker, this, interval_ms);
+}
+
+void FSN_OutputScanner::Stop()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(m_Guard);
+        m_Stop = true;
+    }
+    m_StopCondition.notify_all();
+    if (m_Thread.joinable())
+        m_Thread.join();
+    Store();
+}
+
+void FSN_OutputScanner::SetStateDir(const std::string &dir)
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    m_StateDir = dir;
+}
+
+void FSN_OutputScanner::Store()
+{
+    // files are written out of the scan lock, one Store at a time, so older state never overwrites newer one
+    boost::lock_guard<boost::mutex> store_lock(m_StoreGuard);
+    std::string state_dir;
+    std::vector<std::pair<std::string, SStoredState>> states;
+    {
+        boost::lock_guard<boost::mutex> lock(m_Guard);
+        if (m_StateDir.empty())
+            return;
+        state_dir = m_StateDir;
+        for (auto &item : m_Accounts) {
+            SAccount &account = item.second;
+            if (!account.Dirty)
+                continue;
+            account.Dirty = false;
+            SStoredState state;
+            state.ScanHeight = account.ScanHeight;
+            const auto id = m_BlockIds.find(account.ScanHeight - 1);
+            if (account.ScanHeight > 0 && id != m_BlockIds.end())
+                state.LastBlockId = id->second;
+            state.Outputs = account.Outputs;
+            states.emplace_back(item.first, std::move(state));
+        }
+    }
+
+    for (const auto &item : states) {
+        const std::string path = (boost::filesystem::path(state_dir) / item.first).string();
+        const std::string tmp_path = path + ".tmp";
+        std::string data;
+        if (!epee::serialization::store_t_to_binary(item.second, data) || !epee::file_io_utils::save_string_to_file(tmp_path, data)) {
+            LOG_ERROR("Failed to store scan state: " << path);
+            continue;
+        }
+        boost::system::error_code ec;
+        boost::filesystem::rename(tmp_path, path, ec);
+        if (ec)
+            LOG_ERROR("Failed to store scan state: " << path << ", " << ec.message());
+    }
+}
+
+bool FSN_OutputScanner::LoadState(const std::string &path, SAccount &account, crypto::hash &last_block_id)
+{
+    boost::system::error_code ec;
+    std::string data;
+    if (!boost::filesystem::exists(path, ec) || !epee::file_io_utils::load_file_to_string(path, data))
+        return false;
+
+    SStoredState state;
+    if (!epee::serialization::load_t_from_binary(state, data)) {
+        MWARNING("Failed to parse scan state: " << path);
+        return false;
+    }
+    for (const SOutput &out : state.Outputs) {
+        if (out.Height >= state.ScanHeight) {
+            MWARNING("Invalid scan state: " << path);
+            return false;
+        }
+    }
+
+    account.ScanHeight = state.ScanHeight;
+    account.Outputs = std::move(state.Outputs);
+    RebuildBalances(account);
+    last_block_id = state.LastBlockId;
+    return true;
+}
+
+bool FSN_OutputScanner::AddAccount(const FSN_WalletData &wallet)
+{
+    network_type nettype;
+    std::string state_dir;
+    {
+        boost::lock_guard<boost::mutex> lock(m_Guard);
+        if (m_Accounts.count(wallet.Addr))
+            return true;
+        nettype = m_NetType;
+        state_dir = m_StateDir;
+    }
+
+    address_parse_info info;
+    if (!get_account_address_from_str(info, nettype, wallet.Addr)) {
+        LOG_ERROR("Error parsing address: " << wallet.Addr);
+        return false;
+    }
+
+    SAccount account;
+    account.Address = info.address;
+    crypto::public_key view_public_key;
+    if (!epee::string_tools::hex_to_pod(wallet.ViewKey, account.ViewKey)
+            || !crypto::secret_key_to_public_key(account.ViewKey, view_public_key)
+            || view_public_key != info.address.m_view_public_key) {
+        LOG_ERROR("Invalid view key for address: " << wallet.Addr);
+        return false;
+    }
+
+    // continue from the stored state, file is read out of the lock
+    crypto::hash last_block_id = crypto::null_hash;
+    if (!state_dir.empty() && LoadState((boost::filesystem::path(state_dir) / wallet.Addr).string(), account, last_block_id))
+        MINFO("Loaded scan state of " << wallet.Addr << " at height " << account.ScanHeight);
+    const uint64_t scan_height = account.ScanHeight;
+
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    if (m_Accounts.count(wallet.Addr))
+        return true; // added concurrently
+    if (scan_height > 0 && last_block_id != crypto::null_hash) {
+        // state stored on the other chain than the scanned one is rescanned
+        const auto id = m_BlockIds.emplace(scan_height - 1, last_block_id).first;
+        if (id->second != last_block_id) {
+            MWARNING("Scan state of " << wallet.Addr << " doesn't match blockchain, rescanning");
+            account.ScanHeight = 0;
+            account.Outputs.clear();
+            RebuildBalances(account);
+        }
+    }
+    m_Accounts.emplace(wallet.Addr, std::move(account));
+    m_StopCondition.notify_all(); // start scanning for new account
+    return true;
+}
+
+bool FSN_OutputScanner::RemoveAccount(const std::string &address)
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    return m_Accounts.erase(address) > 0;
+}
+
+bool FSN_OutputScanner::HasAccount(const std::string &address) const
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    return m_Accounts.count(address) > 0;
+}
+
+bool FSN_OutputScanner::UnlockedBalance(const std::string &address, uint64_t height, uint64_t &balance) const
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    const auto it = m_Accounts.find(address);
+    if (it == m_Accounts.end())
+        return false;
+
+    const SAccount &account = it->second;
+    if (height > account.ScanHeight)
+        return false; // outputs of the blocks below the height are not known yet
+    if (height == account.ScanHeight) {
+        balance = account.Unlocked;
+        return true;
+    }
+
+    balance = 0;
+    for (const SOutput &out : account.Outputs)
+        if (out.Height < height && IsUnlocked(out, height))
+            balance += out.Amount;
+    return true;
+}
+
+uint64_t FSN_OutputScanner::Balance(const std::string &address) const
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    const auto it = m_Accounts.find(address);
+    return it != m_Accounts.end() ? it->second.Balance : 0;
+}
+
+uint64_t FSN_OutputScanner::ScanHeight() const
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    uint64_t result = std::numeric_limits<uint64_t>::max();
+    for (const auto &account : m_Accounts)
+        result = std::min(result, account.second.ScanHeight);
+    return result;
+}
+
+bool FSN_OutputScanner::IsUnlocked(const SOutput &out, uint64_t height)
+{
+    // same rules as wallet2::is_transfer_unlocked, height is the blockchain height
+    if (out.Height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE > height)
+        return false;
+    if (out.UnlockTime < CRYPTONOTE_MAX_BLOCK_NUMBER)
+        return height - 1 + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= out.UnlockTime;
+    return uint64_t(time(NULL)) + CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V2 >= out.UnlockTime;
+}
+
+void FSN_OutputScanner::ReleaseUnlocked(SAccount &account)
+{
+    size_t keep = 0;
+    for (size_t i = 0; i < account.Locked.size(); ++i) {
+        if (IsUnlocked(account.Locked[i], account.ScanHeight)) {
+            account.Unlocked += account.Locked[i].Amount;
+        } else {
+            if (keep != i)
+                account.Locked[keep] = account.Locked[i];
+            ++keep;
+        }
+    }
+    account.Locked.resize(keep);
+}
+
+void FSN_OutputScanner::RebuildBalances(SAccount &account)
+{
+    account.Balance = 0;
+    account.Unlocked = 0;
+    account.Locked = account.Outputs;
+    for (const SOutput &out : account.Outputs)
+        account.Balance += out.Amount;
+    ReleaseUnlocked(account);
+}
+
+void FSN_OutputScanner::ScanTransaction(const account_public_address &address, const crypto::secret_key &view_key,
+                                        uint64_t height, const transaction &tx, const crypto::public_key &tx_pub_key,
+                                        const std::vector<crypto::public_key> &additional_pub_keys, std::vector<SOutput> &outputs)
+{
+    crypto::key_derivation derivation;
+    const bool has_derivation = tx_pub_key != crypto::null_pkey && crypto::generate_key_derivation(tx_pub_key, view_key, derivation);
+
+    for (size_t i = 0; i < tx.vout.size(); ++i) {
+        const tx_out &out = tx.vout[i];
+        if (out.target.type() != typeid(txout_to_key))
+            continue;
+        const crypto::public_key &out_key = boost::get<txout_to_key>(out.target).key;
+
+        crypto::public_key derived;
+        crypto::key_derivation additional_derivation;
+        const crypto::key_derivation *found = nullptr;
+        if (has_derivation && crypto::derive_public_key(derivation, i, address.m_spend_public_key, derived) && derived == out_key)
+            found = &derivation;
+        else if (i < additional_pub_keys.size()
+                 && crypto::generate_key_derivation(additional_pub_keys[i], view_key, additional_derivation)
+                 && crypto::derive_public_key(additional_derivation, i, address.m_spend_public_key, derived)
+                 && derived == out_key)
+            found = &additional_derivation;
+        if (!found)
+            continue;
+
+        uint64_t amount = out.amount;
+        if (tx.version > 1 && tx.rct_signatures.type != rct::RCTTypeNull) {
+            hw::device &hwdev = hw::get_device("default");
+            crypto::secret_key scalar;
+            hwdev.derivation_to_scalar(*found, i, scalar);
+            try {
+                switch (tx.rct_signatures.type) {
+                case rct::RCTTypeSimple:
+                case rct::RCTTypeBulletproof:
+                    amount = rct::decodeRctSimple(tx.rct_signatures, rct::sk2rct(scalar), i, hwdev);
+                    break;
+                case rct::RCTTypeFull:
+                    amount = rct::decodeRct(tx.rct_signatures, rct::sk2rct(scalar), i, hwdev);
+                    break;
+                default:
+                    LOG_ERROR("Unsupported rct type: " << tx.rct_signatures.type);
+                    continue;
+                }
+            } catch (const std::exception &e) {
+                LOG_ERROR("Failed to decode output " << i << " of tx " << get_transaction_hash(tx) << ": " << e.what());
+                continue;
+            }
+        }
+
+        outputs.push_back(SOutput{height, tx.unlock_time, amount});
+    }
+}
+
+void FSN_OutputScanner::ProcessBlock(uint64_t height, const block &block, const std::vector<transaction> &txs)
+{
+    std::vector<const transaction*> all_txs;
+    all_txs.reserve(txs.size() + 1);
+    all_txs.push_back(&block.miner_tx);
+    for (const transaction &tx : txs)
+        all_txs.push_back(&tx);
+
+    // tx public keys are parsed once for all accounts
+    std::vector<crypto::public_key> tx_pub_keys(all_txs.size());
+    std::vector<std::vector<crypto::public_key>> additional_pub_keys(all_txs.size());
+    for (size_t i = 0; i < all_txs.size(); ++i) {
+        tx_pub_keys[i] = get_tx_pub_key_from_extra(*all_txs[i]);
+        additional_pub_keys[i] = get_additional_tx_pub_keys_from_extra(*all_txs[i]);
+    }
+
+    // keys of the accounts are copied, so key derivations don't hold the lock
+    struct SScan
+    {
+        std::string Key;
+        account_public_address Address;
+        crypto::secret_key ViewKey;
+        std::vector<SOutput> Outputs;
+    };
+    std::vector<SScan> scans;
+    {
+        boost::lock_guard<boost::mutex> lock(m_Guard);
+        for (const auto &item : m_Accounts)
+            if (item.second.ScanHeight == height)
+                scans.push_back(SScan{item.first, item.second.Address, item.second.ViewKey, {}});
+    }
+
+    for (SScan &scan : scans)
+        for (size_t i = 0; i < all_txs.size(); ++i)
+            ScanTransaction(scan.Address, scan.ViewKey, height, *all_txs[i], tx_pub_keys[i], additional_pub_keys[i], scan.Outputs);
+
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    for (const SScan &scan : scans) {
+        // account may be removed or re-added meanwhile
+        const auto it = m_Accounts.find(scan.Key);
+        if (it == m_Accounts.end() || it->second.ScanHeight != height || it->second.ViewKey != scan.ViewKey)
+            continue;
+        SAccount &account = it->second;
+        for (const SOutput &output : scan.Outputs) {
+            account.Outputs.push_back(output);
+            account.Locked.push_back(output);
+            account.Balance += output.Amount;
+        }
+        account.ScanHeight = height + 1;
+        account.Dirty = true;
+        ReleaseUnlocked(account);
+    }
+
+    m_BlockIds[height] = get_block_hash(block);
+    while (m_BlockIds.size() > consts::BLOCK_IDS_KEPT)
+        m_BlockIds.erase(m_BlockIds.begin());
+}
+
+void FSN_OutputScanner::Rollback(uint64_t height)
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    for (auto &item : m_Accounts) {
+        SAccount &account = item.second;
+        if (account.ScanHeight <= height)
+            continue;
+        account.ScanHeight = height;
+        account.Dirty = true;
+        size_t keep = 0;
+        for (size_t i = 0; i < account.Outputs.size(); ++i)
+            if (account.Outputs[i].Height < height)
+                account.Outputs[keep++] = account.Outputs[i];
+        account.Outputs.resize(keep);
+        RebuildBalances(account);
+    }
+    m_BlockIds.erase(m_BlockIds.lower_bound(height), m_BlockIds.end());
+}
+
+bool FSN_OutputScanner::Refresh()
+{
+    for (;;) {
+        uint64_t start_height = ScanHeight();
+        if (start_height == std::numeric_limits<uint64_t>::max())
+            return true; // no accounts
+
+        COMMAND_RPC_GET_HEIGHT::request height_req;
+        COMMAND_RPC_GET_HEIGHT::response height_res = AUTO_VAL_INIT(height_res);
+        if (!epee::net_utils::invoke_http_json("/getheight", height_req, height_res, m_Client, consts::DAEMON_TIMEOUT)
+                || height_res.status != CORE_RPC_STATUS_OK) {
+            LOG_ERROR("Failed to get blockchain height from daemon");
+            return false;
+        }
+        if (start_height >= height_res.height)
+            return true;
+
+        COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::request req;
+        COMMAND_RPC_GET_BLOCKS_BY_HEIGHT::response res = AUTO_VAL_INIT(res);
+        for (uint64_t height = start_height; height < std::min(height_res.height, start_height + consts::BLOCKS_BATCH_SIZE); ++height)
+            req.heights.push_back(height);
+        if (!epee::net_utils::invoke_http_bin("/getblocks_by_height.bin", req, res, m_Client, consts::DAEMON_TIMEOUT)
+                || res.status != CORE_RPC_STATUS_OK || res.blocks.size() != req.heights.size()) {
+            LOG_ERROR("Failed to get blocks from daemon, start height: " << start_height);
+            return false;
+        }
+
+        for (size_t i = 0; i < res.blocks.size(); ++i) {
+            const uint64_t height = req.heights[i];
+            block b;
+            if (!parse_and_validate_block_from_blob(res.blocks[i].block, b)) {
+                LOG_ERROR("Failed to parse block at height " << height);
+                return false;
+            }
+
+            bool reorganized = false;
+            {
+                boost::lock_guard<boost::mutex> lock(m_Guard);
+                if (m_Stop)
+                    return true;
+                const auto prev = m_BlockIds.find(height - 1);
+                reorganized = height > 0 && prev != m_BlockIds.end() && prev->second != b.prev_id;
+            }
+            if (reorganized) {
+                const uint64_t rollback_height = height > consts::REORG_RESCAN_DEPTH ? height - consts::REORG_RESCAN_DEPTH : 0;
+                MWARNING("Blockchain reorganization detected at height " << height << ", rescanning from " << rollback_height);
+                Rollback(rollback_height);
+                break;
+            }
+
+            std::vector<transaction> txs(res.blocks[i].txs.size());
+            for (size_t j = 0; j < txs.size(); ++j) {
+                if (!parse_and_validate_tx_from_blob(res.blocks[i].txs[j], txs[j])) {
+                    LOG_ERROR("Failed to parse transaction of block at height " << height);
+                    return false;
+                }
+            }
+            ProcessBlock(height, b, txs);
+        }
+        Store();
+    }
+}
+
+void FSN_OutputScanner::Worker(unsigned interval_ms)
+{
+    for (;;) {
+        try {
+            Refresh();
+        } catch (const std::exception &e) {
+            LOG_ERROR("Failed to refresh FSN accounts: " << e.what());
+        }
+
+        boost::unique_lock<boost::mutex> lock(m_Guard);
+        if (m_Stop)
+            return;
+        m_StopCondition.wait_for(lock, boost::chrono::milliseconds(interval_ms));
+        if (m_Stop)
+            return;
+    }
+}
+
+} // namespace supernode
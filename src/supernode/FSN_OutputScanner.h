@@ -0,0 +1,174 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef FSN_OUTPUT_SCANNER_H_
+#define FSN_OUTPUT_SCANNER_H_
+
+#include "supernode_common_struct.h"
+#include <cryptonote_basic/cryptonote_basic.h>
+#include <net/http_client.h>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace supernode {
+
+/*!
+ * \brief FSN_OutputScanner - tracks incoming outputs of many view-only accounts
+ *
+ * Each block is fetched and parsed once and checked against all tracked (view key, spend public key) pairs,
+ * instead of running a separate view-only wallet per account. An account added later is scanned from the
+ * beginning of the chain, blocks of the catch-up are shared with all accounts at the same height.
+ * Scan state of each account is stored in the state directory, so after a restart scanning continues from
+ * the stored height. Like a view-only wallet, the scanner can't detect spent outputs, so balances are sums
+ * of received outputs.
+ */
+class FSN_OutputScanner
+{
+public:
+    FSN_OutputScanner();
+    ~FSN_OutputScanner();
+
+    FSN_OutputScanner(const FSN_OutputScanner&) = delete;
+    FSN_OutputScanner& operator=(const FSN_OutputScanner&) = delete;
+
+    /*!
+     * \brief Start        - starts background refresh from the daemon
+     * \param nettype      - network type used to parse account addresses
+     * \param daemon_addr  - daemon address in form "hostname:port"
+     * \param login        - daemon login, optional
+     * \param interval_ms  - refresh interval
+     */
+    void Start(cryptonote::network_type nettype, const std::string &daemon_addr,
+               boost::optional<epee::net_utils::http::login> login, unsigned interval_ms);
+    void Stop();
+
+    /*!
+     * \brief SetStateDir - directory to store scan state of accounts, must be set before accounts are added,
+     *                      state is not stored if empty
+     */
+    void SetStateDir(const std::string &dir);
+    /*!
+     * \brief Store - stores scan state of accounts changed since the last call, also done by Refresh and Stop
+     */
+    void Store();
+
+    /*!
+     * \brief AddAccount - starts tracking of account from its stored state, does nothing if the account is
+     *                     tracked already
+     * \return           - false if the address or view key is invalid
+     */
+    bool AddAccount(const FSN_WalletData &wallet);
+    bool RemoveAccount(const std::string &address);
+    bool HasAccount(const std::string &address) const;
+
+    /*!
+     * \brief UnlockedBalance - unlocked balance of account at blockchain height
+     * \param address         - account address
+     * \param height          - blockchain height, cheap for the height the account is scanned up to
+     * \param balance         - unlocked balance
+     * \return                - false for unknown account or account not scanned up to the height yet
+     */
+    bool UnlockedBalance(const std::string &address, uint64_t height, uint64_t &balance) const;
+    uint64_t Balance(const std::string &address) const;
+
+    /*!
+     * \brief ProcessBlock - checks block outputs for accounts scanned up to this height, keys are derived
+     *                       out of the lock, so balance queries are not blocked by the scan
+     * \param height       - block height
+     * \param txs          - block transactions (without miner tx)
+     */
+    void ProcessBlock(uint64_t height, const cryptonote::block &block, const std::vector<cryptonote::transaction> &txs);
+    /*!
+     * \brief Rollback - forgets blocks starting from height (blockchain reorganization)
+     */
+    void Rollback(uint64_t height);
+    /*!
+     * \brief ScanHeight - next block height to process, minimum over all accounts
+     */
+    uint64_t ScanHeight() const;
+
+    /*!
+     * \brief Refresh - fetches and processes blocks from the daemon up to its top
+     * \return        - false on daemon communication error
+     */
+    bool Refresh();
+
+private:
+    struct SOutput
+    {
+        uint64_t Height;
+        uint64_t UnlockTime;
+        uint64_t Amount;
+    };
+
+    struct SAccount
+    {
+        cryptonote::account_public_address Address;
+        crypto::secret_key ViewKey;
+        uint64_t ScanHeight = 0;
+        uint64_t Balance = 0;
+        uint64_t Unlocked = 0; // at ScanHeight
+        std::vector<SOutput> Outputs;
+        std::vector<SOutput> Locked;
+        bool Dirty = false; // changed since stored
+    };
+
+    struct SStoredState;
+
+    static bool IsUnlocked(const SOutput &out, uint64_t height);
+    static void ScanTransaction(const cryptonote::account_public_address &address, const crypto::secret_key &view_key,
+                                uint64_t height, const cryptonote::transaction &tx, const crypto::public_key &tx_pub_key,
+                                const std::vector<crypto::public_key> &additional_pub_keys, std::vector<SOutput> &outputs);
+    static void ReleaseUnlocked(SAccount &account);
+    static void RebuildBalances(SAccount &account);
+    static bool LoadState(const std::string &path, SAccount &account, crypto::hash &last_block_id);
+    void Worker(unsigned interval_ms);
+
+private:
+    mutable boost::mutex m_Guard;
+    cryptonote::network_type m_NetType = cryptonote::MAINNET;
+    std::unordered_map<std::string, SAccount> m_Accounts;
+    std::map<uint64_t, crypto::hash> m_BlockIds; // recent processed blocks, to detect reorganization
+    std::string m_StateDir;
+    boost::mutex m_StoreGuard; // serializes writes of state files
+
+    epee::net_utils::http::http_simple_client m_Client;
+    bool m_Stop = false;
+    boost::condition_variable m_StopCondition;
+    boost::thread m_Thread;
+};
+
+} // namespace supernode
+
+#endif /* FSN_OUTPUT_SCANNER_H_ */
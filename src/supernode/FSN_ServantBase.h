@@ -49,7 +49,8 @@ namespace supernode {
 	    virtual bool IsSignValid(const string& message, const string &address, const string &signature) const=0;
 
 
-	    virtual uint64_t GetWalletBalance(uint64_t block_num, const FSN_WalletData& wallet) const=0;
+	    // unlocked balance at block_num, false if it is not known yet (account is not scanned up to block_num)
+	    virtual bool GetWalletBalance(uint64_t block_num, const FSN_WalletData& wallet, uint64_t& balance) const=0;
 
 	public:
 	    // Add WITHOUT any checks. And child add WITHOUT any checks for stake, ping or any other req FSN attrs
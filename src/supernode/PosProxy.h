@@ -38,6 +38,7 @@ namespace supernode {
     class PosProxy : public BaseClientProxy {
 		public:
 		bool Sale(const rpc_command::POS_SALE::request& in, rpc_command::POS_SALE::response& out);
+		const char* Name() const override { return "PosProxy"; }
 
 		protected:
 		void Init() override;
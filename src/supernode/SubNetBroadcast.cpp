@@ -84,19 +84,20 @@ void supernode::SubNetBroadcast::Set( DAPI_RPC_Server* pa, string subnet_id, con
 	}
 }
 
-void supernode::SubNetBroadcast::IncNoConnectAndRemove(const string& ip, const string& port) {
+void supernode::SubNetBroadcast::UpdateMemberAvailability(const string& ip, const string& port, bool ok, bool wasNoConnect) {
 	boost::lock_guard<boost::recursive_mutex> lock(m_MembersGuard);
 	for(unsigned i=0;i<m_Members.size();i++) if( m_Members[i].IP==ip && m_Members[i].Port==port ) {
-		m_Members[i].NotAvailCount++;
-		if( m_Members[i].NotAvailCount>=s_MaxNotAvailCount ) {
+		SMember& member = m_Members[i];
+		if(ok) {
+			member.NotAvailCount = 0;
+			break;
+		}
+		if(!wasNoConnect) break;
+		member.NotAvailCount++;
+		if( member.NotAvailCount>=s_MaxNotAvailCount ) {
+			LOG_PRINT_L1("Removing unavailable subnet member "<<ip<<":"<<port);
 			m_Members.erase( m_Members.begin()+i );
 		}
 		break;
 	}
-
-
 }
-
-
-
-
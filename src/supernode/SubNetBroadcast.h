@@ -35,6 +35,8 @@
 #include "DAPI_RPC_Client.h"
 #include "DAPI_RPC_Server.h"
 #include "WorkerPool.h"
+#include <boost/make_shared.hpp>
+#include <boost/thread/condition_variable.hpp>
 using namespace std;
 
 namespace supernode {
@@ -56,7 +58,7 @@ namespace supernode {
 			SMember(const string& ip, const string& p) { IP = ip; Port = p; }
 			string IP;
 			string Port;
-			unsigned NotAvailCount = 0;
+			unsigned NotAvailCount = 0;// consecutive calls failed to connect, member is removed at limit
 		};
 
 		vector< pair<string, string> > Members();//port, ip
@@ -67,102 +69,106 @@ namespace supernode {
 		bool AllowSendSefl = true;
 
 		public:
+		// Call method on all members concurrently.
+		// When reqAllResps is set, returns false as soon as one member fails, calls still in flight complete
+		// in background; otherwise waits for all members and returns responses received, never fails.
 		template<class IN_t, class OUT_t>
 		bool Send( const string& method, const IN_t& in, vector<OUT_t>& out, bool reqAllResps=true ) {
-			if(m_SendsCount) throw string("m_SendsCount not zero");
+			boost::shared_ptr< SSendState<OUT_t> > state = Post<IN_t, OUT_t>(method, in);
+			const unsigned count = state->Out.size();
 
-			m_MembersGuard.lock();
+			boost::unique_lock<boost::mutex> lock(state->Guard);
+			state->Done.wait(lock, [&]() {
+				return state->Finished==count || ( reqAllResps && state->Finished>state->Succeeded );
+			});
 
-			out.resize( m_Members.size() );
-			vector<int> rets;
-			rets.resize( m_Members.size(), 0 );
-			m_SendsCount = m_Members.size();
+			out.clear();
+			for(unsigned i=0;i<count;i++) if( state->Rets[i]!=0 ) out.push_back( state->Out[i] );
 
-
-			for(unsigned i=0;i<m_Members.size();i++) {
-				OUT_t* outp = &out[i];
-				int* retp = &rets[i];
-				string ip = m_Members[i].IP;
-				string port = m_Members[i].Port;
-				m_Work.Service.post(
-					[this, method, in, outp, retp, ip, port]() {
-					DoCallInThread<IN_t, OUT_t>(method, in, outp, retp, ip, port);
-				} );
+			if( reqAllResps && state->Succeeded<count ) {
+				out.clear();
+				return false;
 			}
-
-			m_MembersGuard.unlock();
-
-			while(m_SendsCount) boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
-
-			bool ret = true;
-
-			if(reqAllResps) {
-				for(unsigned i=0;i<m_Members.size();i++) if( rets[i]==0 ) {
-					ret = false; break;
-				}
-				if(!ret) out.clear();
-			} else {
-				 vector<OUT_t> vv;
-				 for(unsigned i=0;i<out.size();i++) if( rets[i]!=0 ) vv.push_back( out[i] );
-				 out = vv;
-			}
-
-			return ret;
+			return true;
 		}
 
 		template<class IN_t>
 		void Send( const string& method, const IN_t& in) {
-			if(m_SendsCount) throw string("m_SendsCount not zero");
+			Post<IN_t, rpc_command::P2P_DUMMY_RESP>(method, in);
+		}
 
-			rpc_command::P2P_DUMMY_RESP* outp = &m_DummyOut;
-			int* retp = &m_DummyRet;
+		template<class IN_t, class OUT_t>
+		void AddHandler( const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
+			int idx = m_DAPIServer->Add_UUID_MethodHandler<IN_t, OUT_t>( m_PaymentID, method, handler );
+			m_MyHandlers.push_back(idx);
+		}
+		#define ADD_SUBNET_HANDLER(method, data, class_owner) AddHandler<data::request, data::response>( dapi_call::method, bind( &class_owner::method, this, _1, _2) );
+
+		protected:
+		// results of one Send, shared with calls in flight
+		template<class OUT_t>
+		struct SSendState {
+			boost::mutex Guard;
+			boost::condition_variable Done;
+			vector<OUT_t> Out;
+			vector<int> Rets;
+			unsigned Succeeded = 0;
+			unsigned Finished = 0;
+		};
+
+		template<class IN_t, class OUT_t>
+		boost::shared_ptr< SSendState<OUT_t> > Post( const string& method, const IN_t& in ) {
+			boost::shared_ptr< SSendState<OUT_t> > state = boost::make_shared< SSendState<OUT_t> >();
 
 			boost::lock_guard<boost::recursive_mutex> lock(m_MembersGuard);
+			state->Out.resize( m_Members.size() );
+			state->Rets.resize( m_Members.size(), 0 );
 
 			for(unsigned i=0;i<m_Members.size();i++) {
 				string ip = m_Members[i].IP;
 				string port = m_Members[i].Port;
+				// don't delay the call with retries of a member which already failed to connect
+				unsigned retries = m_Members[i].NotAvailCount ? 1 : RetryCount;
 				m_Work.Service.post(
-					[this, method, in, outp, retp, ip, port]() {
-					DoCallInThread<IN_t, rpc_command::P2P_DUMMY_RESP>(method, in, outp, retp, ip, port);
+					[this, method, in, state, i, ip, port, retries]() {
+					DoCallInThread<IN_t, OUT_t>(method, in, state, i, ip, port, retries);
 				} );
-			}//for
-		}
-
-
-		template<class IN_t, class OUT_t>
-		void AddHandler( const string& method, boost::function<bool (const IN_t&, OUT_t&)> handler ) {
-			int idx = m_DAPIServer->Add_UUID_MethodHandler<IN_t, OUT_t>( m_PaymentID, method, handler );
-			m_MyHandlers.push_back(idx);
+			}
+			return state;
 		}
-		#define ADD_SUBNET_HANDLER(method, data, class_owner) AddHandler<data::request, data::response>( dapi_call::method, bind( &class_owner::method, this, _1, _2) );
 
-		public:
 		template<class IN_t, class OUT_t>
-		void DoCallInThread(string method, const IN_t in, OUT_t* outo, int* ret, string ip, string port) {
+		void DoCallInThread(string method, const IN_t in, boost::shared_ptr< SSendState<OUT_t> > state, unsigned idx, string ip, string port, unsigned retries) {
+			OUT_t outo;
 			bool localcOk = false;
 			bool wasNoConnect = false;
-			for(unsigned k=0;k<RetryCount;k++) {
-				DAPI_RPC_Client client;
-				client.Set( ip, port );
-				if( !client.Invoke<IN_t, OUT_t>(method, in, *outo, CallTimeout) ) {
-					wasNoConnect = wasNoConnect || !client.WasConnected;
+			for(unsigned k=0;k<retries;k++) {
+				bool wasConnected = false;
+				if( !DAPI_RPC_ClientPool::Instance().Invoke<IN_t, OUT_t>(ip, port, method, in, outo, CallTimeout, wasConnected) ) {
+					wasNoConnect = wasNoConnect || !wasConnected;
 					boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
 					continue;
 				}
 				localcOk = true;
 				break;
 			}//for K
-			*ret = localcOk?1:0;
-			if(!localcOk && wasNoConnect) IncNoConnectAndRemove(ip, port);
-
-			if(m_SendsCount) m_SendsCount--;
+			UpdateMemberAvailability(ip, port, localcOk, wasNoConnect);
+
+			{
+				boost::lock_guard<boost::mutex> lock(state->Guard);
+				if(localcOk) {
+					state->Out[idx] = std::move(outo);
+					state->Rets[idx] = 1;
+					state->Succeeded++;
+				}
+				state->Finished++;
+			}
+			state->Done.notify_all();
 		}//do work
 
-
 		protected:
 		void _AddMember(const string& ip, const string& port);
-		void IncNoConnectAndRemove(const string& ip, const string& port);
+		void UpdateMemberAvailability(const string& ip, const string& port, bool ok, bool wasNoConnect);
 
 		protected:
 		DAPI_RPC_Server* m_DAPIServer = nullptr;
@@ -172,13 +178,8 @@ namespace supernode {
 		vector<int> m_MyHandlers;
 
 		protected:
-		int m_SendsCount = 0;
 	    WorkerPool m_Work;
 
-		protected:
-		rpc_command::P2P_DUMMY_RESP m_DummyOut;
-		int m_DummyRet=0;
-
 
 
 };
@@ -0,0 +1,106 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace supernode {
+
+	// Hashed timer wheel: items are put to the slot of their deadline, slot count times slot duration is one round.
+	// Items due in later rounds stay in the slot until their round comes, so Add is O(1) and each Expire visits
+	// only slots passed since the previous call.
+	template<class T>
+	class TimerWheel {
+		public:
+		TimerWheel(unsigned slot_ms, size_t slots_count) : m_SlotMs(slot_ms ? slot_ms : 1), m_Slots(slots_count ? slots_count : 1) {}
+
+		void Add(const T& item, const boost::posix_time::ptime& deadline) {
+			int64_t tick = Tick(deadline);
+			if( !m_Started ) m_Current = std::min(m_Current, tick);// nothing is processed yet
+			else if( tick<m_Current ) tick = m_Current;// already due, fire at next Expire
+			m_Slots[tick % m_Slots.size()].push_back( SEntry{tick, item} );
+			m_Size++;
+		}
+
+		// move items due at 'now' to 'expired'
+		void Expire(const boost::posix_time::ptime& now, std::vector<T>& expired) {
+			const int64_t now_tick = Tick(now);
+			if( !m_Size ) { m_Current = now_tick+1; m_Started = true; return; }
+			if( now_tick<m_Current ) return;
+
+			const int64_t last = std::min<int64_t>(now_tick, m_Current+int64_t(m_Slots.size())-1);
+			for(int64_t tick=m_Current;tick<=last;tick++) {
+				std::vector<SEntry>& slot = m_Slots[tick % m_Slots.size()];
+				size_t keep = 0;
+				for(size_t i=0;i<slot.size();i++) {
+					if( slot[i].Tick<=now_tick ) {
+						expired.push_back(slot[i].Item);
+						m_Size--;
+					} else {
+						if( keep!=i ) slot[keep] = slot[i];
+						keep++;
+					}
+				}
+				slot.resize(keep);
+			}
+			m_Current = now_tick+1;
+			m_Started = true;
+		}
+
+		size_t Size() const { return m_Size; }
+
+		private:
+		struct SEntry {
+			int64_t Tick;
+			T Item;
+		};
+
+		int64_t Tick(const boost::posix_time::ptime& time) const {
+			static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+			const int64_t ms = (time-epoch).total_milliseconds();
+			return ms>0 ? ms/m_SlotMs : 0;
+		}
+
+		private:
+		const unsigned m_SlotMs;
+		std::vector< std::vector<SEntry> > m_Slots;
+		int64_t m_Current = std::numeric_limits<int64_t>::max();// first tick which is not processed yet
+		bool m_Started = false;
+		size_t m_Size = 0;
+	};
+
+}
+
+#endif /* TIMERWHEEL_H_ */
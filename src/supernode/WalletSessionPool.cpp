@@ -0,0 +1,149 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "WalletSessionPool.h"
+#include <memwipe.h>
+#include <misc_log_ex.h>
+
+namespace supernode {
+
+WalletSessionPool::Handle::Handle(const std::shared_ptr<SSession> &session)
+    : m_Session(session), m_Lock(session->Guard)
+{
+}
+
+WalletSessionPool::WalletSessionPool(size_t max_sessions, std::chrono::seconds idle_timeout)
+    : m_MaxSessions(max_sessions), m_IdleTimeout(idle_timeout)
+{
+}
+
+crypto::hash WalletSessionPool::CredentialsHash(const std::string &account, const std::string &password)
+{
+    std::string data = std::to_string(password.size()) + ":" + password + account;
+    crypto::hash hash = crypto::cn_fast_hash(data.data(), data.size());
+    memwipe(&data[0], data.size());
+    return hash;
+}
+
+WalletSessionPool::Handle WalletSessionPool::Acquire(const std::string &account, const std::string &password,
+                                                     const WalletFactory &factory)
+{
+    const crypto::hash credentials = CredentialsHash(account, password);
+    std::shared_ptr<SSession> session;
+    {
+        boost::lock_guard<boost::mutex> lock(m_Guard);
+        ExpireIdleLocked();
+        auto it = m_Sessions.find(credentials);
+        if (it != m_Sessions.end())
+        {
+            Touch(it->second);
+            session = it->second.Session;
+        }
+    }
+    if (session)
+        return Handle(session);
+
+    // opening the wallet is slow, other accounts are served meanwhile
+    std::unique_ptr<tools::GraftWallet> wallet;
+    try
+    {
+        wallet = factory(account, password);
+    }
+    catch (const std::exception &e)
+    {
+        MWARNING("Failed to open wallet: " << e.what());
+    }
+    if (!wallet)
+        return Handle();
+    const std::string address = wallet->get_account().get_public_address_str(wallet->nettype());
+
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    auto it = m_Sessions.find(credentials);
+    if (it == m_Sessions.end())
+    {
+        session = std::make_shared<SSession>();
+        session->Wallet = std::move(wallet);
+        m_Lru.push_front(credentials);
+        it = m_Sessions.emplace(credentials, SEntry{session, m_Lru.begin(), Clock::now(), address}).first;
+        MDEBUG("Opened wallet session for " << address);
+    }
+    else
+    {
+        // opened by a concurrent request with the same account data, the resident wallet is refreshed further
+        Touch(it->second);
+        session = it->second.Session;
+    }
+
+    while (m_Sessions.size() > m_MaxSessions && m_Lru.back() != credentials)
+    {
+        auto evicted = m_Sessions.find(m_Lru.back());
+        MDEBUG("Evicting wallet session for " << evicted->second.Address);
+        Erase(evicted);
+    }
+    return Handle(session);
+}
+
+void WalletSessionPool::ExpireIdle()
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    ExpireIdleLocked();
+}
+
+size_t WalletSessionPool::Size() const
+{
+    boost::lock_guard<boost::mutex> lock(m_Guard);
+    return m_Sessions.size();
+}
+
+void WalletSessionPool::Touch(SEntry &entry)
+{
+    entry.LastUsed = Clock::now();
+    m_Lru.splice(m_Lru.begin(), m_Lru, entry.LruIt);
+}
+
+void WalletSessionPool::Erase(std::unordered_map<crypto::hash, SEntry>::iterator it)
+{
+    m_Lru.erase(it->second.LruIt);
+    m_Sessions.erase(it);
+}
+
+void WalletSessionPool::ExpireIdleLocked()
+{
+    const Clock::time_point expired = Clock::now() - m_IdleTimeout;
+    while (!m_Lru.empty())
+    {
+        auto it = m_Sessions.find(m_Lru.back());
+        if (it->second.LastUsed > expired)
+            break;
+        MDEBUG("Closing idle wallet session for " << it->second.Address);
+        Erase(it);
+    }
+}
+
+} // namespace supernode
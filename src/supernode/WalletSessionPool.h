@@ -0,0 +1,143 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef WALLET_SESSION_POOL_H_
+#define WALLET_SESSION_POOL_H_
+
+#include "wallet/graft_wallet.h"
+#include <crypto/hash.h>
+#include <boost/thread/mutex.hpp>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace supernode {
+
+/*!
+ * \brief WalletSessionPool - keeps opened wallets resident between client requests
+ *
+ * Opening a wallet from the account data (decryption of the keys, genesis block, subaddresses) and loading
+ * its cache is done once per account. Later requests with the same account data and password get the same
+ * wallet, whose refresh continues from the last scanned height. Sessions are keyed by the hash of the exact
+ * account data and password, never by address: other account data of the same address (e.g. a watch-only
+ * one) opens a wallet of its own and can't reach the keys of the resident one. Least recently used
+ * sessions are evicted above the capacity and idle ones expire after the timeout, checked by Acquire and
+ * by periodic ExpireIdle calls of the owner.
+ */
+class WalletSessionPool
+{
+public:
+    typedef std::function<std::unique_ptr<tools::GraftWallet>(const std::string &account, const std::string &password)> WalletFactory;
+
+private:
+    struct SSession
+    {
+        std::unique_ptr<tools::GraftWallet> Wallet;
+        boost::mutex Guard; // serializes requests of the account
+    };
+
+public:
+    /*!
+     * \brief Handle - exclusive access to a wallet of the pool, released on destruction
+     */
+    class Handle
+    {
+    public:
+        Handle() = default;
+        Handle(Handle&&) = default;
+        Handle& operator=(Handle&&) = delete;
+
+        tools::GraftWallet* get() const { return m_Session ? m_Session->Wallet.get() : nullptr; }
+        tools::GraftWallet* operator->() const { return get(); }
+        tools::GraftWallet& operator*() const { return *get(); }
+        explicit operator bool() const { return get() != nullptr; }
+
+    private:
+        friend class WalletSessionPool;
+        explicit Handle(const std::shared_ptr<SSession> &session);
+
+        std::shared_ptr<SSession> m_Session;
+        boost::unique_lock<boost::mutex> m_Lock;
+    };
+
+    /*!
+     * \brief WalletSessionPool
+     * \param max_sessions  - number of resident wallets
+     * \param idle_timeout  - a wallet not used for this time is closed
+     */
+    WalletSessionPool(size_t max_sessions = 100, std::chrono::seconds idle_timeout = std::chrono::seconds(600));
+
+    WalletSessionPool(const WalletSessionPool&) = delete;
+    WalletSessionPool& operator=(const WalletSessionPool&) = delete;
+
+    /*!
+     * \brief Acquire   - returns the resident wallet of the account or opens it with the factory
+     * \param account   - encrypted account data
+     * \param password  - account password
+     * \param factory   - opens the wallet on a miss, returns nullptr or throws on failure
+     * \return          - empty handle if the wallet can't be opened
+     */
+    Handle Acquire(const std::string &account, const std::string &password, const WalletFactory &factory);
+
+    /*!
+     * \brief ExpireIdle - closes wallets not used for the idle timeout, a request holding one keeps it until done
+     */
+    void ExpireIdle();
+    size_t Size() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct SEntry
+    {
+        std::shared_ptr<SSession> Session;
+        std::list<crypto::hash>::iterator LruIt;
+        Clock::time_point LastUsed;
+        std::string Address; // for logs
+    };
+
+    static crypto::hash CredentialsHash(const std::string &account, const std::string &password);
+    void Touch(SEntry &entry);
+    void Erase(std::unordered_map<crypto::hash, SEntry>::iterator it);
+    void ExpireIdleLocked();
+
+private:
+    mutable boost::mutex m_Guard;
+    std::unordered_map<crypto::hash, SEntry> m_Sessions; // by hash of account data and password
+    std::list<crypto::hash> m_Lru; // most recently used first
+    size_t m_MaxSessions;
+    std::chrono::seconds m_IdleTimeout;
+};
+
+} // namespace supernode
+
+#endif /* WALLET_SESSION_POOL_H_ */
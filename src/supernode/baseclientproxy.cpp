@@ -151,6 +151,12 @@ supernode::BaseClientProxy::BaseClientProxy()
 {
 }
 
+supernode::BaseClientProxy::~BaseClientProxy()
+{
+    // Tick of the timer thread uses m_WalletSessions, stop it before the members are destroyed
+    Stop();
+}
+
 void supernode::BaseClientProxy::Init()
 {
     m_DAPIServer->ADD_DAPI_HANDLER(GetWalletBalance, rpc_command::GET_WALLET_BALANCE, BaseClientProxy);
@@ -162,10 +168,16 @@ void supernode::BaseClientProxy::Init()
     m_DAPIServer->ADD_DAPI_HANDLER(GetTransferFee, rpc_command::GET_TRANSFER_FEE, BaseClientProxy);
 }
 
+void supernode::BaseClientProxy::Tick()
+{
+    BaseRTAProcessor::Tick();
+    m_WalletSessions.ExpireIdle();
+}
+
 bool supernode::BaseClientProxy::GetWalletBalance(const supernode::rpc_command::GET_WALLET_BALANCE::request &in, supernode::rpc_command::GET_WALLET_BALANCE::response &out)
 {
 	LOG_PRINT_L0("BaseClientProxy::GetWalletBalance" << in.Account);
-    std::unique_ptr<tools::GraftWallet> wal = initWallet(base64_decode(in.Account), in.Password, false);
+    WalletSessionPool::Handle wal = acquireWallet(base64_decode(in.Account), in.Password);
     if (!wal)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -173,10 +185,13 @@ bool supernode::BaseClientProxy::GetWalletBalance(const supernode::rpc_command::
     }
     try
     {
-        wal->refresh(wal->is_trusted_daemon());
+        // resident wallet continues from its last height, the cache file is only rewritten when it has changed
+        uint64_t blocks_fetched = 0;
+        wal->refresh(wal->is_trusted_daemon(), 0, blocks_fetched);
         out.Balance = wal->balance_all();
         out.UnlockedBalance = wal->unlocked_balance_all();
-        storeWalletState(wal.get());
+        if (blocks_fetched > 0)
+            storeWalletState(wal.get());
     }
     catch (const std::exception& e)
     {
@@ -193,8 +208,8 @@ bool supernode::BaseClientProxy::GetWalletBalance(const supernode::rpc_command::
 bool supernode::BaseClientProxy::GetWalletTransactions(const supernode::rpc_command::GET_WALLET_TRANSACTIONS::request &in, supernode::rpc_command::GET_WALLET_TRANSACTIONS::response &out)
 {
     MINFO("BaseClientProxy::GetWalletTransactions: " << in.Account);
-    std::unique_ptr<tools::GraftWallet> wallet = initWallet(base64_decode(in.Account), in.Password, false);
-    MINFO("BaseClientProxy::GetWalletTransactions: initWallet done");
+    WalletSessionPool::Handle wallet = acquireWallet(base64_decode(in.Account), in.Password);
+    MINFO("BaseClientProxy::GetWalletTransactions: acquireWallet done");
     if (!wallet)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -205,8 +220,9 @@ bool supernode::BaseClientProxy::GetWalletTransactions(const supernode::rpc_comm
         // copy-pasted from wallet_rpc_server.cpp
         // TODO: refactor to avoid code duplication or use wallet2_api.h interfaces
         MINFO("BaseClientProxy::GetWalletTransactions: about to call 'refresh()'");
-        wallet->refresh(wallet->is_trusted_daemon());
-        MINFO("BaseClientProxy::GetWalletTransactions: 'refresh()' done");
+        uint64_t blocks_fetched = 0;
+        wallet->refresh(wallet->is_trusted_daemon(), 0, blocks_fetched);
+        MINFO("BaseClientProxy::GetWalletTransactions: 'refresh()' done, blocks fetched: " << blocks_fetched);
         // incoming
         
         {
@@ -255,7 +271,8 @@ bool supernode::BaseClientProxy::GetWalletTransactions(const supernode::rpc_comm
         }
         MINFO("BaseClientProxy::GetWalletTransactions: 'pool payments' done");
         
-        storeWalletState(wallet.get());
+        if (blocks_fetched > 0)
+            storeWalletState(wallet.get());
     }
     catch (const std::exception& e)
     {
@@ -313,7 +330,7 @@ bool supernode::BaseClientProxy::CreateAccount(const supernode::rpc_command::CRE
 bool supernode::BaseClientProxy::GetSeed(const supernode::rpc_command::GET_SEED::request &in, supernode::rpc_command::GET_SEED::response &out)
 {
 	LOG_PRINT_L0("BaseClientProxy::GetSeed" << in.Account);
-    std::unique_ptr<tools::GraftWallet> wal = initWallet(base64_decode(in.Account), in.Password, false);
+    WalletSessionPool::Handle wal = acquireWallet(base64_decode(in.Account), in.Password);
     if (!wal)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -369,7 +386,7 @@ bool supernode::BaseClientProxy::RestoreAccount(const supernode::rpc_command::RE
 
 bool supernode::BaseClientProxy::GetTransferFee(const supernode::rpc_command::GET_TRANSFER_FEE::request &in, supernode::rpc_command::GET_TRANSFER_FEE::response &out)
 {
-    std::unique_ptr<tools::GraftWallet> wal = initWallet(base64_decode(in.Account), in.Password, false);
+    WalletSessionPool::Handle wal = acquireWallet(base64_decode(in.Account), in.Password);
     if (!wal)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -442,7 +459,7 @@ bool supernode::BaseClientProxy::GetTransferFee(const supernode::rpc_command::GE
 
 bool supernode::BaseClientProxy::Transfer(const supernode::rpc_command::TRANSFER::request &in, supernode::rpc_command::TRANSFER::response &out)
 {
-    std::unique_ptr<tools::GraftWallet> wal = initWallet(base64_decode(in.Account), in.Password, false);
+    WalletSessionPool::Handle wal = acquireWallet(base64_decode(in.Account), in.Password);
     if (!wal)
     {
         out.Result = ERROR_OPEN_WALLET_FAILED;
@@ -557,6 +574,13 @@ std::unique_ptr<tools::GraftWallet> supernode::BaseClientProxy::initWallet(const
     return wal;
 }
 
+supernode::WalletSessionPool::Handle supernode::BaseClientProxy::acquireWallet(const string &account, const string &password)
+{
+    return m_WalletSessions.Acquire(account, password, [this](const std::string &account, const std::string &password) {
+        return initWallet(account, password, false);
+    });
+}
+
 void supernode::BaseClientProxy::storeWalletState(tools::GraftWallet *wallet)
 {
     if (wallet)
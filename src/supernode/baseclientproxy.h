@@ -30,6 +30,7 @@
 #define BASECLIENTPROXY_H
 
 #include "BaseRTAProcessor.h"
+#include "WalletSessionPool.h"
 #include "wallet/graft_wallet.h"
 
 namespace supernode {
@@ -37,9 +38,15 @@ class BaseClientProxy : public BaseRTAProcessor
 {
 public:
     BaseClientProxy();
+    ~BaseClientProxy() override;
 
     std::unique_ptr<tools::GraftWallet> initWallet(const std::string &account, const std::string &password,
                                                    bool use_base64 = true) const;
+    /*!
+     * \brief acquireWallet - opened wallet of the account, kept resident between requests, callers refresh it
+     * \return              - empty handle if the account data or password is invalid
+     */
+    WalletSessionPool::Handle acquireWallet(const std::string &account, const std::string &password);
     void storeWalletState(tools::GraftWallet *wallet);
 
     static std::string base64_decode(const std::string &encoded_data);
@@ -49,6 +56,7 @@ public:
 
 protected:
     void Init() override;
+    void Tick() override;
 
     bool GetWalletBalance(const rpc_command::GET_WALLET_BALANCE::request &in, rpc_command::GET_WALLET_BALANCE::response &out);
     bool GetWalletTransactions(const rpc_command::GET_WALLET_TRANSACTIONS::request &in, rpc_command::GET_WALLET_TRANSACTIONS::response &out);
@@ -66,6 +74,8 @@ private:
                                   const std::string payment_id,
                                   std::vector<cryptonote::tx_destination_entry>& dsts,
                                   std::vector<uint8_t>& extra);
+
+    WalletSessionPool m_WalletSessions;
 };
 
 }
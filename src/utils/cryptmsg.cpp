@@ -28,6 +28,7 @@
 //
 
 #include <boost/endian/conversion.hpp>
+#include <cstring>
 #include "cryptmsg.h"
 #include "crypto/chacha.h"
 
@@ -48,22 +49,58 @@ inline size_t getEncryptChachaSize(size_t plainSize)
     return plainSize + sizeof(crypto::chacha_iv);
 }
 
-void encryptChacha(const uint8_t* plain, size_t plain_size, const crypto::secret_key &skey, uint8_t* cipher)
+//first 4 bytes of a v2 message; v1 message starts with plainSize which cannot be that large in practice
+constexpr uint32_t cMagicV2 = 0xFFFFFF02;
+
+constexpr size_t cKdfTagSize = 16;
+constexpr char cKdfTagX[cKdfTagSize] = "graft_msg_x_key";
+constexpr char cKdfTagData[cKdfTagSize] = "graft_msg_d_key";
+
+inline size_t getMagicSize(graft::crypto_tools::MessageFormat format)
+{
+    return format == graft::crypto_tools::MessageFormatV1 ? 0 : sizeof(cMagicV2);
+}
+
+/*!
+ * \brief generateKey - derives chacha key from 32-byte secret.
+ *
+ * v1 runs cn_slow_hash over the secret, v2 uses single keccak of domain tag and the secret,
+ * which is enough as the secrets are either random session key x or derived from ECDH secret rB.
+ */
+void generateKey(graft::crypto_tools::MessageFormat format, const char* tag, const crypto::secret_key &skey, crypto::chacha_key& key)
+{
+    if(format == graft::crypto_tools::MessageFormatV1)
+    {
+        crypto::generate_chacha_key(&skey, sizeof(skey), key, 1);
+        return;
+    }
+    static_assert(sizeof(crypto::chacha_key) <= sizeof(crypto::hash), "Size of hash must be at least that of chacha_key");
+    epee::mlocked<tools::scrubbed_arr<char, cKdfTagSize + sizeof(crypto::secret_key)>> data;
+    memcpy(data.data(), tag, cKdfTagSize);
+    memcpy(data.data() + cKdfTagSize, &skey, sizeof(skey));
+    epee::mlocked<tools::scrubbed_arr<char, crypto::HASH_SIZE>> hash;
+    crypto::cn_fast_hash(data.data(), data.size(), hash.data());
+    memcpy(&unwrap(unwrap(key)), hash.data(), sizeof(key));
+}
+
+void encryptChacha(graft::crypto_tools::MessageFormat format, const uint8_t* plain, size_t plain_size, const crypto::chacha_key &key, uint8_t* cipher)
 {
-  crypto::chacha_key key;
-  crypto::generate_chacha_key(&skey, sizeof(skey), key, 1);
   crypto::chacha_iv& iv = *reinterpret_cast<crypto::chacha_iv*>(cipher);
   iv = crypto::rand<crypto::chacha_iv>();
-  crypto::chacha8(plain, plain_size, key, iv, reinterpret_cast<char*>(cipher) + sizeof(iv));
+  if(format == graft::crypto_tools::MessageFormatV1)
+    crypto::chacha8(plain, plain_size, key, iv, reinterpret_cast<char*>(cipher) + sizeof(iv));
+  else
+    crypto::chacha20(plain, plain_size, key, iv, reinterpret_cast<char*>(cipher) + sizeof(iv));
 }
 
-void decryptChacha(const uint8_t* cipher, size_t cipher_size, const crypto::secret_key &skey, uint8_t* plain)
+void decryptChacha(graft::crypto_tools::MessageFormat format, const uint8_t* cipher, size_t cipher_size, const crypto::chacha_key &key, uint8_t* plain)
 {
   const size_t prefix_size = sizeof(crypto::chacha_iv);
-  crypto::chacha_key key;
-  crypto::generate_chacha_key(&skey, sizeof(skey), key, 1);
   const crypto::chacha_iv &iv = *reinterpret_cast<const crypto::chacha_iv*>(cipher);
-  crypto::chacha8(reinterpret_cast<const char*>(cipher) + sizeof(iv), cipher_size - prefix_size, key, iv, reinterpret_cast<char*>(plain));
+  if(format == graft::crypto_tools::MessageFormatV1)
+    crypto::chacha8(reinterpret_cast<const char*>(cipher) + sizeof(iv), cipher_size - prefix_size, key, iv, reinterpret_cast<char*>(plain));
+  else
+    crypto::chacha20(reinterpret_cast<const char*>(cipher) + sizeof(iv), cipher_size - prefix_size, key, iv, reinterpret_cast<char*>(plain));
 }
 
 constexpr uint8_t cStart = 0xA5;
@@ -118,7 +155,9 @@ uint32_t getBhash(const crypto::public_key& B)
  * where Bhash - xor of B (aka fingerprint of B, using which recipient can find his entry)
  * [rBX:+8*8] - encrypted X (aka SessionX)
  * [X] = [cstart:8][x:32*8][cend:8]
+ * Format v2 prepends [magic:32] to the structure above, and uses fast keys derivation and chacha20 (see generateKey).
  *
+ * \param format - message format to produce.
  * \param inputSize - input buffer size.
  * \param input - input buffer to encrypt.
  * \param BkeysCount - count of B keys.
@@ -129,13 +168,14 @@ uint32_t getBhash(const crypto::public_key& B)
  * returns 0 on error
  */
 
-size_t encryptMsg(size_t inputSize, const uint8_t* input, size_t BkeysCount, const crypto::public_key* Bkeys, size_t outputSize, uint8_t* output)
+size_t encryptMsg(graft::crypto_tools::MessageFormat format, size_t inputSize, const uint8_t* input, size_t BkeysCount, const crypto::public_key* Bkeys, size_t outputSize, uint8_t* output)
 {
     if(!inputSize || !BkeysCount)
         return 0;
 
     //prepare
-    size_t msgHeadSize = sizeof(CryptoMessageHead) + (BkeysCount - 1) * sizeof(XEntry);
+    size_t magicSize = getMagicSize(format);
+    size_t msgHeadSize = magicSize + sizeof(CryptoMessageHead) + (BkeysCount - 1) * sizeof(XEntry);
     size_t msgSize = msgHeadSize + getEncryptChachaSize(inputSize);
     if(outputSize < msgSize)
         return msgSize;
@@ -150,10 +190,19 @@ size_t encryptMsg(size_t inputSize, const uint8_t* input, size_t BkeysCount, con
         crypto::generate_keys(tmpX,X.x);
     }
     //chacha encrypt input with x
-    encryptChacha(input, inputSize, X.x, output + msgHeadSize);
+    {
+        crypto::chacha_key key;
+        generateKey(format, cKdfTagData, X.x, key);
+        encryptChacha(format, input, inputSize, key, output + msgHeadSize);
+    }
 
     //fill head
-    CryptoMessageHead& head = *reinterpret_cast<CryptoMessageHead*>(output);
+    if(magicSize)
+    {
+        uint32_t magic = native_to_little(cMagicV2);
+        memcpy(output, &magic, sizeof(magic));
+    }
+    CryptoMessageHead& head = *reinterpret_cast<CryptoMessageHead*>(output + magicSize);
     head.plainSize = native_to_little(uint32_t(inputSize));
     crypto::secret_key r;
     crypto::generate_keys(head.R, r);
@@ -172,7 +221,9 @@ size_t encryptMsg(size_t inputSize, const uint8_t* input, size_t BkeysCount, con
         crypto::secret_key rB;
         crypto::derivation_to_scalar(rBv, 0, rB);
         //encrypt X with rB key
-        encryptChacha(reinterpret_cast<const uint8_t*>(&X), sizeof(X), rB, xe.cipherX);
+        crypto::chacha_key key;
+        generateKey(format, cKdfTagX, rB, key);
+        encryptChacha(format, reinterpret_cast<const uint8_t*>(&X), sizeof(X), key, xe.cipherX);
     }
     return msgSize;
 }
@@ -180,6 +231,8 @@ size_t encryptMsg(size_t inputSize, const uint8_t* input, size_t BkeysCount, con
 /*!
  * \brief decryptMsg - (reverse of encryptMsg) decrypts data for one of the recipients using his secret key b.
  *
+ * Message format is detected by the leading magic, so messages of both formats can be decrypted.
+ *
  * \param inputSize - input buffer size.
  * \param input - input buffer to decrypt.
  * \param bkey - secret key corresponding to one of Bs that were used to encrypt.
@@ -193,11 +246,24 @@ size_t decryptMsg(size_t inputSize, const uint8_t* input, const crypto::secret_k
 {
     if(!input || inputSize <= sizeof(CryptoMessageHead))
         return 0;
+    //detect format
+    graft::crypto_tools::MessageFormat format = graft::crypto_tools::MessageFormatV1;
+    {
+        uint32_t magic;
+        memcpy(&magic, input, sizeof(magic));
+        if(little_to_native(magic) == cMagicV2)
+            format = graft::crypto_tools::MessageFormatV2;
+    }
+    size_t magicSize = getMagicSize(format);
+    if(inputSize <= magicSize + sizeof(CryptoMessageHead))
+        return 0;
     //prepare
-    const CryptoMessageHead& head = *reinterpret_cast<const CryptoMessageHead*>(input);
+    const CryptoMessageHead& head = *reinterpret_cast<const CryptoMessageHead*>(input + magicSize);
     size_t head_count = little_to_native(head.count);
     size_t head_plainSize = little_to_native(head.plainSize);
-    size_t msgHeadSize = sizeof(CryptoMessageHead) + ((size_t)(head_count - 1)) * sizeof(XEntry);
+    if(!head_count)
+        return 0;
+    size_t msgHeadSize = magicSize + sizeof(CryptoMessageHead) + ((size_t)(head_count - 1)) * sizeof(XEntry);
     size_t msgSize = msgHeadSize + getEncryptChachaSize(head_plainSize);
     if(inputSize < msgSize)
         return 0;
@@ -215,23 +281,34 @@ size_t decryptMsg(size_t inputSize, const uint8_t* input, const crypto::secret_k
         if(!res) return false; //corrupted key
         Bhash = getBhash(B);
     }
+    //bR key and the chacha key derived from it are the same for all entries, compute them on first match only
+    bool has_key = false;
+    crypto::chacha_key key;
     //find XEntry for B
     const XEntry* pxe = head.xentries;
     for(size_t i=0; i<head_count; ++i, ++pxe)
     {
         const XEntry& xe = *pxe;
         if(xe.Bhash != Bhash) continue;
-        //get bR key
-        crypto::key_derivation bRv;
-        crypto::generate_key_derivation(head.R, b, bRv);
-        crypto::secret_key bR;
-        crypto::derivation_to_scalar(bRv, 0, bR);
+        if(!has_key)
+        {
+            //get bR key
+            crypto::key_derivation bRv;
+            if(!crypto::generate_key_derivation(head.R, b, bRv))
+                return 0;
+            crypto::secret_key bR;
+            crypto::derivation_to_scalar(bRv, 0, bR);
+            generateKey(format, cKdfTagX, bR, key);
+            has_key = true;
+        }
         //decrypt to X
         SessionX X;
-        decryptChacha(xe.cipherX, sizeof(xe.cipherX), bR, reinterpret_cast<uint8_t*>(&X));
+        decryptChacha(format, xe.cipherX, sizeof(xe.cipherX), key, reinterpret_cast<uint8_t*>(&X));
         if(X.cstart != cStart || X.cend != cEnd) continue;
         //decrypt with session key
-        decryptChacha(input + msgHeadSize, getEncryptChachaSize(head_plainSize), X.x, output);
+        crypto::chacha_key xkey;
+        generateKey(format, cKdfTagData, X.x, xkey);
+        decryptChacha(format, input + msgHeadSize, getEncryptChachaSize(head_plainSize), xkey, output);
         return head_plainSize;
     }
     return 0;
@@ -241,24 +318,24 @@ size_t decryptMsg(size_t inputSize, const uint8_t* input, const crypto::secret_k
 
 namespace graft { namespace crypto_tools {
 
-void encryptMessage(const std::string& input, const std::vector<crypto::public_key>& Bkeys, std::string& output)
+void encryptMessage(const std::string& input, const std::vector<crypto::public_key>& Bkeys, std::string& output, MessageFormat format)
 {
     assert(!input.empty());
     //get output size
-    size_t size = encryptMsg( input.size(), nullptr, Bkeys.size(), nullptr, 0, nullptr);
+    size_t size = encryptMsg( format, input.size(), nullptr, Bkeys.size(), nullptr, 0, nullptr);
     assert(0<size);
     output.resize(size);
     //encrypt
-    size_t res = encryptMsg( input.size(), reinterpret_cast<const uint8_t*>(input.data()),
+    size_t res = encryptMsg( format, input.size(), reinterpret_cast<const uint8_t*>(input.data()),
                              Bkeys.size(), &Bkeys[0],
             output.size(), reinterpret_cast<uint8_t*>(&output[0]));
     assert(res == size);
 }
 
-void encryptMessage(const std::string& input, const crypto::public_key& Bkey, std::string& output)
+void encryptMessage(const std::string& input, const crypto::public_key& Bkey, std::string& output, MessageFormat format)
 {
     std::vector<crypto::public_key> v(1, Bkey);
-    encryptMessage(input, v, output);
+    encryptMessage(input, v, output, format);
 }
 
 bool decryptMessage(const std::string& input, const crypto::secret_key& bkey, std::string& output)
@@ -34,14 +34,27 @@
 
 namespace graft { namespace crypto_tools {
 
+/*!
+ * \brief MessageFormat - layout and key derivation of encrypted messages.
+ *
+ * decryptMessage accepts both formats. encryptMessage produces V1 by default, so the messages can be read by
+ * recipients that don't know V2 yet.
+ */
+enum MessageFormat
+{
+    MessageFormatV1 = 1, //keys derived using cn_slow_hash, chacha8
+    MessageFormatV2 = 2, //keys derived using cn_fast_hash of ECDH secret, chacha20
+};
+
 /*!
  * \brief encryptMessage - encrypts data for recipients using their B public keys (assumed public view keys).
  *
  * \param input - data to encrypt.
  * \param Bkeys - vector of B keys for each recipients.
  * \param output - resulting encripted message.
+ * \param format - format of resulting message.
  */
-void encryptMessage(const std::string& input, const std::vector<crypto::public_key>& Bkeys, std::string& output);
+void encryptMessage(const std::string& input, const std::vector<crypto::public_key>& Bkeys, std::string& output, MessageFormat format = MessageFormatV1);
 
 /*!
  * \brief encryptMessage - encrypts data for single recipient using B public keys (assumed public view key).
@@ -49,8 +62,9 @@ void encryptMessage(const std::string& input, const std::vector<crypto::public_k
  * \param input - data to encrypt.
  * \param Bkey - B keys of recipient.
  * \param output - resulting encripted message.
+ * \param format - format of resulting message.
  */
-void encryptMessage(const std::string& input, const crypto::public_key& Bkey, std::string& output);
+void encryptMessage(const std::string& input, const crypto::public_key& Bkey, std::string& output, MessageFormat format = MessageFormatV1);
 
 /*!
  * \brief decryptMessage - (reverse of encryptMessage) decrypts data for one of the recipients using his secret key b.
@@ -0,0 +1,72 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "utils/cryptmsg.h"
+
+template<bool decrypt, graft::crypto_tools::MessageFormat format, size_t recipients>
+class test_crypto_message
+{
+public:
+  static const size_t loop_count = format == graft::crypto_tools::MessageFormatV1 ? 10 : 1000;
+
+  bool init()
+  {
+    m_data.assign(1024, 'x');
+    m_Bkeys.resize(recipients);
+    m_bkeys.resize(recipients);
+    for (size_t i = 0; i < recipients; ++i)
+      crypto::generate_keys(m_Bkeys[i], m_bkeys[i]);
+    graft::crypto_tools::encryptMessage(m_data, m_Bkeys, m_message, format);
+    return true;
+  }
+
+  bool test()
+  {
+    if (!decrypt)
+    {
+      std::string message;
+      graft::crypto_tools::encryptMessage(m_data, m_Bkeys, message, format);
+      return !message.empty();
+    }
+    // the last recipient, so that all entries are probed
+    std::string plain;
+    return graft::crypto_tools::decryptMessage(m_message, m_bkeys.back(), plain) && plain == m_data;
+  }
+
+private:
+  std::string m_data;
+  std::string m_message;
+  std::vector<crypto::public_key> m_Bkeys;
+  std::vector<crypto::secret_key> m_bkeys;
+};
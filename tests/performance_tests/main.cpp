@@ -54,6 +54,7 @@
 #include "subaddress_expand.h"
 #include "sc_reduce32.h"
 #include "cn_fast_hash.h"
+#include "crypto_message.h"
 #include "rct_mlsag.h"
 #include "equality.h"
 #include "range_proof.h"
@@ -61,6 +62,8 @@
 #include "bulletproof.h"
 #include "crypto_ops.h"
 #include "multiexp.h"
+#include "stake_transaction_amount.h"
+#include "tx_intake.h"
 
 namespace po = boost::program_options;
 
@@ -190,6 +193,14 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_signature, false);
   TEST_PERFORMANCE1(filter, p, test_signature, true);
 
+  TEST_PERFORMANCE2(filter, p, test_stake_transaction_amount, 1, 2);
+  TEST_PERFORMANCE2(filter, p, test_stake_transaction_amount, 100, 2);
+  TEST_PERFORMANCE2(filter, p, test_stake_transaction_amount, 100, 16);
+
+  TEST_PERFORMANCE2(filter, p, test_tx_intake, 1, 16);
+  TEST_PERFORMANCE2(filter, p, test_tx_intake, 4, 16);
+  TEST_PERFORMANCE2(filter, p, test_tx_intake, 16, 16);
+
   TEST_PERFORMANCE2(filter, p, test_wallet2_expand_subaddresses, 50, 200);
 
   TEST_PERFORMANCE0(filter, p, test_cn_slow_hash);
@@ -199,6 +210,19 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
 
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, false, graft::crypto_tools::MessageFormatV1, 8);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, false, graft::crypto_tools::MessageFormatV2, 8);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, false, graft::crypto_tools::MessageFormatV1, 16);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, false, graft::crypto_tools::MessageFormatV2, 16);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, false, graft::crypto_tools::MessageFormatV1, 32);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, false, graft::crypto_tools::MessageFormatV2, 32);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, true, graft::crypto_tools::MessageFormatV1, 8);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, true, graft::crypto_tools::MessageFormatV2, 8);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, true, graft::crypto_tools::MessageFormatV1, 16);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, true, graft::crypto_tools::MessageFormatV2, 16);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, true, graft::crypto_tools::MessageFormatV1, 32);
+  TEST_PERFORMANCE3(filter, p, test_crypto_message, true, graft::crypto_tools::MessageFormatV2, 32);
+
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 3, false);
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 5, false);
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 10, false);
@@ -0,0 +1,101 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <vector>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "cryptonote_core/stake_transaction_processor.h"
+
+#include "multi_tx_test_base.h"
+
+// Amount decoding of a synthetic block of RCT stake transactions, as done for each stake transaction at stake re-sync
+template<size_t txes_count, size_t out_count>
+class test_stake_transaction_amount : private multi_tx_test_base<1>
+{
+  static_assert(0 < txes_count, "txes_count must be greater than 0");
+  static_assert(0 < out_count, "out_count must be greater than 0");
+
+public:
+  static const size_t loop_count = 1000 / txes_count + 10;
+
+  typedef multi_tx_test_base<1> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    m_supernode.generate();
+    m_expected_amount = m_source_amount / out_count * out_count;
+
+    std::vector<tx_destination_entry> destinations;
+    for (size_t i = 0; i < out_count; ++i)
+      destinations.push_back(tx_destination_entry(m_source_amount / out_count, m_supernode.get_keys().m_account_address, false));
+
+    std::unordered_map<crypto::public_key, subaddress_index> subaddresses;
+    subaddresses[m_miners[real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+
+    for (size_t i = 0; i < txes_count; ++i)
+    {
+      stake_tx stake;
+      std::vector<crypto::secret_key> additional_tx_keys;
+      if (!construct_tx_and_get_tx_key(m_miners[real_source_idx].get_keys(), subaddresses, m_sources, destinations, account_public_address{},
+            std::vector<uint8_t>(), stake.tx, 0, stake.tx_key, additional_tx_keys, true, rct::RangeProofPaddedBulletproof))
+        return false;
+      m_txes.push_back(stake);
+    }
+
+    return true;
+  }
+
+  bool test()
+  {
+    for (const stake_tx &stake : m_txes)
+      if (cryptonote::get_stake_transaction_amount(stake.tx, m_supernode.get_keys().m_account_address, stake.tx_key) != m_expected_amount)
+        return false;
+    return true;
+  }
+
+private:
+  struct stake_tx
+  {
+    cryptonote::transaction tx;
+    crypto::secret_key tx_key;
+  };
+
+  cryptonote::account_base m_supernode;
+  std::vector<stake_tx> m_txes;
+  uint64_t m_expected_amount;
+};
@@ -0,0 +1,114 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "common/threadpool.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+
+#include "multi_tx_test_base.h"
+
+// Mempool intake of a NOTIFY_NEW_TRANSACTIONS batch up to the pool insertion: parallel parse and per tx
+// semantics on a thread pool of the given size, then one batched RCT semantics check over the whole batch
+template<size_t threads, size_t txes_count>
+class test_tx_intake : private multi_tx_test_base<1>
+{
+  static_assert(0 < threads, "threads must be greater than 0");
+  static_assert(0 < txes_count, "txes_count must be greater than 0");
+
+public:
+  static const size_t loop_count = 1000 / txes_count + 10;
+
+  typedef multi_tx_test_base<1> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    m_tpool.reset(tools::threadpool::getNewForUnitTests(threads));
+
+    account_base receiver;
+    receiver.generate();
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(m_source_amount / 2, receiver.get_keys().m_account_address, false));
+    destinations.push_back(tx_destination_entry(m_source_amount - m_source_amount / 2, receiver.get_keys().m_account_address, false));
+
+    std::unordered_map<crypto::public_key, subaddress_index> subaddresses;
+    subaddresses[m_miners[real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+
+    for (size_t i = 0; i < txes_count; ++i)
+    {
+      transaction tx;
+      crypto::secret_key tx_key;
+      std::vector<crypto::secret_key> additional_tx_keys;
+      if (!construct_tx_and_get_tx_key(m_miners[real_source_idx].get_keys(), subaddresses, m_sources, destinations, account_public_address{},
+            std::vector<uint8_t>(), tx, 0, tx_key, additional_tx_keys, true, rct::RangeProofPaddedBulletproof))
+        return false;
+      m_blobs.push_back(tx_to_blob(tx));
+    }
+
+    return true;
+  }
+
+  bool test()
+  {
+    std::vector<cryptonote::transaction> txes(m_blobs.size());
+    std::vector<uint8_t> parsed(m_blobs.size(), false);
+    tools::threadpool::waiter waiter;
+    for (size_t i = 0; i < m_blobs.size(); ++i)
+    {
+      m_tpool->submit(&waiter, [this, &txes, &parsed, i] {
+        parsed[i] = cryptonote::parse_and_validate_tx_from_blob(m_blobs[i], txes[i]) && cryptonote::check_rct_semantics_unbatched(txes[i]);
+      });
+    }
+    waiter.wait(m_tpool.get());
+
+    std::vector<const rct::rctSig*> rvv;
+    for (size_t i = 0; i < txes.size(); ++i)
+    {
+      if (!parsed[i])
+        return false;
+      rvv.push_back(&txes[i].rct_signatures);
+    }
+    std::vector<uint8_t> valid;
+    return cryptonote::verify_rct_semantics_batch(rvv, valid);
+  }
+
+private:
+  std::unique_ptr<tools::threadpool> m_tpool;
+  std::vector<cryptonote::blobdata> m_blobs;
+};
@@ -921,9 +921,13 @@ TEST_F(FSNServantTest, GetBalance1)
     FSN_WalletData wallet1("T6T2LeLmi6hf58g7MeTA8i4rdbVY8WngXBK3oWS7pjjq9qPbcze1gvV32x7GaHx8uWHQGNFBy1JCY1qBofv56Vwb26Xr998SE",
                            "0ae7176e5332974de64713c329d406956e8ff2fd60c85e7ee6d8c88318111007");
 
-    uint64_t balance_10block = fsns->GetWalletBalance(10, wallet1);
+    uint64_t balance_10block = 0, balance_50block = 0;
+    // first call starts tracking of the account, wait until it is scanned up to the height
+    for (int i = 0; i < 600 && !fsns->GetWalletBalance(50, wallet1, balance_50block); ++i)
+        sleep(1);
+    ASSERT_TRUE(fsns->GetWalletBalance(10, wallet1, balance_10block));
     ASSERT_TRUE(balance_10block > 0);
-    uint64_t balance_50block = fsns->GetWalletBalance(50, wallet1);
+    ASSERT_TRUE(fsns->GetWalletBalance(50, wallet1, balance_50block));
     ASSERT_TRUE(balance_50block > 0);
     ASSERT_TRUE(balance_10block < balance_50block);
 
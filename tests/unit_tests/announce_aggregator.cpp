@@ -0,0 +1,108 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include "p2p/announce_aggregator.h"
+
+using namespace nodetool;
+
+namespace
+{
+
+COMMAND_SUPERNODE_ANNOUNCE::request make_announce(const std::string& id, uint64_t height, uint64_t hop)
+{
+  COMMAND_SUPERNODE_ANNOUNCE::request announce;
+  announce.supernode_public_id = id;
+  announce.height = height;
+  announce.hop = hop;
+  return announce;
+}
+
+}
+
+TEST(announce_aggregator, takes_queued_announces)
+{
+  announce_aggregator aggregator;
+  std::vector<announce_aggregator::announce> batch;
+
+  EXPECT_FALSE(aggregator.take(batch));
+
+  EXPECT_TRUE(aggregator.add(make_announce("a", 10, 1), "relay a"));
+  EXPECT_TRUE(aggregator.add(make_announce("b", 10, 1), std::string()));
+  EXPECT_TRUE(aggregator.add(make_announce("a", 11, 1), "relay a 11"));
+
+  ASSERT_TRUE(aggregator.take(batch));
+  ASSERT_EQ(batch.size(), 3);
+  EXPECT_EQ(batch[0].request.supernode_public_id, "a");
+  EXPECT_EQ(batch[0].relay_blob, "relay a");
+  EXPECT_EQ(batch[1].request.supernode_public_id, "b");
+  EXPECT_TRUE(batch[1].relay_blob.empty());
+  EXPECT_EQ(batch[2].request.height, 11);
+
+  EXPECT_FALSE(aggregator.take(batch));
+  EXPECT_TRUE(batch.empty());
+}
+
+TEST(announce_aggregator, deduplicates_by_id_and_height)
+{
+  announce_aggregator aggregator;
+  std::vector<announce_aggregator::announce> batch;
+
+  EXPECT_TRUE(aggregator.add(make_announce("a", 10, 3), "hop 3"));
+  EXPECT_FALSE(aggregator.add(make_announce("a", 10, 5), "hop 5"));
+  EXPECT_FALSE(aggregator.add(make_announce("a", 10, 2), "hop 2"));
+
+  ASSERT_TRUE(aggregator.take(batch));
+  ASSERT_EQ(batch.size(), 1);
+  EXPECT_EQ(batch[0].request.hop, 2);
+  EXPECT_EQ(batch[0].relay_blob, "hop 2");
+
+  // duplicates are detected within a batch only
+  EXPECT_TRUE(aggregator.add(make_announce("a", 10, 2), "hop 2"));
+
+  announce_aggregator_stats stats = aggregator.get_stats();
+  EXPECT_EQ(stats.aggregated, 2);
+  EXPECT_EQ(stats.deduplicated, 2);
+  EXPECT_EQ(stats.batches, 1);
+}
+
+TEST(announce_aggregator, counts_saved_messages)
+{
+  announce_aggregator aggregator;
+
+  aggregator.add_saved_messages(4, 100);
+  aggregator.add_saved_messages(1, 20);
+  aggregator.add_saved_posts(7);
+
+  announce_aggregator_stats stats = aggregator.get_stats();
+  EXPECT_EQ(stats.messages_saved, 5);
+  EXPECT_EQ(stats.bytes_saved, 120);
+  EXPECT_EQ(stats.posts_saved, 7);
+}
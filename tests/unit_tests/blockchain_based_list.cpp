@@ -0,0 +1,380 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+
+#include <set>
+#include <tuple>
+
+#include "cryptonote_core/blockchain_based_list.h"
+#include "file_io_utils.h"
+#include "graft_rta_config.h"
+#include "serialization/binary_utils.h"
+#include "string_tools.h"
+
+using namespace cryptonote;
+
+namespace
+{
+
+const uint64_t FIRST_BLOCK = 100;
+const size_t HISTORY_MAX_DEPTH = 1000; //lists of older blocks are dropped from the history
+
+crypto::hash make_hash(uint64_t n)
+{
+  crypto::hash hash = crypto::null_hash;
+  memcpy(hash.data, &n, sizeof(n));
+  return hash;
+}
+
+BlockchainBasedList::supernode make_supernode(const std::string& id, uint64_t amount)
+{
+  BlockchainBasedList::supernode sn = AUTO_VAL_INIT(sn);
+  memcpy(sn.supernode_public_id.data, id.data(), std::min(id.size(), sizeof(sn.supernode_public_id.data)));
+  sn.amount = amount;
+  sn.block_height = FIRST_BLOCK;
+  sn.unlock_time = 1000;
+  return sn;
+}
+
+bool equal_tiers(const BlockchainBasedList::supernode_tier_array& tiers1, const BlockchainBasedList::supernode_tier_array& tiers2)
+{
+  if (tiers1.size() != tiers2.size())
+    return false;
+
+  for (size_t i=0; i<tiers1.size(); i++)
+  {
+    if (tiers1[i].size() != tiers2[i].size())
+      return false;
+
+    for (size_t j=0; j<tiers1[i].size(); j++)
+    {
+      const BlockchainBasedList::supernode& sn1 = tiers1[i][j];
+      const BlockchainBasedList::supernode& sn2 = tiers2[i][j];
+
+      if (sn1.supernode_public_id != sn2.supernode_public_id || sn1.supernode_public_address != sn2.supernode_public_address ||
+          sn1.amount != sn2.amount || sn1.block_height != sn2.block_height || sn1.unlock_time != sn2.unlock_time)
+        return false;
+    }
+  }
+
+  return true;
+}
+
+class BlockchainBasedListTest : public ::testing::Test
+{
+protected:
+  BlockchainBasedListTest()
+    : file_name((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string())
+    , legacy_file_name(file_name + ".legacy")
+    , stakes(file_name + ".stakes", FIRST_BLOCK)
+  {
+  }
+
+  ~BlockchainBasedListTest()
+  {
+    boost::filesystem::remove(file_name);
+    boost::filesystem::remove(legacy_file_name);
+    boost::filesystem::remove(file_name + ".stakes");
+  }
+
+    //each block stakes a few new supernodes, so lists of the next blocks both keep and add supernodes
+
+  void add_block(BlockchainBasedList& list)
+  {
+    uint64_t height = stakes.get_last_processed_block_index() + 1;
+
+    if (height % 3 == 0)
+    {
+      for (size_t i=0; i<4; i++)
+      {
+        stake_transaction tx = AUTO_VAL_INIT(tx);
+        tx.hash = make_hash(height * 10 + i);
+        tx.amount = config::graft::TIER1_STAKE_AMOUNT * (1 + i);
+        tx.block_height = height;
+        tx.unlock_time = 200;
+        std::string id = std::to_string(height) + "-" + std::to_string(i);
+        memcpy(tx.supernode_public_id.data, id.data(), id.size());
+        stakes.add_tx(tx);
+      }
+    }
+
+    stakes.add_last_processed_block(height, make_hash(height));
+    list.apply_block(height, make_hash(height), stakes);
+  }
+
+  static std::vector<BlockchainBasedList::supernode_tier_array> get_history(const BlockchainBasedList& list)
+  {
+    std::vector<BlockchainBasedList::supernode_tier_array> history;
+    for (size_t depth=0; depth<list.history_depth(); depth++)
+      history.push_back(*list.tiers(depth));
+    return history;
+  }
+
+  static size_t count_distinct_supernodes(const std::vector<BlockchainBasedList::supernode_tier_array>& history)
+  {
+    std::set<std::tuple<std::string, std::string, uint64_t, uint64_t, uint64_t>> supernodes;
+    for (const BlockchainBasedList::supernode_tier_array& tiers : history)
+      for (const BlockchainBasedList::supernode_array& tier : tiers)
+        for (const BlockchainBasedList::supernode& sn : tier)
+          supernodes.emplace(epee::string_tools::pod_to_hex(sn.supernode_public_id), epee::string_tools::pod_to_hex(sn.supernode_public_address),
+            sn.amount, sn.block_height, sn.unlock_time);
+    return supernodes.size();
+  }
+
+  static bool equal_history(const BlockchainBasedList& list, const std::vector<BlockchainBasedList::supernode_tier_array>& history)
+  {
+    if (list.history_depth() != history.size())
+      return false;
+    for (size_t depth=0; depth<history.size(); depth++)
+      if (!equal_tiers(*list.tiers(depth), history[depth]))
+        return false;
+    return true;
+  }
+
+  std::string file_name;
+  std::string legacy_file_name;
+  StakeTransactionStorage stakes;
+};
+
+//layout of the list file before the append-only log
+struct legacy_file_data
+{
+  uint64_t block_height;
+  size_t history_depth;
+  BlockchainBasedList::list_history history;
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(block_height)
+    FIELD(history_depth)
+    FIELD(history)
+  END_SERIALIZE()
+};
+
+}
+
+TEST_F(BlockchainBasedListTest, replays_stored_blocks)
+{
+  std::vector<BlockchainBasedList::supernode_tier_array> history;
+
+  {
+    BlockchainBasedList list(file_name, FIRST_BLOCK);
+
+    for (size_t i=0; i<50; i++)
+    {
+      add_block(list);
+      if (i % 7 == 0)
+        list.store();
+    }
+
+    list.remove_latest_block();
+    stakes.remove_last_processed_block();
+    list.remove_latest_block();
+    stakes.remove_last_processed_block();
+    add_block(list);
+    list.store();
+
+    EXPECT_FALSE(list.need_store());
+
+    history = get_history(list);
+
+    add_block(list); //not stored
+  }
+
+  BlockchainBasedList list(file_name, FIRST_BLOCK);
+
+  EXPECT_EQ(list.block_height(), FIRST_BLOCK + 49);
+  EXPECT_FALSE(list.need_store());
+  ASSERT_TRUE(equal_history(list, history));
+
+  size_t supernodes_count = 0;
+  for (const BlockchainBasedList::supernode_array& tier : *list.tiers())
+    supernodes_count += tier.size();
+  EXPECT_GT(supernodes_count, 0);
+}
+
+TEST_F(BlockchainBasedListTest, replays_compacted_log)
+{
+  std::vector<BlockchainBasedList::supernode_tier_array> history;
+
+  {
+    BlockchainBasedList list(file_name, FIRST_BLOCK);
+
+    for (size_t i=0; i<1100; i++)
+    {
+      add_block(list);
+      if (i % 10 == 0)
+        list.store();
+    }
+
+    list.store();
+
+    history = get_history(list);
+  }
+
+  BlockchainBasedList list(file_name, FIRST_BLOCK);
+
+  EXPECT_EQ(list.block_height(), FIRST_BLOCK + 1100);
+  ASSERT_TRUE(equal_history(list, history));
+}
+
+TEST_F(BlockchainBasedListTest, migrates_legacy_file)
+{
+  legacy_file_data data = AUTO_VAL_INIT(data);
+  data.block_height = FIRST_BLOCK + 2;
+  data.history_depth = 2;
+
+  BlockchainBasedList::supernode_tier_array tiers(config::graft::TIERS_COUNT);
+  tiers[0].push_back(make_supernode("a", config::graft::TIER1_STAKE_AMOUNT));
+  data.history.push_back(tiers);
+  tiers[1].push_back(make_supernode("b", config::graft::TIER2_STAKE_AMOUNT));
+  data.history.push_back(tiers);
+
+  std::string blob;
+  ASSERT_TRUE(::serialization::dump_binary(data, blob));
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(legacy_file_name, blob));
+
+  {
+    BlockchainBasedList list(file_name, FIRST_BLOCK, legacy_file_name);
+
+    EXPECT_EQ(list.block_height(), FIRST_BLOCK + 2);
+    ASSERT_EQ(list.history_depth(), 2);
+    EXPECT_TRUE(equal_tiers(*list.tiers(0), data.history.back()));
+    EXPECT_TRUE(equal_tiers(*list.tiers(1), data.history.front()));
+    EXPECT_FALSE(boost::filesystem::exists(legacy_file_name));
+    EXPECT_FALSE(list.need_store());
+  }
+
+  BlockchainBasedList list(file_name, FIRST_BLOCK, legacy_file_name);
+
+  EXPECT_EQ(list.block_height(), FIRST_BLOCK + 2);
+  ASSERT_EQ(list.history_depth(), 2);
+  EXPECT_TRUE(equal_tiers(*list.tiers(0), data.history.back()));
+  EXPECT_TRUE(equal_tiers(*list.tiers(1), data.history.front()));
+}
+
+TEST_F(BlockchainBasedListTest, keeps_latest_lists_in_ring_buffer)
+{
+  const size_t history_size = HISTORY_MAX_DEPTH;
+  const size_t blocks_count = history_size + 150;
+
+  BlockchainBasedList list(file_name, FIRST_BLOCK);
+  std::vector<BlockchainBasedList::supernode_tier_array> lists;
+
+  for (size_t i=0; i<blocks_count; i++)
+  {
+    BlockchainBasedList::supernode_tier_array_ptr prev_tiers = list.history_depth() ? list.tiers() : nullptr;
+
+    add_block(list);
+
+    lists.push_back(*list.tiers());
+
+    EXPECT_TRUE(list.tiers() == list.tiers());
+    if (prev_tiers && list.history_depth() > 1)
+      EXPECT_TRUE(list.tiers(1) == prev_tiers);
+  }
+
+  EXPECT_EQ(list.block_height(), FIRST_BLOCK + blocks_count);
+  ASSERT_EQ(list.history_depth(), history_size);
+
+  for (size_t depth=0; depth<history_size; depth++)
+    ASSERT_TRUE(equal_tiers(*list.tiers(depth), lists[blocks_count - 1 - depth])) << "depth " << depth;
+
+  EXPECT_THROW(list.tiers(history_size), std::runtime_error);
+}
+
+TEST_F(BlockchainBasedListTest, shares_supernodes_between_lists)
+{
+  BlockchainBasedList list(file_name, FIRST_BLOCK);
+
+  for (size_t i=0; i<HISTORY_MAX_DEPTH + 50; i++)
+  {
+    add_block(list);
+
+    if (i % 97 == 0)
+      EXPECT_EQ(list.supernodes_count(), count_distinct_supernodes(get_history(list)));
+  }
+
+  std::vector<BlockchainBasedList::supernode_tier_array> history = get_history(list);
+
+  EXPECT_GT(list.supernodes_count(), 0);
+  EXPECT_EQ(list.supernodes_count(), count_distinct_supernodes(history));
+
+  size_t entries_count = 0;
+  for (const BlockchainBasedList::supernode_tier_array& tiers : history)
+    for (const BlockchainBasedList::supernode_array& tier : tiers)
+      entries_count += tier.size();
+  EXPECT_LT(list.supernodes_count(), entries_count);
+
+  while (list.history_depth())
+  {
+    list.remove_latest_block();
+    EXPECT_EQ(list.supernodes_count(), count_distinct_supernodes(get_history(list)));
+  }
+
+  EXPECT_EQ(list.supernodes_count(), 0);
+}
+
+TEST_F(BlockchainBasedListTest, removes_latest_block)
+{
+  BlockchainBasedList list(file_name, FIRST_BLOCK);
+
+  for (size_t i=0; i<30; i++)
+    add_block(list);
+
+  std::vector<BlockchainBasedList::supernode_tier_array> history = get_history(list);
+
+  list.remove_latest_block();
+  stakes.remove_last_processed_block();
+
+  EXPECT_EQ(list.block_height(), FIRST_BLOCK + 29);
+  ASSERT_EQ(list.history_depth(), 29);
+  EXPECT_TRUE(equal_tiers(*list.tiers(), history[1]));
+  EXPECT_TRUE(equal_history(list, std::vector<BlockchainBasedList::supernode_tier_array>(history.begin() + 1, history.end())));
+
+    //list of the same block is built again after the removal
+
+  add_block(list);
+
+  EXPECT_EQ(list.block_height(), FIRST_BLOCK + 30);
+  EXPECT_TRUE(equal_history(list, history));
+
+  while (list.history_depth())
+    list.remove_latest_block();
+
+  EXPECT_EQ(list.block_height(), FIRST_BLOCK);
+  EXPECT_THROW(list.tiers(), std::runtime_error);
+
+  list.remove_latest_block(); //no effect on empty list
+
+  EXPECT_EQ(list.block_height(), FIRST_BLOCK);
+  EXPECT_EQ(list.history_depth(), 0);
+}
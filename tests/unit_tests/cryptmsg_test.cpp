@@ -72,3 +72,77 @@ TEST(Utils, cryptoMessage)
         EXPECT_EQ(res, false);
     }
 }
+
+TEST(Utils, cryptoMessageV2)
+{
+    using namespace crypto;
+
+    std::vector<public_key> vec_B;
+    std::vector<secret_key> vec_b;
+    for(int i = 0; i < 10; ++i)
+    {
+        public_key B; secret_key b;
+        generate_keys(B,b);
+        vec_B.emplace_back(std::move(B)); vec_b.emplace_back(std::move(b));
+    }
+
+    std::string data = "12345qwertasdfgzxcvb";
+    std::string message;
+    graft::crypto_tools::encryptMessage(data, vec_B, message, graft::crypto_tools::MessageFormatV2);
+
+    for(const auto& b : vec_b)
+    {
+        std::string plain;
+        bool res = graft::crypto_tools::decryptMessage(message, b, plain);
+        EXPECT_EQ(res, true);
+        EXPECT_EQ(plain, data);
+    }
+
+    {//unknown key
+        public_key B; secret_key b;
+        generate_keys(B,b);
+
+        std::string plain;
+        bool res = graft::crypto_tools::decryptMessage(message, b, plain);
+        EXPECT_EQ(res, false);
+    }
+    {//corrupted key
+        secret_key b = vec_b[0];
+        b.data[ sizeof(b.data) - 1] ^= 0xFF;
+
+        std::string plain;
+        bool res = graft::crypto_tools::decryptMessage(message, b, plain);
+        EXPECT_EQ(res, false);
+    }
+}
+
+TEST(Utils, cryptoMessageFormats)
+{
+    using namespace crypto;
+
+    public_key B; secret_key b;
+    generate_keys(B,b);
+
+    std::string data = "12345qwertasdfgzxcvb";
+    std::string v1, v2;
+    graft::crypto_tools::encryptMessage(data, B, v1, graft::crypto_tools::MessageFormatV1);
+    graft::crypto_tools::encryptMessage(data, B, v2, graft::crypto_tools::MessageFormatV2);
+    EXPECT_EQ(v2.size(), v1.size() + sizeof(uint32_t));
+
+    {//V1 is produced by default
+        std::string v;
+        graft::crypto_tools::encryptMessage(data, B, v);
+        EXPECT_EQ(v.size(), v1.size());
+    }
+
+    std::string plain;
+    EXPECT_TRUE(graft::crypto_tools::decryptMessage(v1, b, plain));
+    EXPECT_EQ(plain, data);
+    EXPECT_TRUE(graft::crypto_tools::decryptMessage(v2, b, plain));
+    EXPECT_EQ(plain, data);
+
+    {//truncated message
+        std::string truncated = v2.substr(0, v2.size() - 1);
+        EXPECT_FALSE(graft::crypto_tools::decryptMessage(truncated, b, plain));
+    }
+}
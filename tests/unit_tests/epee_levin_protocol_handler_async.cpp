@@ -414,6 +414,36 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_TRUE(conn->last_send_data().empty());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_sends_shared_notify_frame)
+{
+  // Setup
+  const int expected_command = 4673262;
+
+  test_connection_ptr conn = create_connection();
+
+  std::string in_data(256, 'f');
+
+  epee::levin::bucket_head2 req_head = {0};
+  req_head.m_signature = LEVIN_SIGNATURE;
+  req_head.m_cb = in_data.size();
+  req_head.m_have_to_return_data = false;
+  req_head.m_command = expected_command;
+  req_head.m_flags = LEVIN_PACKET_REQUEST;
+  req_head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+
+  std::string expected_buf(reinterpret_cast<const char*>(&req_head), sizeof(req_head));
+  expected_buf += in_data;
+
+  // Test
+  const epee::net_utils::shared_buffer frame = epee::levin::make_notify_frame(expected_command, in_data);
+  ASSERT_EQ(expected_buf, *frame);
+  ASSERT_EQ(1, m_handler_config.notify(frame, conn->m_protocol_handler.get_connection_id()));
+
+  // Check connection sent whole frame at once
+  ASSERT_EQ(1, conn->send_counter());
+  ASSERT_EQ(expected_buf, conn->last_send_data());
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_qued_callback)
 {
   test_connection_ptr conn = create_connection();
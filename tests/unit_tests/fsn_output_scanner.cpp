@@ -0,0 +1,269 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_config.h"
+#include "device/device.hpp"
+#include "string_tools.h"
+#include "supernode/FSN_OutputScanner.h"
+
+using namespace supernode;
+
+namespace
+{
+
+class FSN_OutputScannerTest : public ::testing::Test
+{
+protected:
+  FSN_OutputScannerTest()
+  {
+    account.generate();
+    other_account.generate();
+    address = get_address(account);
+  }
+
+  static std::string get_address(const cryptonote::account_base& acc)
+  {
+    return cryptonote::get_account_address_as_str(cryptonote::MAINNET, false, acc.get_keys().m_account_address);
+  }
+
+  static FSN_WalletData get_wallet_data(const cryptonote::account_base& acc)
+  {
+    return FSN_WalletData(get_address(acc), epee::string_tools::pod_to_hex(acc.get_keys().m_view_secret_key));
+  }
+
+  static cryptonote::transaction make_tx(const cryptonote::account_base& acc, uint64_t amount, uint64_t unlock_time = 0)
+  {
+    const cryptonote::account_public_address& addr = acc.get_keys().m_account_address;
+    const cryptonote::keypair tx_key = cryptonote::keypair::generate(hw::get_device("default"));
+
+    cryptonote::transaction tx;
+    tx.version = 1;
+    tx.unlock_time = unlock_time;
+    cryptonote::add_tx_pub_key_to_extra(tx, tx_key.pub);
+
+    crypto::key_derivation derivation;
+    crypto::public_key out_key;
+    EXPECT_TRUE(crypto::generate_key_derivation(addr.m_view_public_key, tx_key.sec, derivation));
+    EXPECT_TRUE(crypto::derive_public_key(derivation, 0, addr.m_spend_public_key, out_key));
+
+    cryptonote::tx_out out;
+    out.amount = amount;
+    out.target = cryptonote::txout_to_key(out_key);
+    tx.vout.push_back(out);
+    return tx;
+  }
+
+  static cryptonote::block make_block(uint64_t height)
+  {
+    cryptonote::block b;
+    b.major_version = 1;
+    b.minor_version = 0;
+    b.timestamp = height;
+    b.prev_id = crypto::null_hash;
+    b.nonce = static_cast<uint32_t>(height);
+    b.miner_tx.version = 1;
+    b.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+    return b;
+  }
+
+  void process_blocks(uint64_t from, uint64_t to, const std::map<uint64_t, std::vector<cryptonote::transaction>>& txs = {})
+  {
+    for (uint64_t height = from; height < to; ++height)
+    {
+      const auto it = txs.find(height);
+      scanner.ProcessBlock(height, make_block(height), it != txs.end() ? it->second : std::vector<cryptonote::transaction>());
+    }
+  }
+
+  // unlocked balance of the account, -1 if it is not known at the height
+  static int64_t unlocked_balance(const FSN_OutputScanner& scanner, const std::string& addr, uint64_t height)
+  {
+    uint64_t balance = 0;
+    return scanner.UnlockedBalance(addr, height, balance) ? int64_t(balance) : -1;
+  }
+
+  int64_t unlocked_balance(const std::string& addr, uint64_t height) const
+  {
+    return unlocked_balance(scanner, addr, height);
+  }
+
+  cryptonote::account_base account;
+  cryptonote::account_base other_account;
+  std::string address;
+  FSN_OutputScanner scanner;
+};
+
+}
+
+TEST_F(FSN_OutputScannerTest, finds_account_outputs)
+{
+  ASSERT_TRUE(scanner.AddAccount(get_wallet_data(account)));
+  EXPECT_TRUE(scanner.HasAccount(address));
+  EXPECT_EQ(scanner.ScanHeight(), 0);
+
+  std::map<uint64_t, std::vector<cryptonote::transaction>> txs;
+  txs[2] = {make_tx(account, 100), make_tx(other_account, 1000)};
+  txs[4] = {make_tx(account, 20)};
+  process_blocks(0, 6, txs);
+
+  EXPECT_EQ(scanner.ScanHeight(), 6);
+  EXPECT_EQ(scanner.Balance(address), 120);
+  EXPECT_EQ(scanner.Balance(get_address(other_account)), 0);
+
+  // block of other height is ignored
+  scanner.ProcessBlock(2, make_block(2), txs[2]);
+  EXPECT_EQ(scanner.Balance(address), 120);
+  EXPECT_EQ(scanner.ScanHeight(), 6);
+}
+
+TEST_F(FSN_OutputScannerTest, scans_added_account_from_start)
+{
+  ASSERT_TRUE(scanner.AddAccount(get_wallet_data(other_account)));
+
+  std::map<uint64_t, std::vector<cryptonote::transaction>> txs;
+  txs[1] = {make_tx(account, 7)};
+  process_blocks(0, 3, txs);
+  EXPECT_EQ(scanner.Balance(get_address(other_account)), 0);
+
+  ASSERT_TRUE(scanner.AddAccount(get_wallet_data(account)));
+  EXPECT_EQ(scanner.ScanHeight(), 0);
+  process_blocks(0, 3, txs);
+  EXPECT_EQ(scanner.ScanHeight(), 3);
+  EXPECT_EQ(scanner.Balance(address), 7);
+
+  EXPECT_TRUE(scanner.RemoveAccount(address));
+  EXPECT_EQ(scanner.Balance(address), 0);
+  EXPECT_FALSE(scanner.AddAccount(FSN_WalletData(address, std::string(64, '0'))));
+}
+
+TEST_F(FSN_OutputScannerTest, rolls_back_blocks)
+{
+  ASSERT_TRUE(scanner.AddAccount(get_wallet_data(account)));
+
+  std::map<uint64_t, std::vector<cryptonote::transaction>> txs;
+  txs[1] = {make_tx(account, 1)};
+  txs[3] = {make_tx(account, 10)};
+  txs[5] = {make_tx(account, 100)};
+  process_blocks(0, 30, txs);
+  EXPECT_EQ(scanner.Balance(address), 111);
+  EXPECT_EQ(unlocked_balance(address, 30), 111);
+
+  scanner.Rollback(3);
+  EXPECT_EQ(scanner.ScanHeight(), 3);
+  EXPECT_EQ(scanner.Balance(address), 1);
+  EXPECT_EQ(unlocked_balance(address, 3), 0);
+
+  // another chain from the rollback height
+  txs.erase(5);
+  txs[4] = {make_tx(account, 1000)};
+  process_blocks(3, 30, txs);
+  EXPECT_EQ(scanner.Balance(address), 1011);
+  EXPECT_EQ(unlocked_balance(address, 30), 1011);
+
+  // rollback above the scan height does nothing
+  scanner.Rollback(40);
+  EXPECT_EQ(scanner.ScanHeight(), 30);
+  EXPECT_EQ(scanner.Balance(address), 1011);
+}
+
+TEST_F(FSN_OutputScannerTest, unlocks_balance_by_height)
+{
+  ASSERT_TRUE(scanner.AddAccount(get_wallet_data(account)));
+
+  const uint64_t unlock_height = 40;
+  std::map<uint64_t, std::vector<cryptonote::transaction>> txs;
+  txs[2] = {make_tx(account, 1)};
+  txs[5] = {make_tx(account, 10, unlock_height)};
+  process_blocks(0, 8, txs);
+
+  EXPECT_EQ(unlocked_balance("unknown", 100), -1);
+
+  // heights below the scan height are computed from outputs
+  EXPECT_EQ(unlocked_balance(address, 2), 0);
+  EXPECT_EQ(unlocked_balance(address, 7), 0);
+  EXPECT_EQ(unlocked_balance(address, 8), 0);
+  // blocks below heights above the scan height are not scanned yet
+  EXPECT_EQ(unlocked_balance(address, 9), -1);
+  EXPECT_EQ(unlocked_balance(address, 50), -1);
+
+  process_blocks(8, 20);
+  EXPECT_EQ(unlocked_balance(address, 20), 1);
+  EXPECT_EQ(unlocked_balance(address, 2 + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE), 1);
+  EXPECT_EQ(unlocked_balance(address, 2 + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE - 1), 0);
+
+  process_blocks(20, 50);
+  EXPECT_EQ(unlocked_balance(address, unlock_height - CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS), 1);
+  EXPECT_EQ(unlocked_balance(address, unlock_height - CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS + 1), 11);
+  EXPECT_EQ(unlocked_balance(address, 50), 11);
+  EXPECT_EQ(scanner.Balance(address), 11);
+}
+
+TEST_F(FSN_OutputScannerTest, continues_from_stored_state)
+{
+  const boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  ASSERT_TRUE(boost::filesystem::create_directories(dir));
+  scanner.SetStateDir(dir.string());
+  ASSERT_TRUE(scanner.AddAccount(get_wallet_data(account)));
+
+  std::map<uint64_t, std::vector<cryptonote::transaction>> txs;
+  txs[2] = {make_tx(account, 1)};
+  txs[5] = {make_tx(account, 10, 40)};
+  process_blocks(0, 30, txs);
+  scanner.Store();
+
+  {
+    FSN_OutputScanner restarted;
+    restarted.SetStateDir(dir.string());
+    ASSERT_TRUE(restarted.AddAccount(get_wallet_data(account)));
+    EXPECT_EQ(restarted.ScanHeight(), 30);
+    EXPECT_EQ(restarted.Balance(address), 11);
+    EXPECT_EQ(unlocked_balance(restarted, address, 30), 1);
+    EXPECT_EQ(unlocked_balance(restarted, address, 31), -1);
+
+    // account without stored state is scanned from the start
+    ASSERT_TRUE(restarted.AddAccount(get_wallet_data(other_account)));
+    EXPECT_EQ(restarted.ScanHeight(), 0);
+  }
+
+  {
+    // scanner without the state directory doesn't load it
+    FSN_OutputScanner in_memory;
+    ASSERT_TRUE(in_memory.AddAccount(get_wallet_data(account)));
+    EXPECT_EQ(in_memory.ScanHeight(), 0);
+  }
+
+  boost::filesystem::remove_all(dir);
+}
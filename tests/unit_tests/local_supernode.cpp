@@ -0,0 +1,162 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include <boost/asio.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "p2p/local_supernode.h"
+
+using namespace nodetool;
+
+namespace
+{
+
+// accepts a single connection and never responds, so the request in flight stays in flight
+class silent_server
+{
+public:
+  silent_server()
+    : m_acceptor(m_io, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+    , m_socket(m_io)
+  {
+    m_acceptor.async_accept(m_socket, [](const boost::system::error_code&) {});
+    m_thread = boost::thread([this] { m_io.run(); });
+  }
+
+  ~silent_server() { stop(); }
+
+  uint16_t port() const { return m_acceptor.local_endpoint().port(); }
+
+  // closes the connection, the request in flight fails
+  void stop()
+  {
+    if (!m_thread.joinable())
+      return;
+    m_io.stop();
+    m_thread.join();
+    boost::system::error_code ec;
+    m_socket.close(ec);
+    m_acceptor.close(ec);
+  }
+
+private:
+  boost::asio::io_service m_io;
+  boost::asio::ip::tcp::acceptor m_acceptor;
+  boost::asio::ip::tcp::socket m_socket;
+  boost::thread m_thread;
+};
+
+local_supernode::options make_options(size_t max_queue_size, local_supernode::overflow_policy policy)
+{
+  local_supernode::options opts;
+  opts.max_queue_size = max_queue_size;
+  opts.workers_count = 1;
+  opts.policy = policy;
+  opts.timeout = std::chrono::milliseconds(10000);
+  return opts;
+}
+
+bool wait_in_flight(const local_supernode &supernode)
+{
+  for (int i = 0; i < 500; ++i)
+  {
+    if (supernode.get_stats().in_flight == 1)
+      return true;
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+}
+
+TEST(local_supernode, bounds_queue)
+{
+  silent_server server;
+  std::unique_ptr<local_supernode> supernode(new local_supernode("127.0.0.1", server.port(), "/", make_options(10, local_supernode::drop_oldest)));
+
+  ASSERT_TRUE(supernode->post("first", "{}"));
+  ASSERT_TRUE(wait_in_flight(*supernode));
+
+  for (int i = 0; i < 100; ++i)
+    EXPECT_TRUE(supernode->post("next", "{}"));
+
+  local_supernode_stats stats = supernode->get_stats();
+  EXPECT_EQ(stats.queued, 101);
+  EXPECT_EQ(stats.queue_depth, 10);
+  EXPECT_EQ(stats.max_queue_depth, 10);
+  EXPECT_EQ(stats.dropped, 90);
+  EXPECT_EQ(stats.in_flight, 1);
+
+  server.stop();
+  supernode.reset();
+}
+
+TEST(local_supernode, drop_oldest_accepts_new_requests)
+{
+  silent_server server;
+  std::unique_ptr<local_supernode> supernode(new local_supernode("127.0.0.1", server.port(), "/", make_options(2, local_supernode::drop_oldest)));
+
+  ASSERT_TRUE(supernode->post("first", "{}"));
+  ASSERT_TRUE(wait_in_flight(*supernode));
+
+  EXPECT_TRUE(supernode->post("a", "{}"));
+  EXPECT_TRUE(supernode->post("b", "{}"));
+  EXPECT_TRUE(supernode->post("c", "{}"));
+
+  local_supernode_stats stats = supernode->get_stats();
+  EXPECT_EQ(stats.queued, 4);
+  EXPECT_EQ(stats.queue_depth, 2);
+  EXPECT_EQ(stats.dropped, 1);
+
+  server.stop();
+  supernode.reset();
+}
+
+TEST(local_supernode, drop_newest_rejects_new_requests)
+{
+  silent_server server;
+  std::unique_ptr<local_supernode> supernode(new local_supernode("127.0.0.1", server.port(), "/", make_options(2, local_supernode::drop_newest)));
+
+  ASSERT_TRUE(supernode->post("first", "{}"));
+  ASSERT_TRUE(wait_in_flight(*supernode));
+
+  EXPECT_TRUE(supernode->post("a", "{}"));
+  EXPECT_TRUE(supernode->post("b", "{}"));
+  EXPECT_FALSE(supernode->post("c", "{}"));
+
+  local_supernode_stats stats = supernode->get_stats();
+  EXPECT_EQ(stats.queued, 3);
+  EXPECT_EQ(stats.queue_depth, 2);
+  EXPECT_EQ(stats.dropped, 1);
+
+  server.stop();
+  supernode.reset();
+}
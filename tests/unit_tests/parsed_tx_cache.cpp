@@ -0,0 +1,128 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/parsed_tx_cache.h"
+
+using namespace cryptonote;
+
+namespace
+{
+
+crypto::hash make_txid(uint8_t n)
+{
+  crypto::hash txid = crypto::null_hash;
+  txid.data[0] = n;
+  return txid;
+}
+
+parsed_tx_cache::entry make_entry(size_t blob_size, uint64_t unlock_time = 0)
+{
+  std::shared_ptr<transaction> tx = std::make_shared<transaction>();
+  tx->unlock_time = unlock_time;
+  parsed_tx_cache::entry e;
+  e.tx = tx;
+  e.prefix_hash = crypto::null_hash;
+  e.blob = std::make_shared<blobdata>(blob_size, 'x');
+  return e;
+}
+
+}
+
+TEST(parsed_tx_cache, get_counts_hits_and_misses)
+{
+  parsed_tx_cache cache(1024 * 1024);
+  parsed_tx_cache::entry e;
+  ASSERT_FALSE(cache.get(make_txid(1), e));
+  cache.put(make_txid(1), make_entry(100, 42));
+  ASSERT_TRUE(cache.get(make_txid(1), e));
+  ASSERT_EQ(42, e.tx->unlock_time);
+  ASSERT_EQ(100, e.blob->size());
+
+  const parsed_tx_cache::stats stats = cache.get_stats();
+  ASSERT_EQ(1, stats.hits);
+  ASSERT_EQ(1, stats.misses);
+  ASSERT_EQ(1, stats.entries);
+  ASSERT_EQ(parsed_tx_cache::entry_size(make_entry(100)), stats.bytes);
+}
+
+TEST(parsed_tx_cache, evicts_least_recently_used)
+{
+  const size_t size = parsed_tx_cache::entry_size(make_entry(1000));
+  parsed_tx_cache cache(3 * size);
+  parsed_tx_cache::entry e;
+  cache.put(make_txid(1), make_entry(1000));
+  cache.put(make_txid(2), make_entry(1000));
+  cache.put(make_txid(3), make_entry(1000));
+  ASSERT_TRUE(cache.get(make_txid(1), e));
+  cache.put(make_txid(4), make_entry(1000));
+
+  ASSERT_TRUE(cache.get(make_txid(1), e));
+  ASSERT_FALSE(cache.get(make_txid(2), e));
+  ASSERT_TRUE(cache.get(make_txid(3), e));
+  ASSERT_TRUE(cache.get(make_txid(4), e));
+  ASSERT_EQ(3 * size, cache.get_stats().bytes);
+
+  cache.set_max_bytes(size);
+  ASSERT_EQ(1, cache.get_stats().entries);
+  ASSERT_TRUE(cache.get(make_txid(4), e));
+}
+
+TEST(parsed_tx_cache, replace_and_remove)
+{
+  parsed_tx_cache cache(1024 * 1024);
+  parsed_tx_cache::entry e;
+  cache.put(make_txid(1), make_entry(100, 1));
+  cache.put(make_txid(1), make_entry(200, 2));
+  ASSERT_EQ(1, cache.get_stats().entries);
+  ASSERT_EQ(parsed_tx_cache::entry_size(make_entry(200)), cache.get_stats().bytes);
+  ASSERT_TRUE(cache.get(make_txid(1), e));
+  ASSERT_EQ(2, e.tx->unlock_time);
+
+  cache.put(make_txid(2), make_entry(100));
+  cache.remove(make_txid(1));
+  ASSERT_FALSE(cache.get(make_txid(1), e));
+  ASSERT_EQ(parsed_tx_cache::entry_size(make_entry(100)), cache.get_stats().bytes);
+
+  cache.clear();
+  ASSERT_EQ(0, cache.get_stats().entries);
+  ASSERT_EQ(0, cache.get_stats().bytes);
+  ASSERT_FALSE(cache.get(make_txid(2), e));
+}
+
+TEST(parsed_tx_cache, oversized_entry_is_not_kept)
+{
+  parsed_tx_cache cache(parsed_tx_cache::entry_size(make_entry(100)));
+  parsed_tx_cache::entry e;
+  cache.put(make_txid(1), make_entry(100));
+  cache.put(make_txid(2), make_entry(101));
+  ASSERT_TRUE(cache.get(make_txid(1), e));
+  ASSERT_FALSE(cache.get(make_txid(2), e));
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include "p2p/p2p_protocol_defs.h"
+#include "p2p/relay_buffer.h"
+#include "storages/portable_storage_template_helper.h"
+
+using namespace nodetool;
+
+TEST(relay_buffer, patches_hop_of_serialized_message)
+{
+  COMMAND_MULTICAST::request req = AUTO_VAL_INIT(req);
+  req.receiver_addresses = {"a", "bb", "ccc"};
+  req.sender_address = "sender";
+  req.callback_uri = "/callback";
+  req.data = std::string(5000, 'x');
+  req.wait_answer = true;
+  req.hop = 7;
+  req.message_id = "message";
+
+  std::string received;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(req, received));
+
+  std::string relay;
+  ASSERT_TRUE(make_relay_buffer(received, 6, relay));
+
+  req.hop = 6;
+  std::string expected;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(req, expected));
+  EXPECT_EQ(relay, expected);
+
+  COMMAND_MULTICAST::request relayed_req;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(relayed_req, relay));
+  EXPECT_EQ(relayed_req.hop, 6);
+  EXPECT_EQ(relayed_req.data, req.data);
+}
+
+TEST(relay_buffer, rejects_malformed_message)
+{
+  COMMAND_BROADCAST::request req = AUTO_VAL_INIT(req);
+  req.data = std::string(100, 'x');
+  req.hop = 3;
+
+  std::string received;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(req, received));
+
+  std::string relay;
+  EXPECT_FALSE(make_relay_buffer(received.substr(0, received.size() / 2), 2, relay));
+  EXPECT_FALSE(make_relay_buffer(std::string(), 2, relay));
+  EXPECT_FALSE(make_relay_buffer(std::string(received.size(), '\0'), 2, relay));
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include "p2p/request_cache.h"
+
+using namespace nodetool;
+
+namespace
+{
+
+const std::chrono::milliseconds CACHE_TIME(1000);
+
+}
+
+TEST(request_cache, detects_duplicates)
+{
+  request_cache cache(CACHE_TIME);
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  EXPECT_TRUE(cache.insert("a", now));
+  EXPECT_TRUE(cache.insert("b", now));
+  EXPECT_FALSE(cache.insert("a", now));
+  EXPECT_FALSE(cache.insert("b", now + CACHE_TIME / 2));
+
+  request_cache_stats stats = cache.get_stats();
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(stats.evicted, 0);
+  EXPECT_EQ(stats.size, 2);
+}
+
+TEST(request_cache, keeps_ids_for_cache_time)
+{
+  request_cache cache(CACHE_TIME);
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  ASSERT_TRUE(cache.insert("a", now));
+  EXPECT_FALSE(cache.insert("a", now + CACHE_TIME));
+}
+
+TEST(request_cache, expires_old_ids)
+{
+  request_cache cache(CACHE_TIME);
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < 100; ++i)
+    ASSERT_TRUE(cache.insert(std::to_string(i), now));
+
+  const std::chrono::steady_clock::time_point later = now + 2 * CACHE_TIME;
+
+  for (int i = 0; i < 100; ++i)
+    EXPECT_TRUE(cache.insert(std::to_string(i), later));
+
+  request_cache_stats stats = cache.get_stats();
+  EXPECT_EQ(stats.evicted, 100);
+  EXPECT_EQ(stats.size, 100);
+}
+
+TEST(request_cache, distinguishes_similar_ids)
+{
+  request_cache cache(CACHE_TIME);
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  std::string id(64, 'a');
+  ASSERT_TRUE(cache.insert(id, now));
+
+  for (size_t i = 0; i < id.size(); ++i)
+  {
+    std::string similar_id = id;
+    similar_id[i] = 'b';
+    EXPECT_TRUE(cache.insert(similar_id, now));
+  }
+
+  EXPECT_TRUE(cache.insert(id + '\0', now));
+  EXPECT_TRUE(cache.insert(std::string(), now));
+  EXPECT_FALSE(cache.insert(std::string(), now));
+  EXPECT_FALSE(cache.insert(id, now));
+  EXPECT_EQ(cache.get_stats().size, id.size() + 3);
+}
@@ -0,0 +1,300 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_core/stake_transaction_storage.h"
+#include "file_io_utils.h"
+#include "graft_rta_config.h"
+#include "serialization/binary_utils.h"
+
+using namespace cryptonote;
+
+namespace
+{
+
+const uint64_t FIRST_BLOCK = 100;
+
+crypto::hash make_hash(uint64_t n)
+{
+  crypto::hash hash = crypto::null_hash;
+  memcpy(hash.data, &n, sizeof(n));
+  return hash;
+}
+
+crypto::public_key make_id(const std::string& name)
+{
+  crypto::public_key id = crypto::null_pkey;
+  memcpy(id.data, name.data(), std::min(name.size(), sizeof(id.data)));
+  return id;
+}
+
+stake_transaction make_stake_tx(const std::string& id, uint64_t block_height, uint64_t unlock_time, uint64_t amount)
+{
+  stake_transaction tx = AUTO_VAL_INIT(tx);
+  tx.hash = make_hash(block_height * 1000 + id.size());
+  tx.amount = amount;
+  tx.block_height = block_height;
+  tx.unlock_time = unlock_time;
+  tx.supernode_public_id = make_id(id);
+  return tx;
+}
+
+class StakeTransactionStorageTest : public ::testing::Test
+{
+protected:
+  StakeTransactionStorageTest()
+    : storage((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string(), FIRST_BLOCK)
+  {
+  }
+
+  void add_block(const std::vector<stake_transaction>& txs = std::vector<stake_transaction>())
+  {
+    uint64_t index = storage.get_last_processed_block_index() + 1;
+    for (const stake_transaction& tx : txs)
+      storage.add_tx(tx);
+    storage.add_last_processed_block(index, make_hash(index));
+  }
+
+  StakeTransactionStorage storage;
+};
+
+}
+
+TEST_F(StakeTransactionStorageTest, aggregates_stakes_of_supernode)
+{
+  add_block({make_stake_tx("a", FIRST_BLOCK + 1, 100, config::graft::TIER1_STAKE_AMOUNT)});
+  add_block({make_stake_tx("a", FIRST_BLOCK + 2, 50, config::graft::TIER1_STAKE_AMOUNT)});
+
+  supernode_stake stake;
+  ASSERT_TRUE(storage.find_supernode_stake(FIRST_BLOCK + 20, make_id("a"), stake));
+  EXPECT_EQ(stake.amount, 2 * config::graft::TIER1_STAKE_AMOUNT);
+  EXPECT_EQ(stake.tier, 2);
+  EXPECT_EQ(stake.block_height, FIRST_BLOCK + 2 + config::graft::STAKE_VALIDATION_PERIOD);
+  EXPECT_EQ(stake.block_height + stake.unlock_time, FIRST_BLOCK + 2 + 50 + config::graft::TRUSTED_RESTAKING_PERIOD);
+
+  ASSERT_TRUE(storage.find_supernode_stake(FIRST_BLOCK + 80, make_id("a"), stake));
+  EXPECT_EQ(stake.amount, config::graft::TIER1_STAKE_AMOUNT);
+  EXPECT_EQ(stake.tier, 1);
+
+  EXPECT_FALSE(storage.find_supernode_stake(FIRST_BLOCK + 20, make_id("b"), stake));
+}
+
+TEST_F(StakeTransactionStorageTest, obsolete_stake_has_zero_amount)
+{
+  add_block({make_stake_tx("a", FIRST_BLOCK + 1, 10, config::graft::TIER1_STAKE_AMOUNT)});
+
+  supernode_stake stake;
+  ASSERT_TRUE(storage.find_supernode_stake(FIRST_BLOCK + 50, make_id("a"), stake));
+  EXPECT_EQ(stake.amount, 0);
+  EXPECT_EQ(stake.tier, 0);
+  EXPECT_EQ(stake.supernode_public_id, make_id("a"));
+
+  EXPECT_FALSE(storage.find_supernode_stake(FIRST_BLOCK + 1 + 10 + config::graft::SUPERNODE_HISTORY_SIZE + 1, make_id("a"), stake));
+}
+
+TEST_F(StakeTransactionStorageTest, lookup_matches_cached_stakes)
+{
+  add_block({make_stake_tx("a", FIRST_BLOCK + 1, 100, config::graft::TIER1_STAKE_AMOUNT),
+             make_stake_tx("b", FIRST_BLOCK + 1, 20, config::graft::TIER3_STAKE_AMOUNT)});
+  add_block({make_stake_tx("c", FIRST_BLOCK + 2, 300, config::graft::TIER4_STAKE_AMOUNT)});
+
+  for (uint64_t height = FIRST_BLOCK; height < FIRST_BLOCK + 300; height += 7)
+  {
+    const StakeTransactionStorage::supernode_stake_array stakes = storage.get_supernode_stakes(height);
+
+    storage.clear_supernode_stakes();
+
+    for (const supernode_stake& expected : stakes)
+    {
+      supernode_stake stake;
+      ASSERT_TRUE(storage.find_supernode_stake(height, expected.supernode_public_id, stake));
+      EXPECT_EQ(stake.amount, expected.amount);
+      EXPECT_EQ(stake.tier, expected.tier);
+      EXPECT_EQ(stake.block_height, expected.block_height);
+      EXPECT_EQ(stake.unlock_time, expected.unlock_time);
+    }
+  }
+}
+
+TEST_F(StakeTransactionStorageTest, unroll_removes_stakes)
+{
+  add_block({make_stake_tx("a", FIRST_BLOCK + 1, 100, config::graft::TIER1_STAKE_AMOUNT)});
+  add_block({make_stake_tx("a", FIRST_BLOCK + 2, 100, config::graft::TIER1_STAKE_AMOUNT),
+             make_stake_tx("b", FIRST_BLOCK + 2, 100, config::graft::TIER1_STAKE_AMOUNT)});
+
+  storage.remove_last_processed_block();
+
+  EXPECT_EQ(storage.get_tx_count(), 1);
+
+  supernode_stake stake;
+  ASSERT_TRUE(storage.find_supernode_stake(FIRST_BLOCK + 20, make_id("a"), stake));
+  EXPECT_EQ(stake.amount, config::graft::TIER1_STAKE_AMOUNT);
+  EXPECT_FALSE(storage.find_supernode_stake(FIRST_BLOCK + 20, make_id("b"), stake));
+}
+
+namespace
+{
+
+class StakeTransactionStorageLogTest : public ::testing::Test
+{
+protected:
+  StakeTransactionStorageLogTest()
+    : file_name((boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string())
+    , legacy_file_name(file_name + ".legacy")
+  {
+  }
+
+  ~StakeTransactionStorageLogTest()
+  {
+    boost::filesystem::remove(file_name);
+    boost::filesystem::remove(legacy_file_name);
+  }
+
+  static void add_block(StakeTransactionStorage& storage, const std::vector<stake_transaction>& txs = std::vector<stake_transaction>())
+  {
+    uint64_t index = storage.get_last_processed_block_index() + 1;
+    for (const stake_transaction& tx : txs)
+      storage.add_tx(tx);
+    storage.add_last_processed_block(index, make_hash(index));
+  }
+
+  std::string file_name;
+  std::string legacy_file_name;
+};
+
+//layout of the storage file before the append-only log
+struct legacy_file_data
+{
+  uint64_t last_processed_block_index;
+  size_t last_processed_block_hashes_count;
+  StakeTransactionStorage::block_hash_list block_hashes;
+  StakeTransactionStorage::stake_transaction_array stake_txs;
+
+  BEGIN_SERIALIZE_OBJECT()
+    FIELD(last_processed_block_index)
+    FIELD(last_processed_block_hashes_count)
+    FIELD(block_hashes)
+    FIELD(stake_txs)
+  END_SERIALIZE()
+};
+
+}
+
+TEST_F(StakeTransactionStorageLogTest, restores_stored_state)
+{
+  {
+    StakeTransactionStorage storage(file_name, FIRST_BLOCK);
+    add_block(storage, {make_stake_tx("a", FIRST_BLOCK + 1, 100, config::graft::TIER1_STAKE_AMOUNT)});
+    add_block(storage, {make_stake_tx("b", FIRST_BLOCK + 2, 100, config::graft::TIER2_STAKE_AMOUNT)});
+    storage.store();
+    add_block(storage, {make_stake_tx("c", FIRST_BLOCK + 3, 100, config::graft::TIER2_STAKE_AMOUNT)});
+    storage.remove_last_processed_block();
+    add_block(storage);
+    storage.store();
+    add_block(storage, {make_stake_tx("d", FIRST_BLOCK + 4, 100, config::graft::TIER2_STAKE_AMOUNT)}); //not stored
+  }
+
+  StakeTransactionStorage storage(file_name, FIRST_BLOCK);
+
+  EXPECT_EQ(storage.get_last_processed_block_index(), FIRST_BLOCK + 3);
+  EXPECT_EQ(storage.get_last_processed_block_hash(), make_hash(FIRST_BLOCK + 3));
+  EXPECT_EQ(storage.get_tx_count(), 2);
+  EXPECT_FALSE(storage.need_store());
+
+  supernode_stake stake;
+  EXPECT_TRUE(storage.find_supernode_stake(FIRST_BLOCK + 20, make_id("b"), stake));
+  EXPECT_FALSE(storage.find_supernode_stake(FIRST_BLOCK + 20, make_id("c"), stake));
+  EXPECT_FALSE(storage.find_supernode_stake(FIRST_BLOCK + 20, make_id("d"), stake));
+}
+
+TEST_F(StakeTransactionStorageLogTest, discards_incomplete_record)
+{
+  {
+    StakeTransactionStorage storage(file_name, FIRST_BLOCK);
+    add_block(storage, {make_stake_tx("a", FIRST_BLOCK + 1, 100, config::graft::TIER1_STAKE_AMOUNT)});
+    storage.store();
+    add_block(storage, {make_stake_tx("b", FIRST_BLOCK + 2, 100, config::graft::TIER2_STAKE_AMOUNT)});
+    storage.store();
+  }
+
+    //simulate crash in the middle of the last record
+
+  boost::filesystem::resize_file(file_name, boost::filesystem::file_size(file_name) - 3);
+
+  {
+    StakeTransactionStorage storage(file_name, FIRST_BLOCK);
+
+    EXPECT_EQ(storage.get_last_processed_block_index(), FIRST_BLOCK + 1);
+    EXPECT_EQ(storage.get_tx_count(), 1);
+
+    add_block(storage, {make_stake_tx("c", FIRST_BLOCK + 2, 100, config::graft::TIER2_STAKE_AMOUNT)});
+    storage.store();
+  }
+
+  StakeTransactionStorage storage(file_name, FIRST_BLOCK);
+
+  EXPECT_EQ(storage.get_last_processed_block_index(), FIRST_BLOCK + 2);
+  EXPECT_EQ(storage.get_tx_count(), 2);
+}
+
+TEST_F(StakeTransactionStorageLogTest, migrates_legacy_file)
+{
+  legacy_file_data data = AUTO_VAL_INIT(data);
+  data.last_processed_block_index = FIRST_BLOCK + 2;
+  data.last_processed_block_hashes_count = 2;
+  data.block_hashes.push_back(make_hash(FIRST_BLOCK + 1));
+  data.block_hashes.push_back(make_hash(FIRST_BLOCK + 2));
+  data.stake_txs.push_back(make_stake_tx("a", FIRST_BLOCK + 1, 100, config::graft::TIER1_STAKE_AMOUNT));
+
+  std::string blob;
+  ASSERT_TRUE(::serialization::dump_binary(data, blob));
+  ASSERT_TRUE(epee::file_io_utils::save_string_to_file(legacy_file_name, blob));
+
+  {
+    StakeTransactionStorage storage(file_name, FIRST_BLOCK, legacy_file_name);
+
+    EXPECT_EQ(storage.get_last_processed_block_index(), FIRST_BLOCK + 2);
+    EXPECT_EQ(storage.get_tx_count(), 1);
+    EXPECT_FALSE(boost::filesystem::exists(legacy_file_name));
+
+    add_block(storage);
+    storage.store();
+  }
+
+  StakeTransactionStorage storage(file_name, FIRST_BLOCK, legacy_file_name);
+
+  EXPECT_EQ(storage.get_last_processed_block_index(), FIRST_BLOCK + 3);
+  EXPECT_EQ(storage.get_tx_count(), 1);
+
+  storage.remove_last_processed_block();
+  EXPECT_EQ(storage.get_last_processed_block_hash(), make_hash(FIRST_BLOCK + 2));
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+
+#include "supernode/TimerWheel.h"
+
+using namespace supernode;
+
+namespace
+{
+
+const unsigned SLOT_MS = 1000;
+const size_t SLOTS_COUNT = 4;
+
+const boost::posix_time::ptime START(boost::gregorian::date(2019, 1, 1));
+
+boost::posix_time::ptime at(unsigned seconds)
+{
+  return START + boost::posix_time::seconds(seconds);
+}
+
+std::vector<int> expire(TimerWheel<int>& wheel, unsigned seconds)
+{
+  std::vector<int> expired;
+  wheel.Expire(at(seconds), expired);
+  std::sort(expired.begin(), expired.end());
+  return expired;
+}
+
+}
+
+TEST(timer_wheel, expires_items_at_deadline)
+{
+  TimerWheel<int> wheel(SLOT_MS, SLOTS_COUNT);
+
+  wheel.Add(1, at(1));
+  wheel.Add(2, at(2));
+  wheel.Add(3, at(2));
+  EXPECT_EQ(wheel.Size(), 3);
+
+  EXPECT_TRUE(expire(wheel, 0).empty());
+  EXPECT_EQ(expire(wheel, 1), std::vector<int>({1}));
+  EXPECT_EQ(expire(wheel, 2), std::vector<int>({2, 3}));
+  EXPECT_TRUE(expire(wheel, 3).empty());
+  EXPECT_EQ(wheel.Size(), 0);
+}
+
+TEST(timer_wheel, adds_after_start)
+{
+  TimerWheel<int> wheel(SLOT_MS, SLOTS_COUNT);
+
+  wheel.Add(1, at(5));
+  EXPECT_TRUE(expire(wheel, 3).empty());
+
+  // deadline which has passed already fires at the next expiration
+  wheel.Add(2, at(1));
+  wheel.Add(3, at(4));
+  EXPECT_EQ(wheel.Size(), 3);
+
+  EXPECT_EQ(expire(wheel, 3), std::vector<int>({2}));
+  EXPECT_EQ(expire(wheel, 4), std::vector<int>({3}));
+  EXPECT_EQ(expire(wheel, 5), std::vector<int>({1}));
+
+  // an empty wheel keeps tracking time
+  EXPECT_TRUE(expire(wheel, 10).empty());
+  wheel.Add(4, at(11));
+  EXPECT_TRUE(expire(wheel, 10).empty());
+  EXPECT_EQ(expire(wheel, 11), std::vector<int>({4}));
+}
+
+TEST(timer_wheel, keeps_items_of_later_rounds)
+{
+  TimerWheel<int> wheel(SLOT_MS, SLOTS_COUNT);
+
+  // all items share one slot but belong to different rounds
+  wheel.Add(1, at(1));
+  wheel.Add(2, at(1 + SLOTS_COUNT));
+  wheel.Add(3, at(1 + 2 * SLOTS_COUNT));
+
+  EXPECT_EQ(expire(wheel, 1), std::vector<int>({1}));
+  EXPECT_TRUE(expire(wheel, SLOTS_COUNT).empty());
+  EXPECT_EQ(expire(wheel, 1 + SLOTS_COUNT), std::vector<int>({2}));
+  EXPECT_EQ(wheel.Size(), 1);
+  EXPECT_TRUE(expire(wheel, 2 * SLOTS_COUNT).empty());
+  EXPECT_EQ(expire(wheel, 1 + 2 * SLOTS_COUNT), std::vector<int>({3}));
+}
+
+TEST(timer_wheel, wraps_past_full_round)
+{
+  TimerWheel<int> wheel(SLOT_MS, SLOTS_COUNT);
+
+  for (int i = 0; i < 20; ++i)
+    wheel.Add(i, at(i));
+  EXPECT_EQ(expire(wheel, 0), std::vector<int>({0}));
+
+  // a jump over several rounds visits every slot once and takes all due items
+  std::vector<int> expired = expire(wheel, 3 * SLOTS_COUNT + 2);
+  std::vector<int> expected;
+  for (int i = 1; i <= 3 * SLOTS_COUNT + 2; ++i)
+    expected.push_back(i);
+  EXPECT_EQ(expired, expected);
+  EXPECT_EQ(wheel.Size(), 20 - expected.size() - 1);
+
+  expired = expire(wheel, 100);
+  EXPECT_EQ(expired.size(), 20 - expected.size() - 1);
+  EXPECT_EQ(expired.front(), 3 * SLOTS_COUNT + 3);
+  EXPECT_EQ(wheel.Size(), 0);
+}
+
+TEST(timer_wheel, keeps_order_of_time)
+{
+  TimerWheel<int> wheel(SLOT_MS, SLOTS_COUNT);
+
+  wheel.Add(1, at(2));
+  EXPECT_EQ(expire(wheel, 2), std::vector<int>({1}));
+
+  // expiration for the earlier time does nothing
+  wheel.Add(2, at(3));
+  EXPECT_TRUE(expire(wheel, 1).empty());
+  EXPECT_EQ(wheel.Size(), 1);
+  EXPECT_EQ(expire(wheel, 3), std::vector<int>({2}));
+}
@@ -0,0 +1,209 @@
+// Copyright (c) 2019, The Graft Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "gtest/gtest.h"
+
+#include <map>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "device/device.hpp"
+#include "supernode/WalletSessionPool.h"
+
+using namespace supernode;
+
+namespace
+{
+
+class WalletSessionPoolTest : public ::testing::Test
+{
+protected:
+  WalletSessionPoolTest()
+  {
+    // stands for BaseClientProxy::initWallet: the account data stays the same key, a wrong password fails;
+    // "watch-only:<account>" is a watch-only account data of the account, made with its own password
+    factory = [this](const std::string &account, const std::string &password) {
+      ++loads;
+      std::unique_ptr<tools::GraftWallet> wallet;
+      const std::string watch_only_prefix = "watch-only:";
+      const bool watch_only = account.compare(0, watch_only_prefix.size(), watch_only_prefix) == 0;
+      if (password != (watch_only ? "own password" : "password"))
+        return wallet;
+      const std::string full_account = watch_only ? account.substr(watch_only_prefix.size()) : account;
+      auto it = keys.find(full_account);
+      if (it == keys.end())
+        it = keys.emplace(full_account, cryptonote::keypair::generate(hw::get_device("default")).sec).first;
+      wallet.reset(new tools::GraftWallet(cryptonote::TESTNET));
+      if (watch_only)
+      {
+        cryptonote::account_base full;
+        full.generate(it->second, true);
+        wallet->generate("", password, full.get_keys().m_account_address, full.get_keys().m_view_secret_key);
+      }
+      else
+      {
+        wallet->generateFromData(password, it->second, true);
+      }
+      return wallet;
+    };
+  }
+
+  static std::string address(const WalletSessionPool::Handle &handle)
+  {
+    return handle->get_account().get_public_address_str(handle->nettype());
+  }
+
+  WalletSessionPool::WalletFactory factory;
+  std::map<std::string, crypto::secret_key> keys;
+  size_t loads = 0;
+};
+
+}
+
+TEST_F(WalletSessionPoolTest, keeps_wallet_resident)
+{
+  WalletSessionPool pool(2, std::chrono::seconds(600));
+  std::string first;
+  {
+    WalletSessionPool::Handle handle = pool.Acquire("a", "password", factory);
+    ASSERT_TRUE(bool(handle));
+    first = address(handle);
+  }
+  WalletSessionPool::Handle handle = pool.Acquire("a", "password", factory);
+  ASSERT_TRUE(bool(handle));
+  EXPECT_EQ(first, address(handle));
+  EXPECT_EQ(1, loads);
+  EXPECT_EQ(1, pool.Size());
+}
+
+TEST_F(WalletSessionPoolTest, evicts_least_recently_used)
+{
+  WalletSessionPool pool(2, std::chrono::seconds(600));
+  EXPECT_TRUE(bool(pool.Acquire("a", "password", factory)));
+  EXPECT_TRUE(bool(pool.Acquire("b", "password", factory)));
+  EXPECT_TRUE(bool(pool.Acquire("a", "password", factory)));
+  EXPECT_EQ(2, loads);
+
+  EXPECT_TRUE(bool(pool.Acquire("c", "password", factory)));
+  EXPECT_EQ(3, loads);
+  EXPECT_EQ(2, pool.Size());
+
+  EXPECT_TRUE(bool(pool.Acquire("a", "password", factory)));
+  EXPECT_EQ(3, loads);
+  EXPECT_TRUE(bool(pool.Acquire("b", "password", factory)));
+  EXPECT_EQ(4, loads);
+  EXPECT_EQ(2, pool.Size());
+}
+
+TEST_F(WalletSessionPoolTest, expires_idle_wallets)
+{
+  WalletSessionPool resident(2, std::chrono::seconds(600));
+  EXPECT_TRUE(bool(resident.Acquire("a", "password", factory)));
+  resident.ExpireIdle();
+  EXPECT_EQ(1, resident.Size());
+
+  WalletSessionPool idle(2, std::chrono::seconds(0));
+  EXPECT_TRUE(bool(idle.Acquire("a", "password", factory)));
+  EXPECT_EQ(1, idle.Size());
+  idle.ExpireIdle();
+  EXPECT_EQ(0, idle.Size());
+
+  EXPECT_TRUE(bool(idle.Acquire("a", "password", factory)));
+  EXPECT_EQ(3, loads);
+}
+
+TEST_F(WalletSessionPoolTest, wrong_password_loads_wallet)
+{
+  WalletSessionPool pool(2, std::chrono::seconds(600));
+  EXPECT_TRUE(bool(pool.Acquire("a", "password", factory)));
+  EXPECT_EQ(1, loads);
+
+  // the resident wallet is never handed out for other credentials
+  EXPECT_FALSE(bool(pool.Acquire("a", "wrong", factory)));
+  EXPECT_EQ(2, loads);
+  EXPECT_FALSE(bool(pool.Acquire("a", "wrong", factory)));
+  EXPECT_EQ(3, loads);
+  EXPECT_EQ(1, pool.Size());
+
+  EXPECT_TRUE(bool(pool.Acquire("a", "password", factory)));
+  EXPECT_EQ(3, loads);
+}
+
+TEST_F(WalletSessionPoolTest, evicts_wallet_in_use)
+{
+  WalletSessionPool pool(1, std::chrono::seconds(600));
+  WalletSessionPool::Handle held = pool.Acquire("a", "password", factory);
+  ASSERT_TRUE(bool(held));
+  const std::string held_address = address(held);
+
+  WalletSessionPool::Handle other = pool.Acquire("b", "password", factory);
+  ASSERT_TRUE(bool(other));
+  EXPECT_EQ(1, pool.Size());
+
+  // the evicted wallet stays usable by the request holding it
+  ASSERT_TRUE(bool(held));
+  EXPECT_EQ(held_address, address(held));
+
+  // and is opened again for the next one
+  WalletSessionPool::Handle reopened = pool.Acquire("a", "password", factory);
+  ASSERT_TRUE(bool(reopened));
+  EXPECT_TRUE(reopened.get() != held.get());
+  EXPECT_EQ(held_address, address(reopened));
+  EXPECT_EQ(3, loads);
+  EXPECT_EQ(1, pool.Size());
+}
+
+TEST_F(WalletSessionPoolTest, keeps_other_account_data_of_address_apart)
+{
+  WalletSessionPool pool(2, std::chrono::seconds(600));
+  std::string full_address;
+  tools::GraftWallet *full = nullptr;
+  {
+    WalletSessionPool::Handle handle = pool.Acquire("a", "password", factory);
+    ASSERT_TRUE(bool(handle));
+    EXPECT_FALSE(handle->watch_only());
+    full_address = address(handle);
+    full = handle.get();
+  }
+
+  // watch-only account data of a resident address never gets the full wallet
+  WalletSessionPool::Handle watch = pool.Acquire("watch-only:a", "own password", factory);
+  ASSERT_TRUE(bool(watch));
+  EXPECT_EQ(full_address, address(watch));
+  EXPECT_TRUE(watch->watch_only());
+  EXPECT_TRUE(watch.get() != full);
+  EXPECT_EQ(2, loads);
+  EXPECT_EQ(2, pool.Size());
+
+  WalletSessionPool::Handle again = pool.Acquire("a", "password", factory);
+  ASSERT_TRUE(bool(again));
+  EXPECT_TRUE(again.get() == full);
+  EXPECT_FALSE(again->watch_only());
+  EXPECT_EQ(2, loads);
+}